@@ -0,0 +1,386 @@
+#include "renderer.hpp"
+#include "simulation.hpp"
+
+#ifdef ENABLE_DEBUG_UI
+#include "imgui.h"
+#endif
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+// Counts the allocations of every thread, including the renderer's workers
+std::atomic<std::uint64_t> g_allocation_count {};
+
+struct Options
+{
+    std::uint32_t frames {1000};
+    // Not measured, lets pipelines and textures finish loading
+    std::uint32_t warmup_frames {100};
+    std::uint32_t width {1280};
+    std::uint32_t height {720};
+    std::uint32_t sprite_count {1000};
+    bool window {};
+    // Standard output if empty
+    std::filesystem::path output {};
+};
+
+struct Summary
+{
+    double min;
+    double median;
+    double p95;
+    double p99;
+};
+
+[[nodiscard]] std::uint32_t parse_uint(std::string_view option,
+                                       std::string_view value)
+{
+    std::uint32_t result {};
+    const auto [ptr, error] =
+        std::from_chars(value.data(), value.data() + value.size(), result);
+    if (error != std::errc {} || ptr != value.data() + value.size())
+    {
+        throw std::runtime_error("Invalid value \"" + std::string(value) +
+                                 "\" for " + std::string(option));
+    }
+    return result;
+}
+
+[[nodiscard]] Options parse_options(int argc, char *argv[])
+{
+    Options options {};
+    for (int i {1}; i < argc; ++i)
+    {
+        const std::string_view option {argv[i]};
+        if (option == "--window")
+        {
+            options.window = true;
+            continue;
+        }
+        if (i + 1 == argc)
+        {
+            throw std::runtime_error("Missing value for " +
+                                     std::string(option));
+        }
+
+        const std::string_view value {argv[++i]};
+        if (option == "--frames")
+        {
+            options.frames = parse_uint(option, value);
+        }
+        else if (option == "--warmup")
+        {
+            options.warmup_frames = parse_uint(option, value);
+        }
+        else if (option == "--width")
+        {
+            options.width = parse_uint(option, value);
+        }
+        else if (option == "--height")
+        {
+            options.height = parse_uint(option, value);
+        }
+        else if (option == "--sprites")
+        {
+            options.sprite_count = parse_uint(option, value);
+        }
+        else if (option == "--output")
+        {
+            options.output = value;
+        }
+        else
+        {
+            throw std::runtime_error("Unknown option " + std::string(option));
+        }
+    }
+
+    if (options.frames == 0 || options.width == 0 || options.height == 0)
+    {
+        throw std::runtime_error(
+            "The frame count and resolution must not be 0");
+    }
+    if (options.sprite_count > g_max_sprite_count)
+    {
+        throw std::runtime_error("At most " +
+                                 std::to_string(g_max_sprite_count) +
+                                 " sprites are supported");
+    }
+
+    return options;
+}
+
+// Nearest-rank percentiles
+[[nodiscard]] std::optional<Summary> summarize(std::vector<double> samples)
+{
+    if (samples.empty())
+    {
+        return std::nullopt;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    const auto percentile = [&](std::size_t percent)
+    { return samples[(samples.size() * percent + 99) / 100 - 1]; };
+
+    return Summary {.min = samples.front(),
+                    .median = percentile(50),
+                    .p95 = percentile(95),
+                    .p99 = percentile(99)};
+}
+
+// 0 where it cannot be measured
+[[nodiscard]] double resident_set_mib()
+{
+#ifdef __linux__
+    std::ifstream statm("/proc/self/statm");
+    std::uint64_t size_pages {};
+    std::uint64_t resident_pages {};
+    if (statm >> size_pages >> resident_pages)
+    {
+        return static_cast<double>(resident_pages) *
+               static_cast<double>(sysconf(_SC_PAGESIZE)) / (1024.0 * 1024.0);
+    }
+#endif
+    return 0.0;
+}
+
+void write_summary(std::ostream &out,
+                   const char *name,
+                   const std::optional<Summary> &summary)
+{
+    out << "  \"" << name << "\": ";
+    if (!summary.has_value())
+    {
+        out << "null";
+        return;
+    }
+    out << "{\"min\": " << summary->min << ", \"median\": " << summary->median
+        << ", \"p95\": " << summary->p95 << ", \"p99\": " << summary->p99
+        << '}';
+}
+
+struct Samples
+{
+    std::vector<double> cpu_frame_ms;
+    std::array<std::vector<double>, g_gpu_pass_count> gpu_pass_ms;
+    std::vector<double> allocations;
+    std::vector<double> resident_set_mib;
+};
+
+void write_json(std::ostream &out,
+                const Options &options,
+                const Samples &samples)
+{
+    out << "{\n";
+    out << "  \"frames\": " << options.frames
+        << ",\n  \"warmup_frames\": " << options.warmup_frames
+        << ",\n  \"width\": " << options.width
+        << ",\n  \"height\": " << options.height
+        << ",\n  \"sprites\": " << options.sprite_count
+        << ",\n  \"headless\": " << (options.window ? "false" : "true")
+        << ",\n";
+    write_summary(out, "cpu_frame_ms", summarize(samples.cpu_frame_ms));
+    out << ",\n";
+    constexpr const char *gpu_pass_names[] {
+        "gpu_offscreen_ms", "gpu_final_ms", "gpu_imgui_ms"};
+    for (std::size_t i {}; i < g_gpu_pass_count; ++i)
+    {
+        write_summary(
+            out, gpu_pass_names[i], summarize(samples.gpu_pass_ms[i]));
+        out << ",\n";
+    }
+    write_summary(
+        out, "allocations_per_frame", summarize(samples.allocations));
+    out << ",\n";
+    write_summary(
+        out, "resident_set_mib", summarize(samples.resident_set_mib));
+    out << "\n}\n";
+}
+
+[[nodiscard]] Samples run(const Options &options, GLFWwindow *window)
+{
+    const Config config {.present_mode = Present_mode::immediate,
+                         .frames_in_flight = 2,
+                         .headless_frames = 0,
+                         .output = {},
+                         .sprite_count = options.sprite_count,
+                         .update_rate = 60,
+                         .simulation_thread = false,
+                         .capture = {}};
+    Job_system job_system;
+    Renderer renderer(
+        window, options.width, options.height, config, job_system);
+    Simulation simulation(options.sprite_count);
+
+    // A fixed cursor keeps the frames reproducible
+    const auto sample_cursor = [&]
+    {
+        return glm::vec2 {static_cast<float>(options.width) * 0.5f,
+                          static_cast<float>(options.height) * 0.5f};
+    };
+
+    Samples samples {};
+    std::optional<std::uint64_t> last_gpu_frame;
+    const auto frame_count = options.warmup_frames + options.frames;
+    for (std::uint32_t frame {}; frame < frame_count; ++frame)
+    {
+        if (window != nullptr)
+        {
+            glfwPollEvents();
+            if (glfwWindowShouldClose(window))
+            {
+                break;
+            }
+        }
+
+        // One step per frame keeps the frames reproducible, only the
+        // renderer is measured
+        simulation.update(1.0f / static_cast<float>(config.update_rate),
+                          job_system);
+
+        const auto allocation_count = g_allocation_count.load();
+        const auto start = std::chrono::steady_clock::now();
+        renderer.draw_frame(sample_cursor, simulation.sprites());
+        const auto end = std::chrono::steady_clock::now();
+
+        if (frame >= options.warmup_frames)
+        {
+            samples.cpu_frame_ms.push_back(
+                std::chrono::duration<double, std::milli>(end - start)
+                    .count());
+            samples.allocations.push_back(static_cast<double>(
+                g_allocation_count.load() - allocation_count));
+            samples.resident_set_mib.push_back(resident_set_mib());
+        }
+
+        // Read back a frame or more late, each frame is seen once
+        const auto &gpu_frame_times = renderer.last_gpu_frame_times();
+        if (gpu_frame_times.has_value() &&
+            gpu_frame_times->frame_number >= options.warmup_frames &&
+            gpu_frame_times->frame_number != last_gpu_frame)
+        {
+            last_gpu_frame = gpu_frame_times->frame_number;
+            for (std::size_t i {}; i < g_gpu_pass_count; ++i)
+            {
+                samples.gpu_pass_ms[i].push_back(
+                    gpu_frame_times->pass_times[i]);
+            }
+        }
+    }
+
+    return samples;
+}
+
+} // namespace
+
+// Not inlined, GCC would otherwise warn that free is called on memory from
+// operator new
+[[gnu::noinline]] void *operator new(std::size_t size)
+{
+    ++g_allocation_count;
+    if (auto *const ptr = std::malloc(size == 0 ? 1 : size))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc {};
+}
+
+[[gnu::noinline]] void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+[[gnu::noinline]] void operator delete(void *ptr,
+                                       std::size_t /*size*/) noexcept
+{
+    std::free(ptr);
+}
+
+// Renders a grid of sprites for a fixed number of frames, headless unless
+// --window is given, and writes the frame statistics as JSON
+int main(int argc, char *argv[])
+{
+    try
+    {
+        const auto options = parse_options(argc, argv);
+
+        Samples samples {};
+        if (options.window)
+        {
+            if (glfwInit() != GLFW_TRUE)
+            {
+                throw std::runtime_error("Failed to initialize GLFW");
+            }
+            glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+            glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+            auto *const window =
+                glfwCreateWindow(static_cast<int>(options.width),
+                                 static_cast<int>(options.height),
+                                 "Benchmark",
+                                 nullptr,
+                                 nullptr);
+            if (window == nullptr)
+            {
+                glfwTerminate();
+                throw std::runtime_error("Failed to create a window");
+            }
+#ifdef ENABLE_DEBUG_UI
+            ImGui::CreateContext();
+#endif
+
+            samples = run(options, window);
+
+#ifdef ENABLE_DEBUG_UI
+            ImGui::DestroyContext();
+#endif
+            glfwDestroyWindow(window);
+            glfwTerminate();
+        }
+        else
+        {
+            samples = run(options, nullptr);
+        }
+
+        if (options.output.empty())
+        {
+            write_json(std::cout, options, samples);
+        }
+        else
+        {
+            std::ofstream file(options.output);
+            write_json(file, options, samples);
+            if (!file)
+            {
+                throw std::runtime_error("Failed to write " +
+                                         options.output.string());
+            }
+        }
+
+        return EXIT_SUCCESS;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << '\n';
+    }
+
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,123 @@
+#include "job_system.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+template <typename F>
+[[nodiscard]] double benchmark(int iterations, F &&f)
+{
+    const auto start = std::chrono::steady_clock::now();
+    for (int i {}; i < iterations; ++i)
+    {
+        f();
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::micro>(end - start).count() /
+           iterations;
+}
+
+// Enough work per element for the memory bandwidth not to be the limit
+void update_elements(std::vector<float> &elements,
+                     std::size_t first,
+                     std::size_t last)
+{
+    for (auto i = first; i < last; ++i)
+    {
+        auto value = elements[i];
+        for (int j {}; j < 16; ++j)
+        {
+            value = std::sqrt(value * value + 1.0f) - 0.5f;
+        }
+        elements[i] = value;
+    }
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    auto max_thread_count =
+        std::max(std::thread::hardware_concurrency(), 1u);
+    if (argc > 1)
+    {
+        const std::string_view argument {argv[1]};
+        const auto [end, error] =
+            std::from_chars(argument.data(),
+                            argument.data() + argument.size(),
+                            max_thread_count);
+        if (error != std::errc {} || end != argument.data() + argument.size() ||
+            max_thread_count == 0)
+        {
+            std::cerr << "Usage: bench_jobs [max thread count]\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    constexpr std::size_t element_count {1 << 22};
+    constexpr std::size_t elements_per_job {4096};
+    constexpr int iterations {20};
+    // Fits in a deque, more would run on the submitting thread
+    constexpr int small_job_count {4000};
+
+    std::vector<float> elements(element_count, 1.0f);
+    double single_thread_time {};
+
+    for (std::uint32_t thread_count {1}; thread_count <= max_thread_count;
+         ++thread_count)
+    {
+        Job_system job_system(thread_count - 1);
+
+        const auto parallel_for_time = benchmark(
+            iterations,
+            [&]
+            {
+                job_system.parallel_for(
+                    element_count,
+                    elements_per_job,
+                    [&](std::size_t first, std::size_t last)
+                    { update_elements(elements, first, last); });
+            });
+        if (thread_count == 1)
+        {
+            single_thread_time = parallel_for_time;
+        }
+
+        // Measures the overhead of submitting, stealing and finishing jobs
+        const auto small_jobs_time = benchmark(
+            iterations,
+            [&]
+            {
+                Job_counter counter;
+                for (int i {}; i < small_job_count; ++i)
+                {
+                    job_system.submit([] {}, counter);
+                }
+                job_system.wait(counter);
+            });
+
+        std::cout << thread_count << " threads: parallel_for "
+                  << parallel_for_time << " us (speedup "
+                  << single_thread_time / parallel_for_time << "), "
+                  << small_jobs_time * 1000.0 / small_job_count
+                  << " ns per empty job\n";
+    }
+
+    // Prevents the updates from being optimized away
+    if (std::isnan(elements.front()))
+    {
+        std::cerr << "Invalid result\n";
+    }
+
+    return EXIT_SUCCESS;
+}
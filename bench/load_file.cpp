@@ -0,0 +1,103 @@
+#include "utils.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+
+// The previous implementation of the file loading, kept as a baseline
+[[nodiscard]] std::vector<std::uint8_t>
+load_binary_file(const std::filesystem::path &path)
+{
+    if (!std::filesystem::exists(path))
+    {
+        return {};
+    }
+
+    const auto size = std::filesystem::file_size(path);
+    std::vector<std::uint8_t> data(size);
+
+    std::ifstream file(path, std::ios::binary);
+    file.read(reinterpret_cast<char *>(data.data()),
+              static_cast<std::streamsize>(size));
+
+    return data;
+}
+
+// Touches every page, so that mapped files are actually read, without the
+// cost of reading every byte dominating the measurement
+[[nodiscard]] std::uint64_t checksum(std::span<const std::uint8_t> data)
+{
+    constexpr std::size_t page_size {4096};
+    std::uint64_t sum {};
+    for (std::size_t i {}; i < data.size(); i += page_size)
+    {
+        sum += data[i];
+    }
+    return sum + data.size();
+}
+
+template <typename F>
+[[nodiscard]] double benchmark(int iterations, F &&f)
+{
+    std::uint64_t sum {};
+    const auto start = std::chrono::steady_clock::now();
+    for (int i {}; i < iterations; ++i)
+    {
+        sum += f();
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    // Prevents the loop from being optimized away
+    if (sum == 0)
+    {
+        std::cerr << "Empty file\n";
+    }
+
+    return std::chrono::duration<double, std::micro>(end - start).count() /
+           iterations;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    std::vector<std::filesystem::path> paths {
+        "shaders/spv/offscreen.vert.spv",
+        "shaders/spv/offscreen.frag.spv",
+        "shaders/spv/final.vert.spv",
+        "shaders/spv/final.frag.spv",
+        "assets/texture.jpg"};
+    if (argc > 1)
+    {
+        paths.assign(argv + 1, argv + argc);
+    }
+
+    constexpr int iterations {1000};
+
+    for (const auto &path : paths)
+    {
+        if (!std::filesystem::exists(path))
+        {
+            std::cerr << "File " << path << " does not exist\n";
+            return EXIT_FAILURE;
+        }
+
+        const auto vector_time =
+            benchmark(iterations,
+                      [&] { return checksum(load_binary_file(path)); });
+        const auto view_time =
+            benchmark(iterations,
+                      [&] { return checksum(open_file_view(path).data()); });
+
+        std::cout << path.string() << " (" << std::filesystem::file_size(path)
+                  << " bytes): load_binary_file " << vector_time
+                  << " us, open_file_view " << view_time << " us\n";
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,46 @@
+# Generates a header holding the SPIR-V code of each shader as a std::uint32_t
+# array, and a table to look them up by name (the file name without ".spv")
+#
+# Usage: cmake -DOUTPUT=<header> -DSHADERS=<spv files> -P embed_shaders.cmake
+
+set(ARRAYS "")
+set(TABLE "")
+
+foreach (SHADER IN LISTS SHADERS)
+    get_filename_component(FILENAME ${SHADER} NAME)
+    string(REGEX REPLACE "\\.spv$" "" NAME ${FILENAME})
+    string(MAKE_C_IDENTIFIER ${NAME} IDENTIFIER)
+
+    file(READ ${SHADER} HEX HEX)
+    string(LENGTH "${HEX}" HEX_LENGTH)
+    math(EXPR REMAINDER "${HEX_LENGTH} % 8")
+    if (HEX_LENGTH EQUAL 0 OR NOT REMAINDER EQUAL 0)
+        message(FATAL_ERROR "${SHADER} is not a valid SPIR-V binary")
+    endif ()
+
+    # SPIR-V words are little-endian
+    string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1,\n" WORDS ${HEX})
+
+    string(APPEND ARRAYS
+            "alignas(16) inline constexpr std::uint32_t ${IDENTIFIER}[] {\n"
+            "${WORDS}};\n\n")
+    string(APPEND TABLE "    {\"${NAME}\", ${IDENTIFIER}},\n")
+endforeach ()
+
+file(WRITE ${OUTPUT}
+        "// Generated by cmake/embed_shaders.cmake, do not edit\n\n"
+        "#ifndef EMBEDDED_SHADERS_HPP\n"
+        "#define EMBEDDED_SHADERS_HPP\n\n"
+        "#include <cstdint>\n"
+        "#include <span>\n"
+        "#include <string_view>\n\n"
+        "namespace embedded_shaders\n{\n\n"
+        "${ARRAYS}"
+        "struct Shader\n{\n"
+        "    std::string_view name;\n"
+        "    std::span<const std::uint32_t> code;\n"
+        "};\n\n"
+        "inline constexpr Shader g_shaders[] {\n"
+        "${TABLE}};\n\n"
+        "} // namespace embedded_shaders\n\n"
+        "#endif // EMBEDDED_SHADERS_HPP\n")
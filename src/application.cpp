@@ -1,5 +1,7 @@
 #include "application.hpp"
 
+#include "profiler.hpp"
+
 #include "imgui.h"
 
 #include <iostream>
@@ -8,6 +10,16 @@
 namespace
 {
 
+constexpr std::uint32_t g_default_width {1280};
+constexpr std::uint32_t g_default_height {720};
+
+// Written with F12
+constexpr auto g_trace_path = "trace.json";
+constexpr std::size_t g_trace_frame_count {120};
+
+// Recorded to with F10 if the config does not set a capture path
+constexpr auto g_default_capture_path = "capture.y4m";
+
 [[noreturn]] void glfw_fatal(int error, const char *description)
 {
     std::ostringstream oss;
@@ -39,12 +51,18 @@ Application::ImGui_context::~ImGui_context()
     ImGui::DestroyContext();
 }
 
-Application::Application()
+Application::Application(const Config &config)
+    : m_capture_path {config.capture.empty() ? g_default_capture_path
+                                             : config.capture}
 {
     glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
     m_window = std::unique_ptr<GLFWwindow, decltype(&glfwDestroyWindow)>(
-        glfwCreateWindow(1280, 720, "Vulkan engine", nullptr, nullptr),
+        glfwCreateWindow(static_cast<int>(g_default_width),
+                         static_cast<int>(g_default_height),
+                         "Vulkan engine",
+                         nullptr,
+                         nullptr),
         &glfwDestroyWindow);
 
     glfwSetWindowUserPointer(m_window.get(), this);
@@ -56,21 +74,54 @@ Application::Application()
     int height {};
     glfwGetFramebufferSize(m_window.get(), &width, &height);
 
+    m_job_system = std::make_unique<Job_system>();
+
     m_renderer = std::make_unique<Renderer>(m_window.get(),
                                             static_cast<std::uint32_t>(width),
-                                            static_cast<std::uint32_t>(height));
+                                            static_cast<std::uint32_t>(height),
+                                            config,
+                                            *m_job_system);
+
+    m_game_loop = std::make_unique<Game_loop>(config.sprite_count,
+                                              config.update_rate,
+                                              config.simulation_thread,
+                                              *m_job_system);
 }
 
 void Application::run()
 {
     while (!glfwWindowShouldClose(m_window.get()))
     {
-        glfwPollEvents();
-
-        double x, y;
-        glfwGetCursorPos(m_window.get(), &x, &y);
-
-        m_renderer->draw_frame({static_cast<float>(x), static_cast<float>(y)});
+        profiler_mark_frame();
+        const Profile_zone frame_zone {"Frame"};
+
+        {
+            const Profile_zone zone {"Poll events"};
+            glfwPollEvents();
+        }
+
+        const auto sprites = [this]
+        {
+            const Profile_zone zone {"Simulate"};
+            return m_game_loop->advance();
+        }();
+
+        m_renderer->draw_frame(
+            [window = m_window.get()]
+            {
+                double x, y;
+                glfwGetCursorPos(window, &x, &y);
+                return glm::vec2 {static_cast<float>(x),
+                                  static_cast<float>(y)};
+            },
+            sprites);
+
+        // Against the sprites of the frame, where the cursor was sampled
+        {
+            const Profile_zone zone {"Pick"};
+            m_renderer->set_picked_sprite(
+                m_game_loop->pick(m_renderer->cursor_sprite_position()));
+        }
     }
 }
 
@@ -86,6 +137,42 @@ void Application::key_callback(
         else
             app->set_fullscreen();
     }
+    else if (action == GLFW_PRESS && key == GLFW_KEY_F10)
+    {
+        const auto app =
+            static_cast<Application *>(glfwGetWindowUserPointer(window));
+        if (app->m_renderer->is_capturing())
+        {
+            app->m_renderer->stop_capture();
+            return;
+        }
+
+        // Not fatal either
+        try
+        {
+            app->m_renderer->start_capture(app->m_capture_path);
+            std::cout << "Recording to " << app->m_capture_path.string()
+                      << '\n';
+        }
+        catch (const std::runtime_error &e)
+        {
+            std::cerr << e.what() << '\n';
+        }
+    }
+    else if (action == GLFW_PRESS && key == GLFW_KEY_F12)
+    {
+        // A failed dump is not fatal
+        try
+        {
+            write_chrome_trace(g_trace_path, g_trace_frame_count);
+            std::cout << "Wrote the last " << g_trace_frame_count
+                      << " frames to " << g_trace_path << '\n';
+        }
+        catch (const std::runtime_error &e)
+        {
+            std::cerr << e.what() << '\n';
+        }
+    }
 }
 
 void Application::framebuffer_size_callback(GLFWwindow *window,
@@ -120,8 +207,8 @@ void Application::set_windowed()
 {
     const auto monitor = glfwGetPrimaryMonitor();
     const auto video_mode = glfwGetVideoMode(monitor);
-    constexpr int width {1280};
-    constexpr int height {720};
+    constexpr auto width = static_cast<int>(g_default_width);
+    constexpr auto height = static_cast<int>(g_default_height);
     glfwSetWindowMonitor(m_window.get(),
                          nullptr,
                          (video_mode->width - width) / 2,
@@ -129,4 +216,40 @@ void Application::set_windowed()
                          width,
                          height,
                          GLFW_DONT_CARE);
-}
\ No newline at end of file
+}
+
+void run_headless(const Config &config)
+{
+    Job_system job_system;
+    Renderer renderer(
+        nullptr, g_default_width, g_default_height, config, job_system);
+
+    // A fixed cursor keeps the frames reproducible
+    const auto sample_cursor = []
+    {
+        return glm::vec2 {static_cast<float>(g_default_width) * 0.5f,
+                          static_cast<float>(g_default_height) * 0.5f};
+    };
+
+    if (!config.capture.empty())
+    {
+        renderer.start_capture(config.capture);
+    }
+
+    Simulation simulation(config.sprite_count);
+    const auto step = 1.0f / static_cast<float>(config.update_rate);
+
+    for (std::uint32_t i {}; i < config.headless_frames; ++i)
+    {
+        profiler_mark_frame();
+        simulation.update(step, job_system);
+        renderer.draw_frame(sample_cursor, simulation.sprites());
+    }
+
+    renderer.stop_capture();
+
+    if (!config.output.empty())
+    {
+        renderer.write_last_frame_to_png(config.output);
+    }
+}
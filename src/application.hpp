@@ -1,17 +1,21 @@
 #ifndef APPLICATION_HPP
 #define APPLICATION_HPP
 
+#include "config.hpp"
+#include "game_loop.hpp"
+#include "job_system.hpp"
 #include "renderer.hpp"
 
 #include <GLFW/glfw3.h>
 
+#include <filesystem>
 #include <memory>
 #include <vector>
 
 class Application
 {
 public:
-    [[nodiscard]] Application();
+    [[nodiscard]] explicit Application(const Config &config);
 
     Application(const Application &) = delete;
     Application &operator=(const Application &) = delete;
@@ -46,7 +50,21 @@ private:
         ~ImGui_context();
     } m_imgui_context {};
 
+    // Toggled with F10
+    std::filesystem::path m_capture_path;
+
+    // Used by the renderer and the game loop, destroyed after them
+    std::unique_ptr<Job_system> m_job_system {};
+
     std::unique_ptr<Renderer> m_renderer {};
+
+    std::unique_ptr<Game_loop> m_game_loop {};
 };
 
+// Renders config.headless_frames frames without a window, recording them to
+// config.capture if it is set, then writes the last one to config.output if
+// it is set. The simulation advances by one step per frame, so the frames are
+// reproducible.
+void run_headless(const Config &config);
+
 #endif // APPLICATION_HPP
@@ -0,0 +1,111 @@
+#include "asset_registry.hpp"
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+Asset_registry::Asset_registry(std::filesystem::path cache_directory)
+    : m_cache_directory {std::move(cache_directory)}
+{
+    std::error_code error;
+    std::filesystem::create_directories(m_cache_directory, error);
+    m_cache_enabled = !error;
+    if (!m_cache_enabled)
+    {
+        std::cerr << "Failed to create asset cache directory "
+                  << m_cache_directory << ": " << error.message() << '\n';
+    }
+}
+
+std::optional<std::uint32_t> Asset_registry::acquire(Asset_hash hash)
+{
+    const auto it = m_entries.find(hash);
+    if (it == m_entries.end())
+    {
+        return std::nullopt;
+    }
+
+    ++it->second.reference_count;
+    return it->second.resource;
+}
+
+void Asset_registry::insert(Asset_hash hash, std::uint32_t resource)
+{
+    m_entries.insert_or_assign(
+        hash, Entry {.resource = resource, .reference_count = 1});
+}
+
+bool Asset_registry::release(Asset_hash hash)
+{
+    const auto it = m_entries.find(hash);
+    if (it == m_entries.end())
+    {
+        return false;
+    }
+
+    if (--it->second.reference_count == 0)
+    {
+        m_entries.erase(it);
+        return true;
+    }
+
+    return false;
+}
+
+bool Asset_registry::rename(Asset_hash old_hash, Asset_hash new_hash)
+{
+    if (old_hash == new_hash)
+    {
+        return true;
+    }
+
+    const auto it = m_entries.find(old_hash);
+    if (it == m_entries.end() || m_entries.contains(new_hash))
+    {
+        return false;
+    }
+
+    const auto entry = it->second;
+    m_entries.erase(it);
+    m_entries.emplace(new_hash, entry);
+    return true;
+}
+
+File_view Asset_registry::load_cached(Asset_hash hash,
+                                      std::string_view kind) const
+{
+    if (!m_cache_enabled)
+    {
+        return {};
+    }
+
+    const auto path = cache_path(hash, kind);
+    if (!std::filesystem::exists(path))
+    {
+        return {};
+    }
+
+    return open_file_view(path);
+}
+
+void Asset_registry::store_cached(
+    Asset_hash hash,
+    std::string_view kind,
+    std::initializer_list<std::span<const std::uint8_t>> chunks) const
+{
+    if (!m_cache_enabled)
+    {
+        return;
+    }
+
+    write_file_atomically(cache_path(hash, kind), chunks);
+}
+
+std::filesystem::path Asset_registry::cache_path(Asset_hash hash,
+                                                 std::string_view kind) const
+{
+    std::ostringstream filename;
+    filename << std::hex << std::setw(16) << std::setfill('0') << hash << '.'
+             << kind;
+    return m_cache_directory / filename.str();
+}
@@ -0,0 +1,71 @@
+#ifndef ASSET_REGISTRY_HPP
+#define ASSET_REGISTRY_HPP
+
+#include "utils.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <initializer_list>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <unordered_map>
+
+using Asset_hash = std::uint64_t;
+
+// Identifies assets by a hash of their content, so that identical files
+// referenced under different paths share a single resource, and keeps decoded
+// or baked results on disk so that later runs do not need to redo the work.
+//
+// The resource map is not thread-safe, but the disk cache functions are.
+class Asset_registry
+{
+public:
+    [[nodiscard]] explicit Asset_registry(
+        std::filesystem::path cache_directory);
+
+    // Returns the resource holding this content and adds a reference to it, or
+    // nothing if there is no such resource yet
+    [[nodiscard]] std::optional<std::uint32_t> acquire(Asset_hash hash);
+
+    // Associates a new resource to the content, with a single reference
+    void insert(Asset_hash hash, std::uint32_t resource);
+
+    // Returns true if this was the last reference, in which case the resource
+    // can be destroyed
+    [[nodiscard]] bool release(Asset_hash hash);
+
+    // Moves the resource and its references to the new content, when its
+    // source was edited. Returns false, changing nothing, if another resource
+    // already holds the new content.
+    [[nodiscard]] bool rename(Asset_hash old_hash, Asset_hash new_hash);
+
+    // Returns an empty view on a cache miss. kind distinguishes different
+    // results derived from the same content.
+    [[nodiscard]] File_view load_cached(Asset_hash hash,
+                                        std::string_view kind) const;
+
+    // The chunks are concatenated. The file is written atomically, a reader
+    // either sees the whole entry or a cache miss.
+    void
+    store_cached(Asset_hash hash,
+                 std::string_view kind,
+                 std::initializer_list<std::span<const std::uint8_t>> chunks)
+        const;
+
+private:
+    [[nodiscard]] std::filesystem::path cache_path(Asset_hash hash,
+                                                   std::string_view kind) const;
+
+    struct Entry
+    {
+        std::uint32_t resource;
+        std::uint32_t reference_count;
+    };
+
+    std::filesystem::path m_cache_directory;
+    bool m_cache_enabled {};
+    std::unordered_map<Asset_hash, Entry> m_entries {};
+};
+
+#endif // ASSET_REGISTRY_HPP
@@ -0,0 +1,264 @@
+#include "config.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+
+constexpr std::array<std::string_view, g_present_mode_count>
+    g_present_mode_names {"fifo", "fifo_relaxed", "mailbox", "immediate"};
+
+[[nodiscard]] std::string_view trim(std::string_view str)
+{
+    constexpr std::string_view whitespace {" \t\r"};
+    const auto first = str.find_first_not_of(whitespace);
+    if (first == std::string_view::npos)
+    {
+        return {};
+    }
+    const auto last = str.find_last_not_of(whitespace);
+    return str.substr(first, last - first + 1);
+}
+
+// what names the value in the error message
+[[nodiscard]] std::uint32_t parse_uint(std::string_view value,
+                                       std::uint32_t min,
+                                       std::uint32_t max,
+                                       std::string_view what)
+{
+    std::uint32_t result {};
+    const auto [ptr, error] =
+        std::from_chars(value.data(), value.data() + value.size(), result);
+    if (error != std::errc {} || ptr != value.data() + value.size() ||
+        result < min || result > max)
+    {
+        throw std::runtime_error("Invalid " + std::string(what) + " \"" +
+                                 std::string(value) + "\", expected " +
+                                 std::to_string(min) + " to " +
+                                 std::to_string(max));
+    }
+    return result;
+}
+
+[[nodiscard]] bool parse_bool(std::string_view value)
+{
+    if (value == "true")
+    {
+        return true;
+    }
+    if (value == "false")
+    {
+        return false;
+    }
+    throw std::runtime_error("Invalid value \"" + std::string(value) +
+                             "\", expected true or false");
+}
+
+[[nodiscard]] Present_mode parse_present_mode_or_throw(std::string_view value)
+{
+    const auto present_mode = parse_present_mode(value);
+    if (!present_mode.has_value())
+    {
+        throw std::runtime_error(
+            "Invalid present mode \"" + std::string(value) +
+            "\", expected fifo, fifo_relaxed, mailbox or immediate");
+    }
+    return *present_mode;
+}
+
+// --foo-bar sets foo_bar, except for the shorter aliases
+[[nodiscard]] std::string option_key(std::string_view option)
+{
+    if (option == "headless")
+    {
+        return "headless_frames";
+    }
+    if (option == "sprites")
+    {
+        return "sprite_count";
+    }
+
+    std::string key {option};
+    std::replace(key.begin(), key.end(), '-', '_');
+    return key;
+}
+
+// Returns false if the key is unknown
+bool apply_setting(std::string_view key, std::string_view value, Config &config)
+{
+    if (key == "present_mode")
+    {
+        config.present_mode = parse_present_mode_or_throw(value);
+        return true;
+    }
+    if (key == "frames_in_flight")
+    {
+        config.frames_in_flight = parse_uint(value,
+                                             g_min_frames_in_flight,
+                                             g_max_frames_in_flight,
+                                             "frames in flight");
+        return true;
+    }
+    if (key == "headless_frames")
+    {
+        config.headless_frames =
+            parse_uint(value,
+                       0,
+                       std::numeric_limits<std::uint32_t>::max(),
+                       "headless frame count");
+        return true;
+    }
+    if (key == "output")
+    {
+        config.output = value;
+        return true;
+    }
+    if (key == "sprite_count")
+    {
+        config.sprite_count =
+            parse_uint(value, 0, g_max_sprite_count, "sprite count");
+        return true;
+    }
+    if (key == "capture")
+    {
+        config.capture = value;
+        return true;
+    }
+    if (key == "update_rate")
+    {
+        config.update_rate =
+            parse_uint(value, 1, g_max_update_rate, "update rate");
+        return true;
+    }
+    if (key == "texture_budget")
+    {
+        config.texture_budget =
+            parse_uint(value, 0, g_max_texture_budget, "texture budget");
+        return true;
+    }
+    if (key == "simulation_thread")
+    {
+        config.simulation_thread = parse_bool(value);
+        return true;
+    }
+    return false;
+}
+
+} // namespace
+
+std::string_view present_mode_name(Present_mode present_mode)
+{
+    return g_present_mode_names[static_cast<std::size_t>(present_mode)];
+}
+
+std::optional<Present_mode> parse_present_mode(std::string_view name)
+{
+    for (std::size_t i {}; i < g_present_mode_names.size(); ++i)
+    {
+        if (g_present_mode_names[i] == name)
+        {
+            return static_cast<Present_mode>(i);
+        }
+    }
+    return std::nullopt;
+}
+
+void read_config_file(const std::filesystem::path &path, Config &config)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        throw std::runtime_error("Failed to open config file " +
+                                 path.string());
+    }
+
+    std::string line;
+    for (std::size_t line_number {1}; std::getline(file, line); ++line_number)
+    {
+        std::string_view content {line};
+        content = trim(content.substr(0, content.find('#')));
+        if (content.empty())
+        {
+            continue;
+        }
+
+        const auto location = path.string() + ":" + std::to_string(line_number);
+
+        const auto separator = content.find('=');
+        if (separator == std::string_view::npos)
+        {
+            throw std::runtime_error(location + ": expected key = value");
+        }
+
+        const auto key = trim(content.substr(0, separator));
+        const auto value = trim(content.substr(separator + 1));
+        try
+        {
+            if (!apply_setting(key, value, config))
+            {
+                throw std::runtime_error("Unknown setting \"" +
+                                         std::string(key) + "\"");
+            }
+        }
+        catch (const std::runtime_error &e)
+        {
+            throw std::runtime_error(location + ": " + e.what());
+        }
+    }
+}
+
+Config load_config(int argc, const char *const argv[])
+{
+    std::optional<std::filesystem::path> config_path;
+    for (int i {1}; i + 1 < argc; ++i)
+    {
+        if (std::string_view {argv[i]} == "--config")
+        {
+            config_path = argv[i + 1];
+        }
+    }
+
+    Config config {};
+    if (config_path.has_value())
+    {
+        read_config_file(*config_path, config);
+    }
+    else if (std::filesystem::exists(g_default_config_path))
+    {
+        read_config_file(g_default_config_path, config);
+    }
+
+    // Command line options override the config file
+    for (int i {1}; i < argc; ++i)
+    {
+        const std::string_view option {argv[i]};
+        if (!option.starts_with("--") ||
+            option.find('_') != std::string_view::npos)
+        {
+            throw std::runtime_error("Unknown option " + std::string(option));
+        }
+        if (i + 1 == argc)
+        {
+            throw std::runtime_error("Missing value for " +
+                                     std::string(option));
+        }
+
+        const std::string_view value {argv[++i]};
+        if (option == "--config")
+        {
+            continue;
+        }
+        if (!apply_setting(option_key(option.substr(2)), value, config))
+        {
+            throw std::runtime_error("Unknown option " + std::string(option));
+        }
+    }
+
+    return config;
+}
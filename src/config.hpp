@@ -0,0 +1,75 @@
+#ifndef CONFIG_HPP
+#define CONFIG_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string_view>
+
+enum class Present_mode : std::uint8_t
+{
+    fifo,
+    fifo_relaxed,
+    mailbox,
+    immediate
+};
+
+inline constexpr std::size_t g_present_mode_count {4};
+
+inline constexpr std::uint32_t g_min_frames_in_flight {1};
+inline constexpr std::uint32_t g_max_frames_in_flight {4};
+
+// Sprites are drawn in batches, this only bounds their vertex buffers
+inline constexpr std::uint32_t g_max_sprite_count {1 << 20};
+
+// In simulation steps per second
+inline constexpr std::uint32_t g_max_update_rate {1000};
+
+// In MiB
+inline constexpr std::uint32_t g_max_texture_budget {1 << 16};
+
+// The present mode and frames in flight can be changed without a restart. The
+// present mode is a request, the renderer falls back to a mode that the
+// surface supports.
+struct Config
+{
+    Present_mode present_mode {Present_mode::fifo};
+    std::uint32_t frames_in_flight {2};
+    // Renders this many frames without a window and exits, 0 opens a window
+    std::uint32_t headless_frames {};
+    // Where the last headless frame is written as PNG, if not empty
+    std::filesystem::path output {};
+    // Sprites bouncing over the scene
+    std::uint32_t sprite_count {};
+    // Simulation steps per second, independent of the frame rate
+    std::uint32_t update_rate {60};
+    // Otherwise the simulation runs on the main thread between frames
+    bool simulation_thread {};
+    // Where frames are recorded, a .y4m file or a directory of PNGs. F10
+    // toggles recording, headless every frame is recorded if it is set.
+    std::filesystem::path capture {};
+    // Full-resolution textures over this many MiB are evicted, least recently
+    // used first, and reloaded on their next use
+    std::uint32_t texture_budget {256};
+};
+
+inline constexpr auto g_default_config_path = "engine.cfg";
+
+// Names used in config files and on the command line, e.g. "fifo_relaxed"
+[[nodiscard]] std::string_view present_mode_name(Present_mode present_mode);
+
+[[nodiscard]] std::optional<Present_mode>
+parse_present_mode(std::string_view name);
+
+// Reads "key = value" lines, '#' starts a comment. Throws std::runtime_error
+// if the file cannot be read, or on unknown keys and invalid values.
+void read_config_file(const std::filesystem::path &path, Config &config);
+
+// Reads the config file given by --config <path>, or g_default_config_path if
+// it exists, then applies the command line options: --foo-bar <value> sets
+// foo_bar, e.g. --present-mode mailbox, and --headless <frames> and
+// --sprites <n> are short for headless_frames and sprite_count. Throws
+// std::runtime_error on invalid arguments.
+[[nodiscard]] Config load_config(int argc, const char *const argv[]);
+
+#endif // CONFIG_HPP
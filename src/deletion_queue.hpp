@@ -0,0 +1,52 @@
+#ifndef DELETION_QUEUE_HPP
+#define DELETION_QUEUE_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Keeps objects alive until the frame that last used them has retired
+class Deletion_queue
+{
+public:
+    template <typename T>
+    void push(std::uint64_t frame_number, T &&object)
+    {
+        using Object = std::remove_cvref_t<T>;
+        m_entries.push_back(
+            {frame_number, std::make_shared<Object>(std::forward<T>(object))});
+    }
+
+    // Destroys every object whose frame is less than or equal to
+    // retired_frame_number
+    void collect(std::uint64_t retired_frame_number)
+    {
+        std::erase_if(m_entries,
+                      [&](const Entry &entry)
+                      { return entry.frame_number <= retired_frame_number; });
+    }
+
+    void clear() noexcept
+    {
+        m_entries.clear();
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept
+    {
+        return m_entries.size();
+    }
+
+private:
+    struct Entry
+    {
+        std::uint64_t frame_number;
+        std::shared_ptr<void> object;
+    };
+
+    std::vector<Entry> m_entries {};
+};
+
+#endif // DELETION_QUEUE_HPP
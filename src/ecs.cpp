@@ -0,0 +1,314 @@
+#include "ecs.hpp"
+
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+
+struct Component_type
+{
+    std::size_t size;
+    std::size_t alignment;
+};
+
+std::mutex g_component_types_mutex;
+std::vector<Component_type> g_component_types;
+
+[[nodiscard]] Component_type component_type(Component_id id)
+{
+    const std::scoped_lock lock {g_component_types_mutex};
+    return g_component_types[id];
+}
+
+// Calls function(id) for each component in the mask, in the order of the ids
+template <typename F>
+void for_each_component(Component_mask mask, F &&function)
+{
+    for (; mask != 0; mask &= mask - 1)
+    {
+        function(static_cast<Component_id>(std::countr_zero(mask)));
+    }
+}
+
+[[nodiscard]] std::size_t align_up(std::size_t offset, std::size_t alignment)
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+[[nodiscard]] Archetype create_archetype(Component_mask mask)
+{
+    // The padding between the arrays is at most the sum of the alignments
+    std::size_t row_size {sizeof(Entity)};
+    std::size_t max_padding {};
+    for_each_component(mask,
+                       [&](Component_id id)
+                       {
+                           const auto type = component_type(id);
+                           row_size += type.size;
+                           max_padding += type.alignment;
+                       });
+    if (max_padding + row_size > g_chunk_size)
+    {
+        throw std::runtime_error("The components of an entity are larger "
+                                 "than a chunk");
+    }
+
+    Archetype archetype {
+        .mask = mask,
+        .capacity = static_cast<std::uint32_t>((g_chunk_size - max_padding) /
+                                               row_size),
+        .offsets = {},
+        .sizes = {},
+        .chunks = {}};
+
+    // The entities come first
+    auto offset = std::size_t {archetype.capacity} * sizeof(Entity);
+    for_each_component(mask,
+                       [&](Component_id id)
+                       {
+                           const auto type = component_type(id);
+                           offset = align_up(offset, type.alignment);
+                           archetype.offsets[id] =
+                               static_cast<std::uint32_t>(offset);
+                           archetype.sizes[id] =
+                               static_cast<std::uint32_t>(type.size);
+                           offset += archetype.capacity * type.size;
+                       });
+
+    return archetype;
+}
+
+[[nodiscard]] Entity *entities(Archetype_chunk &chunk) noexcept
+{
+    return reinterpret_cast<Entity *>(chunk.storage->bytes);
+}
+
+[[nodiscard]] std::byte *component(const Archetype &archetype,
+                                   Archetype_chunk &chunk,
+                                   Component_id id,
+                                   std::uint32_t row)
+{
+    return chunk.storage->bytes + archetype.offsets[id] +
+           std::size_t {row} * archetype.sizes[id];
+}
+
+} // namespace
+
+Component_id register_component_type(std::size_t size, std::size_t alignment)
+{
+    const std::scoped_lock lock {g_component_types_mutex};
+    if (g_component_types.size() >= g_max_component_types)
+    {
+        throw std::runtime_error("More than " +
+                                 std::to_string(g_max_component_types) +
+                                 " component types");
+    }
+    g_component_types.push_back({.size = size, .alignment = alignment});
+    return static_cast<Component_id>(g_component_types.size() - 1);
+}
+
+void World::destroy(Entity entity)
+{
+    if (!is_alive(entity))
+    {
+        throw std::runtime_error("The entity is not alive");
+    }
+
+    auto &record = m_records[entity.index];
+    remove_row(record);
+    ++record.generation;
+    m_free_indices.push_back(entity.index);
+    --m_size;
+}
+
+bool World::is_alive(Entity entity) const noexcept
+{
+    return entity.index < m_records.size() &&
+           m_records[entity.index].generation == entity.generation;
+}
+
+Entity World::create_entity(Component_mask mask)
+{
+    Entity entity {};
+    if (m_free_indices.empty())
+    {
+        entity = {.index = static_cast<std::uint32_t>(m_records.size()),
+                  .generation = 0};
+        m_records.push_back({});
+    }
+    else
+    {
+        entity = {.index = m_free_indices.back(),
+                  .generation = m_records[m_free_indices.back()].generation};
+        m_free_indices.pop_back();
+    }
+
+    m_records[entity.index] = insert_row(find_archetype(mask), entity);
+    ++m_size;
+    return entity;
+}
+
+Component_mask World::entity_mask(Entity entity) const
+{
+    if (!is_alive(entity))
+    {
+        throw std::runtime_error("The entity is not alive");
+    }
+    return m_archetypes[m_records[entity.index].archetype].mask;
+}
+
+void World::set_mask(Entity entity, Component_mask mask)
+{
+    const auto source = m_records[entity.index];
+    if (m_archetypes[source.archetype].mask == mask)
+    {
+        return;
+    }
+
+    // Before taking references, it may add an archetype
+    const auto archetype_index = find_archetype(mask);
+    const auto destination = insert_row(archetype_index, entity);
+
+    auto &source_archetype = m_archetypes[source.archetype];
+    auto &destination_archetype = m_archetypes[archetype_index];
+    auto &source_chunk = source_archetype.chunks[source.chunk];
+    auto &destination_chunk = destination_archetype.chunks[destination.chunk];
+    for_each_component(
+        source_archetype.mask & mask,
+        [&](Component_id id)
+        {
+            std::memcpy(
+                component(destination_archetype,
+                          destination_chunk,
+                          id,
+                          destination.row),
+                component(source_archetype, source_chunk, id, source.row),
+                source_archetype.sizes[id]);
+        });
+
+    remove_row(source);
+    m_records[entity.index] = destination;
+}
+
+std::byte *World::find_component(Entity entity, Component_id id) noexcept
+{
+    if (!is_alive(entity))
+    {
+        return nullptr;
+    }
+
+    const auto &record = m_records[entity.index];
+    auto &archetype = m_archetypes[record.archetype];
+    if ((archetype.mask & (Component_mask {1} << id)) == 0)
+    {
+        return nullptr;
+    }
+    return component(archetype, archetype.chunks[record.chunk], id, record.row);
+}
+
+std::uint32_t World::find_archetype(Component_mask mask)
+{
+    if (const auto it = m_archetype_indices.find(mask);
+        it != m_archetype_indices.end())
+    {
+        return it->second;
+    }
+
+    const auto index = static_cast<std::uint32_t>(m_archetypes.size());
+    m_archetypes.push_back(create_archetype(mask));
+    m_archetype_indices.emplace(mask, index);
+    return index;
+}
+
+World::Entity_record World::insert_row(std::uint32_t archetype_index,
+                                       Entity entity)
+{
+    auto &archetype = m_archetypes[archetype_index];
+    if (archetype.chunks.empty() ||
+        archetype.chunks.back().size == archetype.capacity)
+    {
+        archetype.chunks.push_back(
+            {.storage =
+                 std::make_unique_for_overwrite<Archetype_chunk::Storage>(),
+             .size = 0});
+    }
+
+    auto &chunk = archetype.chunks.back();
+    const auto row = chunk.size++;
+    entities(chunk)[row] = entity;
+    return {.archetype = archetype_index,
+            .chunk = static_cast<std::uint32_t>(archetype.chunks.size() - 1),
+            .row = row,
+            .generation = entity.generation};
+}
+
+void World::remove_row(const Entity_record &record)
+{
+    auto &archetype = m_archetypes[record.archetype];
+    auto &chunk = archetype.chunks[record.chunk];
+    auto &last_chunk = archetype.chunks.back();
+    const auto last_row = last_chunk.size - 1;
+
+    if (&chunk != &last_chunk || record.row != last_row)
+    {
+        const auto moved = entities(last_chunk)[last_row];
+        entities(chunk)[record.row] = moved;
+        for_each_component(
+            archetype.mask,
+            [&](Component_id id)
+            {
+                std::memcpy(component(archetype, chunk, id, record.row),
+                            component(archetype, last_chunk, id, last_row),
+                            archetype.sizes[id]);
+            });
+        m_records[moved.index].chunk = record.chunk;
+        m_records[moved.index].row = record.row;
+    }
+
+    if (--last_chunk.size == 0)
+    {
+        archetype.chunks.pop_back();
+    }
+}
+
+void Command_buffer::destroy(Entity entity)
+{
+    record(
+        [=](World &world)
+        {
+            if (world.is_alive(entity))
+            {
+                world.destroy(entity);
+            }
+        });
+}
+
+void Command_buffer::apply(World &world)
+{
+    std::vector<std::function<void(World &)>> commands;
+    {
+        const std::scoped_lock lock {m_mutex};
+        commands = std::move(m_commands);
+        m_commands.clear();
+    }
+
+    for (const auto &command : commands)
+    {
+        command(world);
+    }
+}
+
+bool Command_buffer::empty() const
+{
+    const std::scoped_lock lock {m_mutex};
+    return m_commands.empty();
+}
+
+void Command_buffer::record(std::function<void(World &)> command)
+{
+    const std::scoped_lock lock {m_mutex};
+    m_commands.push_back(std::move(command));
+}
@@ -0,0 +1,304 @@
+#ifndef ECS_HPP
+#define ECS_HPP
+
+#include "job_system.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+using Component_id = std::uint32_t;
+using Component_mask = std::uint64_t;
+
+// One bit of a Component_mask each
+inline constexpr std::uint32_t g_max_component_types {64};
+
+// Entities of an archetype are stored in chunks of this size
+inline constexpr std::size_t g_chunk_size {16384};
+
+// Stays valid until the entity is destroyed, its index is then reused with the
+// next generation
+struct Entity
+{
+    std::uint32_t index;
+    std::uint32_t generation;
+
+    [[nodiscard]] bool operator==(const Entity &) const = default;
+};
+
+// Returns a new id on each call. Throws std::runtime_error after
+// g_max_component_types ids. Thread-safe.
+[[nodiscard]] Component_id register_component_type(std::size_t size,
+                                                   std::size_t alignment);
+
+// Any trivially copyable type can be a component, the id is assigned on first
+// use
+template <typename T>
+[[nodiscard]] Component_id component_id()
+{
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "Components are moved between chunks with memcpy");
+    static const auto id = register_component_type(sizeof(T), alignof(T));
+    return id;
+}
+
+template <typename... Ts>
+[[nodiscard]] Component_mask component_mask()
+{
+    return ((Component_mask {1} << component_id<std::remove_const_t<Ts>>()) |
+            ... | Component_mask {});
+}
+
+// Entities with the same set of components, stored in chunks of structures of
+// arrays: each chunk holds an array of entities followed by one array per
+// component. The chunks are full except the last one.
+struct Archetype_chunk
+{
+    struct alignas(64) Storage
+    {
+        std::byte bytes[g_chunk_size];
+    };
+
+    std::unique_ptr<Storage> storage;
+    std::uint32_t size;
+};
+
+struct Archetype
+{
+    Component_mask mask;
+    // Entities per chunk
+    std::uint32_t capacity;
+    // Of the array of each component in a chunk, and of its elements, indexed
+    // by component id
+    std::array<std::uint32_t, g_max_component_types> offsets;
+    std::array<std::uint32_t, g_max_component_types> sizes;
+    std::vector<Archetype_chunk> chunks;
+};
+
+// Entities and their components, grouped by archetype. Adding or removing
+// entities and components is a structural change, which moves entities
+// between chunks: it must not happen while iterating, record it in a
+// Command_buffer instead.
+class World
+{
+public:
+    template <typename... Ts>
+    Entity create(const Ts &...components)
+    {
+        const auto entity = create_entity(component_mask<Ts...>());
+        (write_component(entity, components), ...);
+        return entity;
+    }
+
+    // Throws std::runtime_error if the entity is not alive, like add and
+    // remove
+    void destroy(Entity entity);
+
+    [[nodiscard]] bool is_alive(Entity entity) const noexcept;
+
+    // Null if the entity is not alive or does not have the component. Valid
+    // until the next structural change.
+    template <typename T>
+    [[nodiscard]] T *get(Entity entity) noexcept
+    {
+        return reinterpret_cast<T *>(find_component(
+            entity, component_id<std::remove_const_t<T>>()));
+    }
+
+    // Replaces the component if the entity already has it
+    template <typename T>
+    void add(Entity entity, const T &component)
+    {
+        set_mask(entity, entity_mask(entity) | component_mask<T>());
+        write_component(entity, component);
+    }
+
+    template <typename T>
+    void remove(Entity entity)
+    {
+        set_mask(entity, entity_mask(entity) & ~component_mask<T>());
+    }
+
+    // Number of entities alive
+    [[nodiscard]] std::size_t size() const noexcept
+    {
+        return m_size;
+    }
+
+    // Calls function(entities, components...) with a span of each component
+    // for every chunk whose entities have all the components Ts, e.g.
+    // for_each_chunk<Sprite, const Velocity>(...). Query const components
+    // for read-only access.
+    template <typename... Ts, typename F>
+    void for_each_chunk(F &&function)
+    {
+        const auto mask = component_mask<Ts...>();
+        for (auto &archetype : m_archetypes)
+        {
+            if ((archetype.mask & mask) != mask)
+            {
+                continue;
+            }
+            for (auto &chunk : archetype.chunks)
+            {
+                function(chunk_entities(chunk),
+                         chunk_components<Ts>(archetype, chunk)...);
+            }
+        }
+    }
+
+    // Same, with the chunks spread over the threads of the job system. Chunks
+    // of different entities may be processed concurrently, and there must be
+    // no structural changes until it returns.
+    template <typename... Ts, typename F>
+    void parallel_for_each_chunk(Job_system &job_system, F &&function)
+    {
+        const auto mask = component_mask<Ts...>();
+        std::vector<std::pair<Archetype *, Archetype_chunk *>> chunks;
+        for (auto &archetype : m_archetypes)
+        {
+            if ((archetype.mask & mask) != mask)
+            {
+                continue;
+            }
+            for (auto &chunk : archetype.chunks)
+            {
+                chunks.emplace_back(&archetype, &chunk);
+            }
+        }
+
+        job_system.parallel_for(
+            chunks.size(),
+            1,
+            [&](std::size_t first, std::size_t last)
+            {
+                for (auto i = first; i < last; ++i)
+                {
+                    auto &[archetype, chunk] = chunks[i];
+                    function(chunk_entities(*chunk),
+                             chunk_components<Ts>(*archetype, *chunk)...);
+                }
+            });
+    }
+
+private:
+    struct Entity_record
+    {
+        std::uint32_t archetype;
+        std::uint32_t chunk;
+        std::uint32_t row;
+        std::uint32_t generation;
+    };
+
+    // The components are left uninitialized
+    [[nodiscard]] Entity create_entity(Component_mask mask);
+
+    [[nodiscard]] Component_mask entity_mask(Entity entity) const;
+
+    // Moves the entity to the archetype of the mask, keeping the components
+    // both archetypes have
+    void set_mask(Entity entity, Component_mask mask);
+
+    [[nodiscard]] std::byte *find_component(Entity entity,
+                                            Component_id id) noexcept;
+
+    [[nodiscard]] std::uint32_t find_archetype(Component_mask mask);
+
+    // Appends an uninitialized row to the last chunk
+    [[nodiscard]] Entity_record insert_row(std::uint32_t archetype_index,
+                                           Entity entity);
+
+    // Moves the last row of the archetype into the removed one
+    void remove_row(const Entity_record &record);
+
+    template <typename T>
+    void write_component(Entity entity, const T &component)
+    {
+        *get<T>(entity) = component;
+    }
+
+    [[nodiscard]] static std::span<const Entity>
+    chunk_entities(const Archetype_chunk &chunk) noexcept
+    {
+        return {reinterpret_cast<const Entity *>(chunk.storage->bytes),
+                chunk.size};
+    }
+
+    template <typename T>
+    [[nodiscard]] static std::span<T>
+    chunk_components(const Archetype &archetype,
+                     const Archetype_chunk &chunk) noexcept
+    {
+        const auto id = component_id<std::remove_const_t<T>>();
+        return {reinterpret_cast<T *>(chunk.storage->bytes +
+                                      archetype.offsets[id]),
+                chunk.size};
+    }
+
+    std::vector<Archetype> m_archetypes {};
+    std::unordered_map<Component_mask, std::uint32_t> m_archetype_indices {};
+    std::vector<Entity_record> m_records {};
+    std::vector<std::uint32_t> m_free_indices {};
+    std::size_t m_size {};
+};
+
+// Structural changes recorded while iterating, e.g. from several jobs at once,
+// and applied to the world afterwards
+class Command_buffer
+{
+public:
+    template <typename... Ts>
+    void create(const Ts &...components)
+    {
+        record([=](World &world) { world.create(components...); });
+    }
+
+    void destroy(Entity entity);
+
+    template <typename T>
+    void add(Entity entity, const T &component)
+    {
+        record(
+            [=](World &world)
+            {
+                if (world.is_alive(entity))
+                {
+                    world.add(entity, component);
+                }
+            });
+    }
+
+    template <typename T>
+    void remove(Entity entity)
+    {
+        record(
+            [=](World &world)
+            {
+                if (world.is_alive(entity))
+                {
+                    world.remove<T>(entity);
+                }
+            });
+    }
+
+    // In the order of recording, then clears the buffer. Commands for entities
+    // destroyed in the meantime are skipped.
+    void apply(World &world);
+
+    [[nodiscard]] bool empty() const;
+
+private:
+    void record(std::function<void(World &)> command);
+
+    mutable std::mutex m_mutex {};
+    std::vector<std::function<void(World &)>> m_commands {};
+};
+
+#endif // ECS_HPP
@@ -0,0 +1,110 @@
+#include "file_watcher.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+
+File_watcher::File_watcher(
+    const std::vector<std::filesystem::path> &directories)
+    : m_fd {inotify_init1(IN_NONBLOCK | IN_CLOEXEC)}
+{
+    if (m_fd < 0)
+    {
+        std::cerr << "Failed to initialize inotify, hot reload is disabled\n";
+        return;
+    }
+
+    for (const auto &directory : directories)
+    {
+        const auto wd = inotify_add_watch(
+            m_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (wd < 0)
+        {
+            std::cerr << "Failed to watch directory " << directory << '\n';
+            continue;
+        }
+        m_watches.emplace_back(wd, directory);
+    }
+}
+
+File_watcher::~File_watcher()
+{
+    if (m_fd >= 0)
+    {
+        close(m_fd);
+    }
+}
+
+std::vector<std::filesystem::path> File_watcher::poll()
+{
+    std::vector<std::filesystem::path> changed_files;
+    if (m_fd < 0)
+    {
+        return changed_files;
+    }
+
+    alignas(inotify_event) char buffer[4096];
+    for (;;)
+    {
+        const auto length = read(m_fd, buffer, sizeof(buffer));
+        if (length <= 0)
+        {
+            // EAGAIN: no more pending events
+            break;
+        }
+
+        for (const char *ptr {buffer}; ptr < buffer + length;)
+        {
+            const auto *const event =
+                reinterpret_cast<const inotify_event *>(ptr);
+            ptr += sizeof(inotify_event) + event->len;
+
+            if (event->len == 0)
+            {
+                continue;
+            }
+
+            const auto watch = std::find_if(m_watches.begin(),
+                                            m_watches.end(),
+                                            [&](const auto &w)
+                                            { return w.first == event->wd; });
+            if (watch == m_watches.end())
+            {
+                continue;
+            }
+
+            auto path = watch->second / event->name;
+            if (std::find(changed_files.begin(), changed_files.end(), path) ==
+                changed_files.end())
+            {
+                changed_files.push_back(std::move(path));
+            }
+        }
+    }
+
+    return changed_files;
+}
+
+#else
+
+File_watcher::File_watcher(
+    const std::vector<std::filesystem::path> & /*directories*/)
+{
+}
+
+File_watcher::~File_watcher()
+{
+}
+
+std::vector<std::filesystem::path> File_watcher::poll()
+{
+    return {};
+}
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef FILE_WATCHER_HPP
+#define FILE_WATCHER_HPP
+
+#include <filesystem>
+#include <utility>
+#include <vector>
+
+// Watches directories for files that are written or moved into them. Only
+// implemented with inotify on Linux, elsewhere no change is ever reported.
+class File_watcher
+{
+public:
+    [[nodiscard]] explicit File_watcher(
+        const std::vector<std::filesystem::path> &directories);
+    ~File_watcher();
+
+    File_watcher(const File_watcher &) = delete;
+    File_watcher &operator=(const File_watcher &) = delete;
+
+    // Does not block. Returns the files modified since the last call, each
+    // file at most once.
+    [[nodiscard]] std::vector<std::filesystem::path> poll();
+
+private:
+    int m_fd {-1};
+    std::vector<std::pair<int, std::filesystem::path>> m_watches {};
+};
+
+#endif // FILE_WATCHER_HPP
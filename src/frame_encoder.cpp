@@ -0,0 +1,210 @@
+#include "frame_encoder.hpp"
+
+#include "stb_image_write.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+
+// PNG encoding is much slower than capturing, Y4M frames must stay in order
+[[nodiscard]] std::uint32_t worker_count(Capture_format format)
+{
+    if (format == Capture_format::y4m)
+    {
+        return 1;
+    }
+    return std::clamp(std::thread::hardware_concurrency() / 2, 1u, 4u);
+}
+
+[[nodiscard]] std::uint8_t clamp_byte(int value)
+{
+    return static_cast<std::uint8_t>(std::clamp(value, 0, 255));
+}
+
+} // namespace
+
+Capture_format capture_format(const std::filesystem::path &path)
+{
+    return path.extension() == ".y4m" ? Capture_format::y4m
+                                      : Capture_format::png_sequence;
+}
+
+Frame_encoder::Frame_encoder(const std::filesystem::path &path,
+                             std::uint32_t width,
+                             std::uint32_t height,
+                             Pixel_order pixel_order,
+                             std::uint32_t frame_rate)
+    : m_path {path}, m_format {capture_format(path)}, m_width {width},
+      m_height {height}, m_pixel_order {pixel_order}
+{
+    if (m_format == Capture_format::y4m)
+    {
+        m_y4m_file.open(m_path, std::ios::binary);
+        m_y4m_file << "YUV4MPEG2 W" << m_width << " H" << m_height << " F"
+                   << frame_rate << ":1 Ip A1:1 C444 XCOLORRANGE=FULL\n";
+    }
+    else
+    {
+        std::error_code error;
+        std::filesystem::create_directories(m_path, error);
+    }
+
+    if ((m_format == Capture_format::y4m && !m_y4m_file) ||
+        (m_format == Capture_format::png_sequence &&
+         !std::filesystem::is_directory(m_path)))
+    {
+        throw std::runtime_error("Failed to create capture output " +
+                                 m_path.string());
+    }
+
+    const auto count = worker_count(m_format);
+    m_workers.reserve(count);
+    for (std::uint32_t i {}; i < count; ++i)
+    {
+        m_workers.emplace_back(&Frame_encoder::work, this);
+    }
+}
+
+Frame_encoder::~Frame_encoder()
+{
+    {
+        const std::scoped_lock lock {m_mutex};
+        m_stopping = true;
+    }
+    m_condition.notify_all();
+
+    for (auto &worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+void Frame_encoder::encode(const std::uint8_t *pixels,
+                           std::function<void()> release)
+{
+    {
+        const std::scoped_lock lock {m_mutex};
+        m_jobs.push_back({.index = m_queued_frame_count++,
+                          .pixels = pixels,
+                          .release = std::move(release)});
+    }
+    m_condition.notify_one();
+}
+
+std::optional<std::string> Frame_encoder::error() const
+{
+    const std::scoped_lock lock {m_mutex};
+    return m_error;
+}
+
+void Frame_encoder::work()
+{
+    std::vector<std::uint8_t> scratch;
+
+    for (;;)
+    {
+        Job job {};
+        bool failed {};
+        {
+            std::unique_lock lock {m_mutex};
+            m_condition.wait(lock,
+                             [this] { return m_stopping || !m_jobs.empty(); });
+            if (m_jobs.empty())
+            {
+                return;
+            }
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+            failed = m_error.has_value();
+        }
+
+        if (!failed)
+        {
+            try
+            {
+                if (m_format == Capture_format::y4m)
+                {
+                    write_y4m(job, scratch);
+                }
+                else
+                {
+                    write_png(job, scratch);
+                }
+                m_encoded_frame_count.fetch_add(1, std::memory_order_relaxed);
+            }
+            catch (const std::exception &e)
+            {
+                const std::scoped_lock lock {m_mutex};
+                if (!m_error.has_value())
+                {
+                    m_error = e.what();
+                }
+            }
+        }
+
+        job.release();
+    }
+}
+
+void Frame_encoder::write_png(const Job &job,
+                              std::vector<std::uint8_t> &scratch) const
+{
+    // Drops the alpha, which the swapchain does not define
+    const std::size_t pixel_count {std::size_t {m_width} * m_height};
+    scratch.resize(pixel_count * 3);
+    const std::size_t red {m_pixel_order == Pixel_order::rgba ? 0u : 2u};
+    for (std::size_t i {}; i < pixel_count; ++i)
+    {
+        scratch[i * 3 + 0] = job.pixels[i * 4 + red];
+        scratch[i * 3 + 1] = job.pixels[i * 4 + 1];
+        scratch[i * 3 + 2] = job.pixels[i * 4 + 2 - red];
+    }
+
+    std::ostringstream file_name;
+    file_name << "frame_" << std::setw(6) << std::setfill('0') << job.index
+              << ".png";
+    const auto path = (m_path / file_name.str()).string();
+
+    if (!stbi_write_png(path.c_str(),
+                        static_cast<int>(m_width),
+                        static_cast<int>(m_height),
+                        3,
+                        scratch.data(),
+                        static_cast<int>(m_width) * 3))
+    {
+        throw std::runtime_error("Failed to write image \"" + path + "\"");
+    }
+}
+
+void Frame_encoder::write_y4m(const Job &job,
+                              std::vector<std::uint8_t> &scratch)
+{
+    // Planar Y, Cb and Cr, in 8-bit fixed point
+    const std::size_t pixel_count {std::size_t {m_width} * m_height};
+    scratch.resize(pixel_count * 3);
+    const std::size_t red {m_pixel_order == Pixel_order::rgba ? 0u : 2u};
+    for (std::size_t i {}; i < pixel_count; ++i)
+    {
+        const int r {job.pixels[i * 4 + red]};
+        const int g {job.pixels[i * 4 + 1]};
+        const int b {job.pixels[i * 4 + 2 - red]};
+        scratch[i] = clamp_byte((77 * r + 150 * g + 29 * b + 128) >> 8);
+        scratch[pixel_count + i] =
+            clamp_byte(((-43 * r - 85 * g + 128 * b + 128) >> 8) + 128);
+        scratch[pixel_count * 2 + i] =
+            clamp_byte(((128 * r - 107 * g - 21 * b + 128) >> 8) + 128);
+    }
+
+    m_y4m_file << "FRAME\n";
+    m_y4m_file.write(reinterpret_cast<const char *>(scratch.data()),
+                     static_cast<std::streamsize>(scratch.size()));
+    if (!m_y4m_file)
+    {
+        throw std::runtime_error("Failed to write frame to " +
+                                 m_path.string());
+    }
+}
@@ -0,0 +1,109 @@
+#ifndef FRAME_ENCODER_HPP
+#define FRAME_ENCODER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class Capture_format : std::uint8_t
+{
+    // frame_000000.png, frame_000001.png, ... in a directory
+    png_sequence,
+    // Raw 4:4:4 full range BT.601 YCbCr video
+    y4m
+};
+
+// Of the captured pixels, 4 bytes each. Alpha is ignored.
+enum class Pixel_order : std::uint8_t
+{
+    rgba,
+    bgra
+};
+
+// Paths ending in .y4m are written as Y4M, any other as a PNG sequence
+[[nodiscard]] Capture_format capture_format(const std::filesystem::path &path);
+
+// Encodes captured frames on worker threads. PNG frames are encoded in
+// parallel, Y4M frames by a single worker in the order they were queued.
+class Frame_encoder
+{
+public:
+    // Creates the directory or the file. Throws std::runtime_error if it
+    // cannot be created.
+    [[nodiscard]] Frame_encoder(const std::filesystem::path &path,
+                                std::uint32_t width,
+                                std::uint32_t height,
+                                Pixel_order pixel_order,
+                                std::uint32_t frame_rate);
+
+    // Encodes the queued frames and joins the workers
+    ~Frame_encoder();
+
+    Frame_encoder(const Frame_encoder &) = delete;
+    Frame_encoder &operator=(const Frame_encoder &) = delete;
+
+    Frame_encoder(Frame_encoder &&) = delete;
+    Frame_encoder &operator=(Frame_encoder &&) = delete;
+
+    // Does not copy the pixels, they must stay valid until a worker calls
+    // release, once it is done with them
+    void encode(const std::uint8_t *pixels, std::function<void()> release);
+
+    [[nodiscard]] std::uint64_t encoded_frame_count() const noexcept
+    {
+        return m_encoded_frame_count.load(std::memory_order_relaxed);
+    }
+
+    // The first error of the workers. Frames queued after it are released
+    // without being encoded.
+    [[nodiscard]] std::optional<std::string> error() const;
+
+    [[nodiscard]] Capture_format format() const noexcept
+    {
+        return m_format;
+    }
+
+private:
+    struct Job
+    {
+        std::uint64_t index;
+        const std::uint8_t *pixels;
+        std::function<void()> release;
+    };
+
+    void work();
+
+    // Both use scratch as a conversion buffer, reused between frames
+    void write_png(const Job &job, std::vector<std::uint8_t> &scratch) const;
+    void write_y4m(const Job &job, std::vector<std::uint8_t> &scratch);
+
+    std::filesystem::path m_path;
+    Capture_format m_format;
+    std::uint32_t m_width;
+    std::uint32_t m_height;
+    Pixel_order m_pixel_order;
+    // Only written by the single Y4M worker
+    std::ofstream m_y4m_file;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<Job> m_jobs;
+    std::uint64_t m_queued_frame_count {};
+    bool m_stopping {};
+    std::optional<std::string> m_error;
+    std::atomic<std::uint64_t> m_encoded_frame_count {};
+
+    // Last, the workers use the members above
+    std::vector<std::thread> m_workers;
+};
+
+#endif // FRAME_ENCODER_HPP
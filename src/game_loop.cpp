@@ -0,0 +1,209 @@
+#include "game_loop.hpp"
+
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+
+[[nodiscard]] Fixed_timestep::Clock::duration
+step_duration(std::uint32_t update_rate)
+{
+    if (update_rate == 0)
+    {
+        throw std::runtime_error("The update rate must not be 0");
+    }
+    return std::chrono::duration_cast<Fixed_timestep::Clock::duration>(
+        std::chrono::duration<double>(1.0 / update_rate));
+}
+
+// Most sprites move by less than a cell per frame, and a cell holds a few
+// dozen sprites of the initial grid
+[[nodiscard]] float broadphase_cell_size(std::span<const Sprite> sprites)
+{
+    float max_extent {};
+    for (const auto &sprite : sprites)
+    {
+        max_extent = std::max({max_extent, sprite.size.x, sprite.size.y});
+    }
+    return max_extent > 0.0f ? 8.0f * max_extent : 0.1f;
+}
+
+} // namespace
+
+Fixed_timestep::Fixed_timestep(std::uint32_t update_rate)
+    : m_step {step_duration(update_rate)}
+{
+}
+
+std::uint32_t Fixed_timestep::advance(Clock::duration elapsed) noexcept
+{
+    m_accumulator += elapsed;
+    const auto step_count = m_accumulator / m_step;
+    if (step_count > g_max_steps_per_frame)
+    {
+        m_accumulator %= m_step;
+        return g_max_steps_per_frame;
+    }
+    m_accumulator -= step_count * m_step;
+    return static_cast<std::uint32_t>(step_count);
+}
+
+float Fixed_timestep::alpha() const noexcept
+{
+    return std::chrono::duration<float>(m_accumulator) /
+           std::chrono::duration<float>(m_step);
+}
+
+void interpolate_sprites(std::span<const Sprite> previous,
+                         std::span<const Sprite> current,
+                         float alpha,
+                         std::vector<Sprite> &result,
+                         Job_system &job_system)
+{
+    if (previous.size() != current.size())
+    {
+        result.assign(current.begin(), current.end());
+        return;
+    }
+
+    result.resize(current.size());
+    job_system.parallel_for(
+        current.size(),
+        g_sprites_per_job,
+        [&](std::size_t first, std::size_t last)
+        {
+            for (auto i = first; i < last; ++i)
+            {
+                result[i] = {
+                    .position = previous[i].position +
+                                (current[i].position - previous[i].position) *
+                                    alpha,
+                    .size = current[i].size};
+            }
+        });
+}
+
+Game_loop::Game_loop(std::uint32_t sprite_count,
+                     std::uint32_t update_rate,
+                     bool threaded,
+                     Job_system &job_system)
+    : m_job_system {&job_system}, m_simulation {sprite_count},
+      m_timestep {update_rate},
+      m_threaded {threaded},
+      m_broadphase {broadphase_cell_size(m_simulation.sprites())},
+      m_previous_sprites {m_simulation.sprites()},
+      m_last_advance_time {Clock::now()}
+{
+    if (m_threaded)
+    {
+        m_thread = std::thread(&Game_loop::run_simulation, this);
+    }
+}
+
+Game_loop::~Game_loop()
+{
+    if (m_thread.joinable())
+    {
+        m_stopping.store(true, std::memory_order_relaxed);
+        m_thread.join();
+    }
+}
+
+std::span<const Sprite> Game_loop::advance()
+{
+    const auto now = Clock::now();
+
+    if (m_threaded)
+    {
+        // Empty until the first step
+        const auto &snapshot = m_snapshots.latest();
+        const auto alpha = std::clamp(
+            std::chrono::duration<float>(now - snapshot.time) /
+                std::chrono::duration<float>(m_timestep.step()),
+            0.0f,
+            1.0f);
+        interpolate_sprites(snapshot.previous,
+                            snapshot.current,
+                            alpha,
+                            m_interpolated_sprites,
+                            *m_job_system);
+        update_broadphase();
+        return m_interpolated_sprites;
+    }
+
+    const auto step_count = m_timestep.advance(now - m_last_advance_time);
+    m_last_advance_time = now;
+    for (std::uint32_t i {}; i < step_count; ++i)
+    {
+        const Profile_zone zone {"Simulation step"};
+        m_previous_sprites = m_simulation.sprites();
+        m_simulation.update(m_timestep.step_seconds(), *m_job_system);
+    }
+
+    interpolate_sprites(m_previous_sprites,
+                        m_simulation.sprites(),
+                        m_timestep.alpha(),
+                        m_interpolated_sprites,
+                        *m_job_system);
+    update_broadphase();
+    return m_interpolated_sprites;
+}
+
+std::optional<std::uint32_t> Game_loop::pick(glm::vec2 position)
+{
+    m_picked_sprites.clear();
+    m_broadphase.query(position, m_picked_sprites);
+    if (m_picked_sprites.empty())
+    {
+        return std::nullopt;
+    }
+    // Drawn in order, the last one is on top
+    return *std::max_element(m_picked_sprites.begin(), m_picked_sprites.end());
+}
+
+void Game_loop::update_broadphase()
+{
+    const Profile_zone zone {"Broadphase"};
+    m_sprite_bounds.resize(m_interpolated_sprites.size());
+    m_job_system->parallel_for(
+        m_interpolated_sprites.size(),
+        g_sprites_per_job,
+        [this](std::size_t first, std::size_t last)
+        {
+            for (auto i = first; i < last; ++i)
+            {
+                const auto &sprite = m_interpolated_sprites[i];
+                m_sprite_bounds[i] = {.min = sprite.position,
+                                      .max = sprite.position + sprite.size};
+            }
+        });
+    m_broadphase.set_all(m_sprite_bounds, *m_job_system);
+}
+
+void Game_loop::run_simulation()
+{
+    auto next_step_time = Clock::now();
+    while (!m_stopping.load(std::memory_order_relaxed))
+    {
+        std::this_thread::sleep_until(next_step_time);
+
+        auto &snapshot = m_snapshots.back();
+        {
+            const Profile_zone zone {"Simulation step"};
+            // Copies into the buffers of an older snapshot, which keep their
+            // capacity
+            snapshot.previous = m_simulation.sprites();
+            m_simulation.update(m_timestep.step_seconds(), *m_job_system);
+            snapshot.current = m_simulation.sprites();
+        }
+        snapshot.time = Clock::now();
+        m_snapshots.publish();
+
+        // Catching up after a stall would only burn the CPU
+        next_step_time = std::max(next_step_time + m_timestep.step(),
+                                  Clock::now() - m_timestep.step());
+    }
+}
@@ -0,0 +1,176 @@
+#ifndef GAME_LOOP_HPP
+#define GAME_LOOP_HPP
+
+#include "job_system.hpp"
+#include "simulation.hpp"
+#include "spatial_hash.hpp"
+#include "sprite.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <thread>
+#include <vector>
+
+// Turns the real time between frames into a whole number of fixed steps
+class Fixed_timestep
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // More steps per frame are dropped, so that the simulation slows down
+    // instead of falling further and further behind
+    static constexpr std::uint32_t g_max_steps_per_frame {8};
+
+    // In steps per second
+    [[nodiscard]] explicit Fixed_timestep(std::uint32_t update_rate);
+
+    // Returns the number of steps to simulate for the elapsed time
+    [[nodiscard]] std::uint32_t advance(Clock::duration elapsed) noexcept;
+
+    // How far the real time is into the next step, from 0 to 1, to
+    // interpolate between the last two simulated states
+    [[nodiscard]] float alpha() const noexcept;
+
+    [[nodiscard]] Clock::duration step() const noexcept
+    {
+        return m_step;
+    }
+
+    [[nodiscard]] float step_seconds() const noexcept
+    {
+        return std::chrono::duration<float>(m_step).count();
+    }
+
+private:
+    Clock::duration m_step;
+    Clock::duration m_accumulator {};
+};
+
+// Triple buffer handing whole snapshots from one producer thread to one
+// consumer thread. Neither ever waits for the other: the producer always has
+// a buffer to write, and the consumer reads the latest published one.
+template <typename T>
+class Snapshot_exchange
+{
+public:
+    // The buffer to write the next snapshot to. Producer only.
+    [[nodiscard]] T &back() noexcept
+    {
+        return m_buffers[m_back];
+    }
+
+    // Makes the back buffer the latest snapshot. Producer only.
+    void publish() noexcept
+    {
+        m_back =
+            m_middle.exchange(m_back | g_fresh, std::memory_order_acq_rel) &
+            ~g_fresh;
+    }
+
+    // The latest published snapshot, valid until the next call. Consumer
+    // only.
+    [[nodiscard]] const T &latest() noexcept
+    {
+        if ((m_middle.load(std::memory_order_relaxed) & g_fresh) != 0)
+        {
+            m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) &
+                      ~g_fresh;
+        }
+        return m_buffers[m_front];
+    }
+
+private:
+    // Set in m_middle when it holds a snapshot the consumer has not seen
+    static constexpr std::uint32_t g_fresh {4};
+
+    std::array<T, 3> m_buffers {};
+    std::uint32_t m_back {0};
+    std::atomic<std::uint32_t> m_middle {1};
+    std::uint32_t m_front {2};
+};
+
+// Linear interpolation of each sprite. If sprites were added or removed in
+// between, their order changed too, and the current sprites are used as is.
+void interpolate_sprites(std::span<const Sprite> previous,
+                         std::span<const Sprite> current,
+                         float alpha,
+                         std::vector<Sprite> &result,
+                         Job_system &job_system);
+
+// Runs the simulation at a fixed rate, independently of the frame rate, and
+// interpolates its state for each rendered frame. The simulation runs either
+// on the thread calling advance, or on its own thread, which then keeps its
+// rate even when presenting blocks. Both use the job system, which must
+// outlive the game loop.
+class Game_loop
+{
+public:
+    [[nodiscard]] Game_loop(std::uint32_t sprite_count,
+                            std::uint32_t update_rate,
+                            bool threaded,
+                            Job_system &job_system);
+
+    ~Game_loop();
+
+    Game_loop(const Game_loop &) = delete;
+    Game_loop &operator=(const Game_loop &) = delete;
+
+    Game_loop(Game_loop &&) = delete;
+    Game_loop &operator=(Game_loop &&) = delete;
+
+    // Simulates the steps due since the last call unless threaded, and
+    // returns the sprites interpolated to now, valid until the next call.
+    // Rendering lags a step behind the simulation.
+    [[nodiscard]] std::span<const Sprite> advance();
+
+    // The sprites returned by advance, by index
+    [[nodiscard]] const Spatial_hash &broadphase() const noexcept
+    {
+        return m_broadphase;
+    }
+
+    // The topmost sprite returned by advance at the position, in normalized
+    // device coordinates
+    [[nodiscard]] std::optional<std::uint32_t> pick(glm::vec2 position);
+
+private:
+    using Clock = Fixed_timestep::Clock;
+
+    struct Snapshot
+    {
+        // When current was simulated
+        Clock::time_point time;
+        std::vector<Sprite> previous;
+        std::vector<Sprite> current;
+    };
+
+    void run_simulation();
+
+    // Moves the interpolated sprites in the broadphase
+    void update_broadphase();
+
+    Job_system *m_job_system;
+    Simulation m_simulation;
+    Fixed_timestep m_timestep;
+    bool m_threaded;
+    std::vector<Sprite> m_interpolated_sprites {};
+    Spatial_hash m_broadphase;
+    std::vector<Aabb> m_sprite_bounds {};
+    std::vector<std::uint32_t> m_picked_sprites {};
+
+    // Without a thread
+    std::vector<Sprite> m_previous_sprites {};
+    Clock::time_point m_last_advance_time {};
+
+    // With a thread
+    Snapshot_exchange<Snapshot> m_snapshots {};
+    std::atomic<bool> m_stopping {};
+    // Last, it uses the members above
+    std::thread m_thread {};
+};
+
+#endif // GAME_LOOP_HPP
@@ -0,0 +1,109 @@
+#include "hash.hpp"
+
+#include <bit>
+#include <cstring>
+
+namespace
+{
+
+constexpr std::uint64_t g_prime_1 {0x9E3779B185EBCA87};
+constexpr std::uint64_t g_prime_2 {0xC2B2AE3D27D4EB4F};
+constexpr std::uint64_t g_prime_3 {0x165667B19E3779F9};
+constexpr std::uint64_t g_prime_4 {0x85EBCA77C2B2AE63};
+constexpr std::uint64_t g_prime_5 {0x27D4EB2F165667C5};
+
+[[nodiscard]] std::uint64_t read_64(const std::uint8_t *ptr) noexcept
+{
+    std::uint64_t value;
+    std::memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+[[nodiscard]] std::uint32_t read_32(const std::uint8_t *ptr) noexcept
+{
+    std::uint32_t value;
+    std::memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+[[nodiscard]] constexpr std::uint64_t round(std::uint64_t accumulator,
+                                            std::uint64_t lane) noexcept
+{
+    accumulator += lane * g_prime_2;
+    accumulator = std::rotl(accumulator, 31);
+    return accumulator * g_prime_1;
+}
+
+[[nodiscard]] constexpr std::uint64_t merge_accumulator(
+    std::uint64_t accumulator, std::uint64_t accumulator_n) noexcept
+{
+    accumulator ^= round(0, accumulator_n);
+    return accumulator * g_prime_1 + g_prime_4;
+}
+
+} // namespace
+
+std::uint64_t xxhash64(std::span<const std::uint8_t> data,
+                       std::uint64_t seed) noexcept
+{
+    const auto *ptr = data.data();
+    const auto *const end = ptr + data.size();
+
+    std::uint64_t hash;
+
+    if (data.size() >= 32)
+    {
+        std::uint64_t accumulators[4] {seed + g_prime_1 + g_prime_2,
+                                       seed + g_prime_2,
+                                       seed,
+                                       seed - g_prime_1};
+
+        for (; ptr + 32 <= end; ptr += 32)
+        {
+            accumulators[0] = round(accumulators[0], read_64(ptr));
+            accumulators[1] = round(accumulators[1], read_64(ptr + 8));
+            accumulators[2] = round(accumulators[2], read_64(ptr + 16));
+            accumulators[3] = round(accumulators[3], read_64(ptr + 24));
+        }
+
+        hash = std::rotl(accumulators[0], 1) + std::rotl(accumulators[1], 7) +
+               std::rotl(accumulators[2], 12) + std::rotl(accumulators[3], 18);
+        for (const auto accumulator : accumulators)
+        {
+            hash = merge_accumulator(hash, accumulator);
+        }
+    }
+    else
+    {
+        hash = seed + g_prime_5;
+    }
+
+    hash += data.size();
+
+    for (; ptr + 8 <= end; ptr += 8)
+    {
+        hash ^= round(0, read_64(ptr));
+        hash = std::rotl(hash, 27) * g_prime_1 + g_prime_4;
+    }
+
+    if (ptr + 4 <= end)
+    {
+        hash ^= read_32(ptr) * g_prime_1;
+        hash = std::rotl(hash, 23) * g_prime_2 + g_prime_3;
+        ptr += 4;
+    }
+
+    for (; ptr < end; ++ptr)
+    {
+        hash ^= *ptr * g_prime_5;
+        hash = std::rotl(hash, 11) * g_prime_1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= g_prime_2;
+    hash ^= hash >> 29;
+    hash *= g_prime_3;
+    hash ^= hash >> 32;
+
+    return hash;
+}
@@ -0,0 +1,12 @@
+#ifndef HASH_HPP
+#define HASH_HPP
+
+#include <cstdint>
+#include <span>
+
+// XXH64, see https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+// Assumes a little-endian host.
+[[nodiscard]] std::uint64_t xxhash64(std::span<const std::uint8_t> data,
+                                     std::uint64_t seed = 0) noexcept;
+
+#endif // HASH_HPP
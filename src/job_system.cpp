@@ -0,0 +1,425 @@
+#include "job_system.hpp"
+
+#include <array>
+#include <thread>
+#include <utility>
+
+struct Job
+{
+    Job_system::Job_function function;
+    Job_counter *counter;
+};
+
+namespace
+{
+
+// Chase-Lev deque with a fixed capacity, in the formulation for the C11 memory
+// model by Lê et al. The owning thread pushes and pops at the bottom, any
+// thread steals from the top.
+class Job_deque
+{
+public:
+    // Fails if the deque is full. Owner only.
+    [[nodiscard]] bool push(Job *job) noexcept
+    {
+        const auto bottom = m_bottom.load(std::memory_order_relaxed);
+        const auto top = m_top.load(std::memory_order_acquire);
+        if (bottom - top >= g_capacity)
+        {
+            return false;
+        }
+        m_jobs[static_cast<std::size_t>(bottom & g_mask)].store(
+            job, std::memory_order_relaxed);
+        m_bottom.store(bottom + 1, std::memory_order_release);
+        return true;
+    }
+
+    // The most recently pushed job, or nullptr. Owner only.
+    [[nodiscard]] Job *pop() noexcept
+    {
+        const auto bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+        m_bottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto top = m_top.load(std::memory_order_relaxed);
+
+        if (top > bottom)
+        {
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        auto *job = m_jobs[static_cast<std::size_t>(bottom & g_mask)].load(
+            std::memory_order_relaxed);
+        if (top == bottom)
+        {
+            // The last job, a thief may be taking it at the same time
+            if (!m_top.compare_exchange_strong(top,
+                                               top + 1,
+                                               std::memory_order_seq_cst,
+                                               std::memory_order_relaxed))
+            {
+                job = nullptr;
+            }
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        }
+        return job;
+    }
+
+    // The least recently pushed job, or nullptr if the deque is empty or
+    // another thread took it first
+    [[nodiscard]] Job *steal() noexcept
+    {
+        auto top = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const auto bottom = m_bottom.load(std::memory_order_acquire);
+
+        if (top >= bottom)
+        {
+            return nullptr;
+        }
+
+        auto *const job = m_jobs[static_cast<std::size_t>(top & g_mask)].load(
+            std::memory_order_relaxed);
+        if (!m_top.compare_exchange_strong(top,
+                                           top + 1,
+                                           std::memory_order_seq_cst,
+                                           std::memory_order_relaxed))
+        {
+            return nullptr;
+        }
+        return job;
+    }
+
+private:
+    static constexpr std::int64_t g_capacity {4096};
+    static constexpr std::int64_t g_mask {g_capacity - 1};
+
+    // On separate cache lines, the owner writes the bottom and thieves the top
+    alignas(64) std::atomic<std::int64_t> m_top {};
+    alignas(64) std::atomic<std::int64_t> m_bottom {};
+    std::array<std::atomic<Job *>, g_capacity> m_jobs {};
+};
+
+// The job system and worker index of the calling thread
+thread_local const Job_system *t_job_system {};
+thread_local std::size_t t_worker {};
+
+} // namespace
+
+struct Job_worker
+{
+    Job_deque deque {};
+    // Empty for the creating thread
+    std::thread thread {};
+};
+
+std::uint32_t Job_system::default_worker_count() noexcept
+{
+    const auto hardware_threads = std::thread::hardware_concurrency();
+    return hardware_threads > 1 ? hardware_threads - 1 : 0;
+}
+
+Job_system::Job_system(std::uint32_t worker_count,
+                       std::uint32_t long_worker_count)
+{
+    m_workers.reserve(worker_count + 1);
+    for (std::uint32_t i {}; i <= worker_count; ++i)
+    {
+        m_workers.push_back(std::make_unique<Job_worker>());
+    }
+
+    t_job_system = this;
+    t_worker = 0;
+
+    for (std::size_t i {1}; i < m_workers.size(); ++i)
+    {
+        m_workers[i]->thread = std::thread(&Job_system::run_worker, this, i);
+    }
+
+    m_long_workers.reserve(long_worker_count);
+    for (std::uint32_t i {}; i < long_worker_count; ++i)
+    {
+        m_long_workers.emplace_back(&Job_system::run_long_worker, this);
+    }
+}
+
+Job_system::~Job_system()
+{
+    {
+        const std::scoped_lock lock {m_long_mutex};
+        m_long_stopping = true;
+    }
+    m_long_condition.notify_all();
+    for (auto &thread : m_long_workers)
+    {
+        thread.join();
+    }
+
+    {
+        const std::scoped_lock lock {m_sleep_mutex};
+        m_stopping = true;
+    }
+    m_wake_condition.notify_all();
+
+    for (auto &worker : m_workers)
+    {
+        if (worker->thread.joinable())
+        {
+            worker->thread.join();
+        }
+    }
+
+    if (t_job_system == this)
+    {
+        t_job_system = nullptr;
+    }
+}
+
+std::uint32_t Job_system::thread_count() const noexcept
+{
+    return static_cast<std::uint32_t>(m_workers.size());
+}
+
+void Job_system::submit(Job_function function, Job_counter &counter)
+{
+    {
+        const std::scoped_lock lock {counter.m_mutex};
+        counter.m_count.fetch_add(1, std::memory_order_relaxed);
+    }
+    push(new Job {.function = std::move(function), .counter = &counter});
+}
+
+void Job_system::submit_after(Job_counter &dependency,
+                              Job_function function,
+                              Job_counter &counter)
+{
+    {
+        const std::scoped_lock lock {counter.m_mutex};
+        counter.m_count.fetch_add(1, std::memory_order_relaxed);
+    }
+    auto *const job =
+        new Job {.function = std::move(function), .counter = &counter};
+
+    {
+        const std::scoped_lock lock {dependency.m_mutex};
+        if (dependency.m_count.load(std::memory_order_relaxed) != 0)
+        {
+            dependency.m_continuations.push_back(job);
+            return;
+        }
+    }
+    push(job);
+}
+
+void Job_system::submit_long(Job_function function, Job_counter &counter)
+{
+    {
+        const std::scoped_lock lock {counter.m_mutex};
+        counter.m_count.fetch_add(1, std::memory_order_relaxed);
+    }
+    auto *const job =
+        new Job {.function = std::move(function), .counter = &counter};
+
+    if (m_long_workers.empty())
+    {
+        push(job);
+        return;
+    }
+
+    {
+        const std::scoped_lock lock {m_long_mutex};
+        m_long_jobs.push_back(job);
+    }
+    m_long_condition.notify_one();
+}
+
+void Job_system::wait(Job_counter &counter)
+{
+    const auto worker = current_worker();
+    while (!counter.is_done())
+    {
+        if (auto *const job = find_job(worker))
+        {
+            run(job);
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    // Also waits for the thread finishing the last job to unlock the mutex,
+    // after which the counter can be destroyed
+    std::exception_ptr exception;
+    {
+        const std::scoped_lock lock {counter.m_mutex};
+        exception = std::exchange(counter.m_exception, nullptr);
+    }
+    if (exception)
+    {
+        std::rethrow_exception(exception);
+    }
+}
+
+std::size_t Job_system::current_worker() const noexcept
+{
+    return t_job_system == this ? t_worker : m_workers.size();
+}
+
+void Job_system::push(Job *job)
+{
+    // Counted first, so that it never drops below zero when the job is taken
+    m_queued_count.fetch_add(1, std::memory_order_seq_cst);
+
+    const auto worker = current_worker();
+    if (worker < m_workers.size())
+    {
+        if (!m_workers[worker]->deque.push(job))
+        {
+            // Full, running it now also keeps the number of jobs bounded
+            m_queued_count.fetch_sub(1, std::memory_order_relaxed);
+            run(job);
+            return;
+        }
+    }
+    else
+    {
+        const std::scoped_lock lock {m_injected_mutex};
+        m_injected_jobs.push_back(job);
+    }
+
+    if (m_sleeping_count.load(std::memory_order_seq_cst) > 0)
+    {
+        // Locking orders the notification after the check of a worker about
+        // to sleep
+        {
+            const std::scoped_lock lock {m_sleep_mutex};
+        }
+        m_wake_condition.notify_one();
+    }
+}
+
+Job *Job_system::find_job(std::size_t worker)
+{
+    if (m_queued_count.load(std::memory_order_relaxed) == 0)
+    {
+        return nullptr;
+    }
+
+    Job *job {};
+    if (worker < m_workers.size())
+    {
+        job = m_workers[worker]->deque.pop();
+    }
+
+    if (job == nullptr)
+    {
+        const std::scoped_lock lock {m_injected_mutex};
+        if (!m_injected_jobs.empty())
+        {
+            job = m_injected_jobs.back();
+            m_injected_jobs.pop_back();
+        }
+    }
+
+    // Starting after the own deque spreads the thieves over the victims
+    for (std::size_t i {1}; job == nullptr && i <= m_workers.size(); ++i)
+    {
+        job = m_workers[(worker + i) % m_workers.size()]->deque.steal();
+    }
+
+    if (job != nullptr)
+    {
+        m_queued_count.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+void Job_system::run(Job *job)
+{
+    std::exception_ptr exception;
+    try
+    {
+        job->function();
+    }
+    catch (...)
+    {
+        exception = std::current_exception();
+    }
+
+    auto &counter = *job->counter;
+    delete job;
+
+    std::vector<Job *> continuations;
+    {
+        const std::scoped_lock lock {counter.m_mutex};
+        if (exception && !counter.m_exception)
+        {
+            counter.m_exception = exception;
+        }
+        if (counter.m_count.fetch_sub(1, std::memory_order_release) == 1)
+        {
+            continuations = std::move(counter.m_continuations);
+            counter.m_continuations.clear();
+        }
+    }
+
+    for (auto *const continuation : continuations)
+    {
+        push(continuation);
+    }
+}
+
+void Job_system::run_worker(std::size_t worker)
+{
+    t_job_system = this;
+    t_worker = worker;
+
+    while (true)
+    {
+        if (auto *const job = find_job(worker))
+        {
+            run(job);
+            continue;
+        }
+
+        std::unique_lock lock {m_sleep_mutex};
+        m_sleeping_count.fetch_add(1, std::memory_order_seq_cst);
+        m_wake_condition.wait(
+            lock,
+            [this]
+            {
+                return m_stopping ||
+                       m_queued_count.load(std::memory_order_seq_cst) > 0;
+            });
+        m_sleeping_count.fetch_sub(1, std::memory_order_relaxed);
+        if (m_stopping)
+        {
+            return;
+        }
+    }
+}
+
+void Job_system::run_long_worker()
+{
+    while (true)
+    {
+        Job *job {};
+        {
+            std::unique_lock lock {m_long_mutex};
+            m_long_condition.wait(
+                lock,
+                [this] { return m_long_stopping || !m_long_jobs.empty(); });
+            if (m_long_jobs.empty())
+            {
+                return;
+            }
+            job = m_long_jobs.front();
+            m_long_jobs.pop_front();
+        }
+
+        // Its continuations go through the shared queue, this thread is not
+        // one of the workers
+        run(job);
+    }
+}
@@ -0,0 +1,206 @@
+#ifndef JOB_SYSTEM_HPP
+#define JOB_SYSTEM_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+struct Job;
+struct Job_worker;
+
+// Counts the unfinished jobs submitted with it. Jobs can wait for a counter to
+// reach zero before they start. Must not be destroyed before it was waited
+// for.
+class Job_counter
+{
+public:
+    [[nodiscard]] Job_counter() = default;
+
+    Job_counter(const Job_counter &) = delete;
+    Job_counter &operator=(const Job_counter &) = delete;
+
+    Job_counter(Job_counter &&) = delete;
+    Job_counter &operator=(Job_counter &&) = delete;
+
+    [[nodiscard]] bool is_done() const noexcept
+    {
+        return m_count.load(std::memory_order_acquire) == 0;
+    }
+
+private:
+    friend class Job_system;
+
+    // Only changed with the mutex locked, read without it
+    std::atomic<std::uint32_t> m_count {};
+    std::mutex m_mutex {};
+    // Jobs submitted after this counter, started once it reaches zero
+    std::vector<Job *> m_continuations {};
+    // The first exception thrown by one of the jobs
+    std::exception_ptr m_exception {};
+};
+
+// The result of a function run by Job_system::submit_long, set once the
+// counter is done. Like the counter, it must not be destroyed before it was
+// waited for.
+template <typename T>
+struct Long_job
+{
+    Job_counter counter {};
+    std::optional<T> result {};
+};
+
+// Work-stealing job system. Each thread pushes and pops jobs at the back of its
+// own lock-free Chase-Lev deque, idle threads steal from the front of the
+// others. The thread creating the job system is one of its threads: it runs
+// jobs while waiting, so waiting from it or from a job never deadlocks. Other
+// threads can submit and wait too, their jobs go through a shared queue.
+//
+// Long jobs, like decoding files or building pipelines, run in order on
+// separate threads, so that they never delay the short jobs that frames wait
+// for.
+class Job_system
+{
+public:
+    using Job_function = std::function<void()>;
+
+    // One thread per hardware thread, including the creating thread
+    [[nodiscard]] static std::uint32_t default_worker_count() noexcept;
+
+    static constexpr std::uint32_t g_default_long_worker_count {2};
+
+    // Starts worker_count threads in addition to the creating thread, and
+    // long_worker_count threads for the long jobs
+    [[nodiscard]] explicit Job_system(
+        std::uint32_t worker_count = default_worker_count(),
+        std::uint32_t long_worker_count = g_default_long_worker_count);
+
+    // Must not be destroyed while jobs are pending
+    ~Job_system();
+
+    Job_system(const Job_system &) = delete;
+    Job_system &operator=(const Job_system &) = delete;
+
+    Job_system(Job_system &&) = delete;
+    Job_system &operator=(Job_system &&) = delete;
+
+    // Including the creating thread
+    [[nodiscard]] std::uint32_t thread_count() const noexcept;
+
+    // Runs the function on any thread, counted by the counter
+    void submit(Job_function function, Job_counter &counter);
+
+    // Same, but the function only starts once the dependency has reached zero
+    void submit_after(Job_counter &dependency,
+                      Job_function function,
+                      Job_counter &counter);
+
+    // Runs the function on a long job thread, or with the short jobs if there
+    // are none. Jobs submitted after its counter are short jobs.
+    void submit_long(Job_function function, Job_counter &counter);
+
+    // Same, keeping the result of the function. Poll the counter of the
+    // returned job, then take its result.
+    template <typename F>
+    [[nodiscard]] std::unique_ptr<Long_job<std::invoke_result_t<F &>>>
+    submit_long(F function)
+    {
+        auto job = std::make_unique<Long_job<std::invoke_result_t<F &>>>();
+        submit_long([function = std::move(function),
+                     &result = job->result]() mutable
+                    { result.emplace(function()); },
+                    job->counter);
+        return job;
+    }
+
+    // Waits for the job, then returns its result or rethrows the exception
+    // thrown by its function
+    template <typename T>
+    [[nodiscard]] T take_result(Long_job<T> &job)
+    {
+        wait(job.counter);
+        return std::move(*job.result);
+    }
+
+    // Runs jobs until the counter reaches zero, then rethrows the first
+    // exception thrown by its jobs, if any
+    void wait(Job_counter &counter);
+
+    // Calls function(first, last) for chunks of [0, count) on all threads and
+    // waits for them. Chunks have at least min_chunk_size elements, except
+    // when count is smaller.
+    template <typename F>
+    void
+    parallel_for(std::size_t count, std::size_t min_chunk_size, F &&function)
+    {
+        // A few chunks per thread, so that stealing can balance uneven chunks
+        const auto chunk_size = std::max(min_chunk_size, std::size_t {1});
+        const auto chunk_count =
+            std::min((count + chunk_size - 1) / chunk_size,
+                     std::size_t {thread_count()} * 4);
+        if (chunk_count <= 1)
+        {
+            if (count > 0)
+            {
+                function(std::size_t {0}, count);
+            }
+            return;
+        }
+
+        Job_counter counter;
+        for (std::size_t i {}; i < chunk_count; ++i)
+        {
+            submit(
+                [&function,
+                 first = count * i / chunk_count,
+                 last = count * (i + 1) / chunk_count]
+                { function(first, last); },
+                counter);
+        }
+        wait(counter);
+    }
+
+private:
+    // The index of the calling thread, or m_workers.size() for threads which
+    // are not part of this job system
+    [[nodiscard]] std::size_t current_worker() const noexcept;
+
+    void push(Job *job);
+    [[nodiscard]] Job *find_job(std::size_t worker);
+    void run(Job *job);
+    void run_worker(std::size_t worker);
+    void run_long_worker();
+
+    // Index 0 is the creating thread
+    std::vector<std::unique_ptr<Job_worker>> m_workers {};
+
+    // Jobs submitted by other threads
+    std::mutex m_injected_mutex {};
+    std::vector<Job *> m_injected_jobs {};
+
+    // Jobs in the deques and the shared queue, workers sleep while it is 0
+    std::atomic<std::uint64_t> m_queued_count {};
+    std::atomic<std::uint32_t> m_sleeping_count {};
+    std::mutex m_sleep_mutex {};
+    std::condition_variable m_wake_condition {};
+    bool m_stopping {};
+
+    // First in, first out
+    std::mutex m_long_mutex {};
+    std::condition_variable m_long_condition {};
+    std::deque<Job *> m_long_jobs {};
+    bool m_long_stopping {};
+    std::vector<std::thread> m_long_workers {};
+};
+
+#endif // JOB_SYSTEM_HPP
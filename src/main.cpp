@@ -1,14 +1,23 @@
 #include "application.hpp"
+#include "config.hpp"
 
 #include <cstdlib>
 #include <iostream>
 
-int main()
+int main(int argc, char *argv[])
 {
     try
     {
-        Application app;
-        app.run();
+        const auto config = load_config(argc, argv);
+        if (config.headless_frames > 0)
+        {
+            run_headless(config);
+        }
+        else
+        {
+            Application app(config);
+            app.run();
+        }
 
         return EXIT_SUCCESS;
     }
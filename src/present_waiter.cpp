@@ -0,0 +1,93 @@
+#include "present_waiter.hpp"
+
+#include <utility>
+
+namespace
+{
+
+// Resolution of the measured latency
+constexpr std::chrono::microseconds g_poll_interval {500};
+
+} // namespace
+
+Present_waiter::Present_waiter(const vk::raii::Device &device)
+    : m_device {*device}, m_dispatcher {device.getDispatcher()},
+      m_thread {&Present_waiter::work, this}
+{
+}
+
+Present_waiter::~Present_waiter()
+{
+    {
+        const std::scoped_lock lock {m_mutex};
+        m_stopping = true;
+    }
+    m_condition.notify_one();
+    m_thread.join();
+}
+
+void Present_waiter::wait_for(vk::SwapchainKHR swapchain,
+                              std::uint64_t present_id,
+                              std::chrono::steady_clock::time_point input_time)
+{
+    {
+        const std::scoped_lock lock {m_mutex};
+        m_presents.push_back({.swapchain = swapchain,
+                              .id = present_id,
+                              .input_time = input_time});
+    }
+    m_condition.notify_one();
+}
+
+void Present_waiter::abandon()
+{
+    // The thread holds the mutex while it polls
+    const std::scoped_lock lock {m_mutex};
+    m_presents.clear();
+}
+
+std::vector<float> Present_waiter::take_latencies()
+{
+    const std::scoped_lock lock {m_mutex};
+    return std::exchange(m_latencies, {});
+}
+
+void Present_waiter::work()
+{
+    std::unique_lock lock {m_mutex};
+    while (!m_stopping)
+    {
+        if (m_presents.empty())
+        {
+            m_condition.wait(lock);
+            continue;
+        }
+
+        const auto present = m_presents.front();
+        const auto result = [&]
+        {
+            const std::scoped_lock swapchain_lock {m_swapchain_mutex};
+            return m_dispatcher->vkWaitForPresentKHR(
+                static_cast<VkDevice>(m_device),
+                static_cast<VkSwapchainKHR>(present.swapchain),
+                present.id,
+                0);
+        }();
+        const auto now = std::chrono::steady_clock::now();
+
+        if (result == VK_TIMEOUT)
+        {
+            m_condition.wait_for(lock, g_poll_interval);
+            continue;
+        }
+
+        // Out of date or lost presents are not measured
+        if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR)
+        {
+            const std::chrono::duration<float, std::milli> latency {
+                now - present.input_time};
+            m_latencies.push_back(latency.count());
+        }
+        m_presents.pop_front();
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef PRESENT_WAITER_HPP
+#define PRESENT_WAITER_HPP
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wcast-function-type"
+#pragma GCC diagnostic ignored "-Wshadow"
+#endif
+#define VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+#define VULKAN_HPP_NO_STRUCT_SETTERS
+#define VULKAN_HPP_NO_UNION_CONSTRUCTORS
+#define VULKAN_HPP_NO_UNION_SETTERS
+#include <vulkan/vulkan_raii.hpp>
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Measures the time from sampling the input of a frame until it is presented,
+// with VK_KHR_present_id and VK_KHR_present_wait. A thread polls the presents
+// in order. Waiting for a present requires exclusive access to the swapchain,
+// so the thread only polls, and the renderer locks the swapchain while it
+// acquires or presents.
+class Present_waiter
+{
+public:
+    // The device must have the presentId and presentWait features enabled
+    [[nodiscard]] explicit Present_waiter(const vk::raii::Device &device);
+
+    ~Present_waiter();
+
+    Present_waiter(const Present_waiter &) = delete;
+    Present_waiter &operator=(const Present_waiter &) = delete;
+
+    Present_waiter(Present_waiter &&) = delete;
+    Present_waiter &operator=(Present_waiter &&) = delete;
+
+    // Against the polling thread
+    [[nodiscard]] std::unique_lock<std::mutex> lock_swapchain()
+    {
+        return std::unique_lock {m_swapchain_mutex};
+    }
+
+    // The present was tagged with the id through vk::PresentIdKHR. Must not be
+    // called with the swapchain locked.
+    void wait_for(vk::SwapchainKHR swapchain,
+                  std::uint64_t present_id,
+                  std::chrono::steady_clock::time_point input_time);
+
+    // Stops polling the presents queued so far, after which their swapchain
+    // can be retired or destroyed
+    void abandon();
+
+    // In milliseconds, since the last call
+    [[nodiscard]] std::vector<float> take_latencies();
+
+private:
+    struct Present
+    {
+        vk::SwapchainKHR swapchain;
+        std::uint64_t id;
+        std::chrono::steady_clock::time_point input_time;
+    };
+
+    void work();
+
+    vk::Device m_device;
+    const vk::raii::DeviceDispatcher *m_dispatcher;
+
+    // Locked after m_mutex
+    std::mutex m_swapchain_mutex;
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<Present> m_presents;
+    std::vector<float> m_latencies;
+    bool m_stopping {};
+
+    // Last, it uses the members above
+    std::thread m_thread;
+};
+
+#endif // PRESENT_WAITER_HPP
@@ -0,0 +1,237 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+namespace
+{
+
+// About 1 MiB per thread
+constexpr std::size_t g_thread_zone_capacity {32768};
+
+// Single writer, the owning thread. Readers copy the records and then drop
+// those the writer may have overwritten in the meantime.
+struct Thread_zones
+{
+    std::array<Profile_zone_record, g_thread_zone_capacity> records;
+    std::atomic<std::uint64_t> write_index;
+};
+
+struct Frame_marks
+{
+    std::array<std::atomic<std::int64_t>, g_profiler_max_frames> begins;
+    // Compared with frame counts
+    std::atomic<std::size_t> write_index;
+};
+
+// Buffers are never freed, so zones of exited threads can still be read. They
+// are reused by new threads, which matters for short-lived std::async threads.
+std::mutex g_threads_mutex;
+std::vector<std::unique_ptr<Thread_zones>> g_threads;
+std::vector<std::uint32_t> g_free_threads;
+
+Frame_marks g_frame_marks {};
+
+// Releases the buffer of the thread on exit
+struct Thread_registration
+{
+    Thread_zones *zones;
+    std::uint32_t index;
+
+    ~Thread_registration()
+    {
+        if (zones != nullptr)
+        {
+            const std::scoped_lock lock {g_threads_mutex};
+            g_free_threads.push_back(index);
+        }
+    }
+};
+
+thread_local Thread_registration t_registration {};
+thread_local std::uint32_t t_depth {};
+
+[[nodiscard]] std::int64_t now() noexcept
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+[[nodiscard]] Thread_registration &thread_registration()
+{
+    if (t_registration.zones == nullptr)
+    {
+        const std::scoped_lock lock {g_threads_mutex};
+        if (g_free_threads.empty())
+        {
+            t_registration.index =
+                static_cast<std::uint32_t>(g_threads.size());
+            g_threads.push_back(std::make_unique<Thread_zones>());
+        }
+        else
+        {
+            t_registration.index = g_free_threads.back();
+            g_free_threads.pop_back();
+        }
+        t_registration.zones = g_threads[t_registration.index].get();
+    }
+    return t_registration;
+}
+
+void read_zones(const Thread_zones &zones,
+                std::int64_t begin,
+                std::int64_t end,
+                std::vector<Profile_zone_record> &result)
+{
+    const auto last = zones.write_index.load(std::memory_order_acquire);
+    const auto first =
+        last > g_thread_zone_capacity ? last - g_thread_zone_capacity : 0;
+
+    const auto result_offset = result.size();
+    for (auto i = first; i < last; ++i)
+    {
+        result.push_back(zones.records[i % g_thread_zone_capacity]);
+    }
+
+    // Records the writer reached during the copy may be torn
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const auto written = zones.write_index.load(std::memory_order_relaxed);
+    const auto overwritten = std::min(
+        written > g_thread_zone_capacity ? written - g_thread_zone_capacity
+                                         : std::uint64_t {},
+        last);
+    const auto dropped = overwritten > first ? overwritten - first : 0;
+
+    const auto copied =
+        result.begin() + static_cast<std::ptrdiff_t>(result_offset);
+    result.erase(copied, copied + static_cast<std::ptrdiff_t>(dropped));
+    result.erase(std::remove_if(copied,
+                                result.end(),
+                                [begin, end](const Profile_zone_record &zone)
+                                {
+                                    return zone.end <= begin ||
+                                           zone.begin >= end;
+                                }),
+                 result.end());
+}
+
+void write_json_string(std::ostream &out, const char *str)
+{
+    out << '"';
+    for (; *str != '\0'; ++str)
+    {
+        if (*str == '"' || *str == '\\')
+        {
+            out << '\\';
+        }
+        out << *str;
+    }
+    out << '"';
+}
+
+} // namespace
+
+Profile_zone::Profile_zone(const char *name) noexcept
+    : m_name {name}, m_begin {now()}
+{
+    ++t_depth;
+}
+
+Profile_zone::~Profile_zone()
+{
+    const auto end = now();
+    --t_depth;
+
+    const auto &[zones, thread_index] = thread_registration();
+    const auto index = zones->write_index.load(std::memory_order_relaxed);
+    zones->records[index % g_thread_zone_capacity] = {
+        .name = m_name,
+        .begin = m_begin,
+        .end = end,
+        .depth = t_depth,
+        .thread_index = thread_index};
+    zones->write_index.store(index + 1, std::memory_order_release);
+}
+
+void profiler_mark_frame() noexcept
+{
+    const auto index =
+        g_frame_marks.write_index.load(std::memory_order_relaxed);
+    g_frame_marks.begins[index % g_profiler_max_frames].store(
+        now(), std::memory_order_relaxed);
+    g_frame_marks.write_index.store(index + 1, std::memory_order_release);
+}
+
+Profile_frames profiler_frames(std::size_t frame_count)
+{
+    const auto mark_count =
+        g_frame_marks.write_index.load(std::memory_order_acquire);
+    frame_count = std::min(
+        {frame_count,
+         mark_count > 0 ? mark_count - 1 : 0,
+         g_profiler_max_frames - 1});
+    if (frame_count == 0)
+    {
+        return {};
+    }
+
+    // The last mark starts the frame in progress
+    Profile_frames frames {
+        .begin = g_frame_marks
+                     .begins[(mark_count - 1 - frame_count) %
+                             g_profiler_max_frames]
+                     .load(std::memory_order_relaxed),
+        .end = g_frame_marks.begins[(mark_count - 1) % g_profiler_max_frames]
+                   .load(std::memory_order_relaxed),
+        .zones = {}};
+
+    const std::scoped_lock lock {g_threads_mutex};
+    for (const auto &zones : g_threads)
+    {
+        read_zones(*zones, frames.begin, frames.end, frames.zones);
+    }
+
+    return frames;
+}
+
+void write_chrome_trace(const std::filesystem::path &path,
+                        std::size_t frame_count)
+{
+    const auto frames = profiler_frames(frame_count);
+
+    std::ofstream file(path);
+    if (!file)
+    {
+        throw std::runtime_error("Failed to open trace file " + path.string());
+    }
+
+    // Complete events, with times in microseconds
+    file << std::fixed << std::setprecision(3);
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    for (std::size_t i {}; i < frames.zones.size(); ++i)
+    {
+        const auto &zone = frames.zones[i];
+        file << (i == 0 ? "\n" : ",\n") << "{\"name\":";
+        write_json_string(file, zone.name);
+        file << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << zone.thread_index
+             << ",\"ts\":"
+             << static_cast<double>(zone.begin - frames.begin) / 1000.0
+             << ",\"dur\":"
+             << static_cast<double>(zone.end - zone.begin) / 1000.0 << '}';
+    }
+    file << "\n]}\n";
+
+    if (!file)
+    {
+        throw std::runtime_error("Failed to write trace file " +
+                                 path.string());
+    }
+}
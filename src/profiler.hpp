@@ -0,0 +1,65 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+// A completed zone, times are in nanoseconds of std::chrono::steady_clock
+struct Profile_zone_record
+{
+    // Must outlive the profiler, usually a string literal
+    const char *name;
+    std::int64_t begin;
+    std::int64_t end;
+    // Nesting level in its thread, 0 for the outermost zones
+    std::uint32_t depth;
+    // In order of the first zone recorded by each thread
+    std::uint32_t thread_index;
+};
+
+struct Profile_frames
+{
+    std::int64_t begin;
+    std::int64_t end;
+    // Every zone overlapping [begin, end), on all threads
+    std::vector<Profile_zone_record> zones;
+};
+
+// Times the enclosing scope. Each thread records into its own ring buffer
+// without locking, only the first zone of a thread takes a lock.
+class Profile_zone
+{
+public:
+    [[nodiscard]] explicit Profile_zone(const char *name) noexcept;
+    ~Profile_zone();
+
+    Profile_zone(const Profile_zone &) = delete;
+    Profile_zone &operator=(const Profile_zone &) = delete;
+
+    Profile_zone(Profile_zone &&) = delete;
+    Profile_zone &operator=(Profile_zone &&) = delete;
+
+private:
+    const char *m_name;
+    std::int64_t m_begin;
+};
+
+// Number of frame boundaries kept, so the largest frame_count below
+inline constexpr std::size_t g_profiler_max_frames {256};
+
+// Starts a new frame, called once per frame from a single thread
+void profiler_mark_frame() noexcept;
+
+// Returns the last frame_count completed frames, or fewer if not enough have
+// been marked yet. Zones overwritten while reading are dropped.
+[[nodiscard]] Profile_frames profiler_frames(std::size_t frame_count);
+
+// Writes the last frame_count completed frames in the Chrome trace event
+// format, viewable in chrome://tracing or Perfetto. Throws std::runtime_error
+// if the file cannot be written.
+void write_chrome_trace(const std::filesystem::path &path,
+                        std::size_t frame_count);
+
+#endif // PROFILER_HPP
@@ -0,0 +1,329 @@
+#include "render_graph.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+Render_resource
+Render_graph::add_transient_image(std::string name,
+                                  const Transient_image_info &info)
+{
+    const auto id = static_cast<Render_resource>(m_resources.size());
+    m_resources.push_back({.name = std::move(name),
+                           .imported = false,
+                           .initial_usage = Resource_usage::undefined,
+                           .final_usage = Resource_usage::undefined,
+                           .transient_info = info});
+    return id;
+}
+
+Render_resource Render_graph::import_image(std::string name,
+                                           Resource_usage initial_usage,
+                                           Resource_usage final_usage)
+{
+    const auto id = static_cast<Render_resource>(m_resources.size());
+    m_resources.push_back({.name = std::move(name),
+                           .imported = true,
+                           .initial_usage = initial_usage,
+                           .final_usage = final_usage,
+                           .transient_info = {}});
+    return id;
+}
+
+Render_pass_id Render_graph::add_pass(std::string name)
+{
+    const auto id = static_cast<Render_pass_id>(m_passes.size());
+    m_passes.push_back(
+        {.name = std::move(name), .accesses = {}, .side_effects = false});
+    return id;
+}
+
+void Render_graph::read(Render_pass_id pass,
+                        Render_resource resource,
+                        Resource_usage usage)
+{
+    add_access(pass, resource, usage, true, false);
+}
+
+void Render_graph::write(Render_pass_id pass,
+                         Render_resource resource,
+                         Resource_usage usage)
+{
+    add_access(pass, resource, usage, false, true);
+}
+
+void Render_graph::set_side_effects(Render_pass_id pass, bool side_effects)
+{
+    m_passes[pass].side_effects = side_effects;
+}
+
+void Render_graph::add_access(Render_pass_id pass,
+                              Render_resource resource,
+                              Resource_usage usage,
+                              bool read,
+                              bool write)
+{
+    auto &accesses = m_passes[pass].accesses;
+    const auto it = std::find_if(accesses.begin(),
+                                 accesses.end(),
+                                 [&](const Access &access)
+                                 { return access.resource == resource; });
+    if (it == accesses.end())
+    {
+        accesses.push_back({.resource = resource,
+                            .usage = usage,
+                            .read = read,
+                            .write = write});
+        return;
+    }
+
+    // An image has a single layout during a pass
+    if (it->usage != usage)
+    {
+        throw std::runtime_error("Pass \"" + m_passes[pass].name +
+                                 "\" uses \"" + m_resources[resource].name +
+                                 "\" with two different usages");
+    }
+    it->read = it->read || read;
+    it->write = it->write || write;
+}
+
+Compiled_render_graph Render_graph::compile() const
+{
+    Compiled_render_graph compiled {.passes = {},
+                                    .final_barriers = {},
+                                    .memory_slots = {},
+                                    .resource_slots = {},
+                                    .culled_pass_count = 0};
+
+    // Walk the passes backwards from the imported resources. A pass is live
+    // if it has side effects or writes contents that are needed later. The
+    // contents it overwrites without reading are no longer needed before it.
+    std::vector<bool> needed(m_resources.size());
+    for (std::size_t i {}; i < m_resources.size(); ++i)
+    {
+        needed[i] = m_resources[i].imported;
+    }
+
+    std::vector<bool> live(m_passes.size());
+    for (auto i = m_passes.size(); i-- > 0;)
+    {
+        const auto &accesses = m_passes[i].accesses;
+        live[i] = m_passes[i].side_effects ||
+                  std::any_of(
+                      accesses.begin(),
+                      accesses.end(),
+                      [&](const Access &access)
+                      { return access.write && needed[access.resource]; });
+        if (!live[i])
+        {
+            ++compiled.culled_pass_count;
+            continue;
+        }
+
+        // A pass that both reads and writes a resource still needs it, so
+        // reads are applied after writes
+        for (const auto &access : accesses)
+        {
+            if (access.write)
+            {
+                needed[access.resource] = false;
+            }
+        }
+        for (const auto &access : accesses)
+        {
+            if (access.read)
+            {
+                needed[access.resource] = true;
+            }
+        }
+    }
+
+    std::vector<Render_pass_id> live_passes;
+    for (std::size_t i {}; i < m_passes.size(); ++i)
+    {
+        if (live[i])
+        {
+            live_passes.push_back(static_cast<Render_pass_id>(i));
+        }
+    }
+
+    // Lifetimes of the transient images, as indices into live_passes
+    struct Lifetime
+    {
+        Render_resource resource;
+        std::size_t first;
+        std::size_t last;
+        Resource_usage last_usage;
+    };
+    std::vector<Lifetime> lifetimes;
+    for (std::size_t i {}; i < live_passes.size(); ++i)
+    {
+        for (const auto &access : m_passes[live_passes[i]].accesses)
+        {
+            if (m_resources[access.resource].imported)
+            {
+                continue;
+            }
+
+            const auto it = std::find_if(lifetimes.begin(),
+                                         lifetimes.end(),
+                                         [&](const Lifetime &lifetime) {
+                                             return lifetime.resource ==
+                                                    access.resource;
+                                         });
+            if (it == lifetimes.end())
+            {
+                lifetimes.push_back({.resource = access.resource,
+                                     .first = i,
+                                     .last = i,
+                                     .last_usage = access.usage});
+            }
+            else
+            {
+                it->last = i;
+                it->last_usage = access.usage;
+            }
+        }
+    }
+
+    // Greedily place each transient image in the first slot that is free for
+    // its whole lifetime. lifetimes is already sorted by first use.
+    struct Slot_occupant
+    {
+        Render_resource first_resource;
+        std::size_t last;
+        Resource_usage last_usage;
+    };
+    std::vector<Slot_occupant> slot_occupants;
+    // The usage of the memory before the first use of each transient image
+    std::vector<std::optional<Resource_usage>> previous_usages(
+        m_resources.size());
+    compiled.resource_slots.resize(m_resources.size());
+
+    for (const auto &lifetime : lifetimes)
+    {
+        const auto &info = m_resources[lifetime.resource].transient_info;
+
+        std::uint32_t slot {};
+        while (slot < slot_occupants.size() &&
+               (slot_occupants[slot].last >= lifetime.first ||
+                (compiled.memory_slots[slot].memory_type_bits &
+                 info.memory_type_bits) == 0))
+        {
+            ++slot;
+        }
+
+        if (slot == slot_occupants.size())
+        {
+            compiled.memory_slots.push_back(
+                {.size = info.size,
+                 .alignment = info.alignment,
+                 .memory_type_bits = info.memory_type_bits});
+            slot_occupants.push_back({.first_resource = lifetime.resource,
+                                      .last = 0,
+                                      .last_usage = Resource_usage::undefined});
+        }
+        else
+        {
+            auto &memory_slot = compiled.memory_slots[slot];
+            memory_slot.size = std::max(memory_slot.size, info.size);
+            memory_slot.alignment =
+                std::max(memory_slot.alignment, info.alignment);
+            memory_slot.memory_type_bits &= info.memory_type_bits;
+            previous_usages[lifetime.resource] =
+                slot_occupants[slot].last_usage;
+        }
+
+        slot_occupants[slot].last = lifetime.last;
+        slot_occupants[slot].last_usage = lifetime.last_usage;
+        compiled.resource_slots[lifetime.resource] = slot;
+    }
+
+    // The graph runs every frame: the first image of a slot follows the last
+    // one of the previous frame, whose commands may still use the memory
+    for (const auto &occupant : slot_occupants)
+    {
+        previous_usages[occupant.first_resource] = occupant.last_usage;
+    }
+
+    // Barriers: a read after a read in the same usage is the only case that
+    // needs none
+    struct Resource_state
+    {
+        Resource_usage usage;
+        bool written;
+        bool first_use;
+    };
+    std::vector<Resource_state> states(m_resources.size());
+    for (std::size_t i {}; i < m_resources.size(); ++i)
+    {
+        states[i] = {.usage = m_resources[i].initial_usage,
+                     .written = false,
+                     .first_use = true};
+    }
+
+    for (const auto pass : live_passes)
+    {
+        Compiled_render_pass compiled_pass {.pass = pass, .barriers = {}};
+
+        for (const auto &access : m_passes[pass].accesses)
+        {
+            auto &state = states[access.resource];
+            const auto &resource = m_resources[access.resource];
+
+            if (state.first_use && !resource.imported)
+            {
+                compiled_pass.barriers.push_back(
+                    {.resource = access.resource,
+                     .before = previous_usages[access.resource].value_or(
+                         Resource_usage::undefined),
+                     .after = access.usage,
+                     .discard = true});
+            }
+            else if (state.written || access.write ||
+                     state.usage != access.usage)
+            {
+                compiled_pass.barriers.push_back(
+                    {.resource = access.resource,
+                     .before = state.usage,
+                     .after = access.usage,
+                     .discard =
+                         state.usage == Resource_usage::undefined});
+            }
+
+            state = {.usage = access.usage,
+                     .written = access.write,
+                     .first_use = false};
+        }
+
+        compiled.passes.push_back(std::move(compiled_pass));
+    }
+
+    for (std::size_t i {}; i < m_resources.size(); ++i)
+    {
+        const auto &resource = m_resources[i];
+        const auto &state = states[i];
+        if (resource.imported && !state.first_use &&
+            resource.final_usage != Resource_usage::undefined &&
+            resource.final_usage != state.usage)
+        {
+            compiled.final_barriers.push_back(
+                {.resource = static_cast<Render_resource>(i),
+                 .before = state.usage,
+                 .after = resource.final_usage,
+                 .discard = false});
+        }
+    }
+
+    return compiled;
+}
+
+const std::string &Render_graph::pass_name(Render_pass_id pass) const
+{
+    return m_passes[pass].name;
+}
+
+const std::string &Render_graph::resource_name(Render_resource resource) const
+{
+    return m_resources[resource].name;
+}
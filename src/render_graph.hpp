@@ -0,0 +1,149 @@
+#ifndef RENDER_GRAPH_HPP
+#define RENDER_GRAPH_HPP
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+using Render_resource = std::uint32_t;
+using Render_pass_id = std::uint32_t;
+
+// How a pass uses an image. Each usage implies a layout, pipeline stage and
+// access, mapped to Vulkan by the renderer.
+enum class Resource_usage : std::uint8_t
+{
+    undefined,
+    color_attachment,
+    sampled,
+    transfer_src,
+    transfer_dst,
+    present
+};
+
+// Memory requirements of a transient image, whose memory is owned by the
+// graph and may be shared with other transient images
+struct Transient_image_info
+{
+    std::uint64_t size;
+    std::uint64_t alignment;
+    std::uint32_t memory_type_bits;
+};
+
+struct Render_barrier
+{
+    Render_resource resource;
+    // On the first use of a transient image, the last usage of its memory by
+    // the previous image in the slot, or by the last one of the previous frame
+    Resource_usage before;
+    Resource_usage after;
+    // The previous contents are not needed: first use in the frame, or the
+    // memory was used by another transient image
+    bool discard;
+};
+
+struct Compiled_render_pass
+{
+    Render_pass_id pass;
+    // To be recorded as a single pipeline barrier before the pass
+    std::vector<Render_barrier> barriers;
+};
+
+struct Memory_slot
+{
+    std::uint64_t size;
+    std::uint64_t alignment;
+    std::uint32_t memory_type_bits;
+};
+
+struct Compiled_render_graph
+{
+    // Passes that contribute to an imported resource, in submission order
+    std::vector<Compiled_render_pass> passes;
+    // Transitions of the imported resources to their final usage
+    std::vector<Render_barrier> final_barriers;
+    // Transient images with non-overlapping lifetimes share a slot
+    std::vector<Memory_slot> memory_slots;
+    // Indexed by resource, empty for imported and unused resources
+    std::vector<std::optional<std::uint32_t>> resource_slots;
+    std::size_t culled_pass_count;
+};
+
+// Describes the passes of a frame and the images they read and write.
+// Compiling the graph culls the passes whose output is never used, unless they
+// have side effects, computes the barriers between passes and assigns memory
+// to transient images.
+class Render_graph
+{
+public:
+    [[nodiscard]] Render_resource
+    add_transient_image(std::string name, const Transient_image_info &info);
+
+    // For images owned outside the graph, e.g. swapchain images. They are in
+    // initial_usage at the start of the frame, and must be left in
+    // final_usage. Imported images are the outputs of the graph.
+    [[nodiscard]] Render_resource import_image(std::string name,
+                                               Resource_usage initial_usage,
+                                               Resource_usage final_usage);
+
+    // Passes are submitted in the order they are added
+    [[nodiscard]] Render_pass_id add_pass(std::string name);
+
+    void
+    read(Render_pass_id pass, Render_resource resource, Resource_usage usage);
+
+    // A write that also depends on the previous contents (e.g. blending onto
+    // a loaded attachment) must be declared as a read as well
+    void
+    write(Render_pass_id pass, Render_resource resource, Resource_usage usage);
+
+    // A pass with effects outside the graph, e.g. copying an image back to the
+    // host, is kept even if nothing reads what it writes. Recompile the graph
+    // to apply a change.
+    void set_side_effects(Render_pass_id pass, bool side_effects);
+
+    // Throws std::runtime_error if a pass uses the same resource with two
+    // different usages
+    [[nodiscard]] Compiled_render_graph compile() const;
+
+    [[nodiscard]] const std::string &pass_name(Render_pass_id pass) const;
+
+    [[nodiscard]] const std::string &
+    resource_name(Render_resource resource) const;
+
+private:
+    struct Resource
+    {
+        std::string name;
+        bool imported;
+        Resource_usage initial_usage;
+        Resource_usage final_usage;
+        Transient_image_info transient_info;
+    };
+
+    struct Access
+    {
+        Render_resource resource;
+        Resource_usage usage;
+        bool read;
+        bool write;
+    };
+
+    struct Pass
+    {
+        std::string name;
+        std::vector<Access> accesses;
+        bool side_effects;
+    };
+
+    void add_access(Render_pass_id pass,
+                    Render_resource resource,
+                    Resource_usage usage,
+                    bool read,
+                    bool write);
+
+    std::vector<Resource> m_resources {};
+    std::vector<Pass> m_passes {};
+};
+
+#endif // RENDER_GRAPH_HPP
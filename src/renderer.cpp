@@ -1,5 +1,8 @@
 #include "renderer.hpp"
 
+#include "hash.hpp"
+#include "profiler.hpp"
+#include "shaders.hpp"
 #include "utils.hpp"
 
 #ifdef ENABLE_DEBUG_UI
@@ -32,9 +35,15 @@
 #pragma GCC diagnostic pop
 #endif
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
 #include <iostream>
 #include <limits>
+#include <numeric>
+#include <span>
 #include <stdexcept>
+#include <string_view>
 #include <vector>
 
 namespace
@@ -79,24 +88,6 @@ khronos_validation_layer_supported(const vk::raii::Context &context)
 
 #endif
 
-constexpr std::uint32_t g_max_frames_in_flight {2};
-
-constexpr vk::VertexInputBindingDescription g_vertex_input_binding_description {
-    .binding = 0,
-    .stride = sizeof(Vertex),
-    .inputRate = vk::VertexInputRate::eVertex};
-
-constexpr std::array g_vertex_input_attribute_descriptions {
-    vk::VertexInputAttributeDescription {.location = 0,
-                                         .binding = 0,
-                                         .format = vk::Format::eR32G32B32Sfloat,
-                                         .offset = offsetof(Vertex, pos)},
-    vk::VertexInputAttributeDescription {.location = 1,
-                                         .binding = 0,
-                                         .format = vk::Format::eR32G32Sfloat,
-                                         .offset =
-                                             offsetof(Vertex, tex_coord)}};
-
 constexpr Vertex g_fullscreen_quad_vertices[] {
     {{-1.0f, -1.0f, 0.0f}, {0.0f, 0.0f}},
     {{-1.0f, 1.0f, 0.0f}, {0.0f, 1.0f}},
@@ -105,13 +96,23 @@ constexpr Vertex g_fullscreen_quad_vertices[] {
 
 constexpr std::uint16_t g_quad_indices[] {0, 1, 2, 2, 3, 0};
 
-constexpr auto g_offscreen_vertex_shader_path =
-    "shaders/spv/offscreen.vert.spv";
-constexpr auto g_offscreen_fragment_shader_path =
-    "shaders/spv/offscreen.frag.spv";
-constexpr auto g_final_vertex_shader_path = "shaders/spv/final.vert.spv";
-constexpr auto g_final_fragment_shader_path = "shaders/spv/final.frag.spv";
+constexpr auto g_offscreen_vertex_shader = "offscreen.vert";
+constexpr auto g_offscreen_fragment_shader = "offscreen.frag";
+constexpr auto g_final_vertex_shader = "final.vert";
+constexpr auto g_final_fragment_shader = "final.frag";
 constexpr auto g_texture_path = "assets/texture.jpg";
+#ifdef ENABLE_HOT_RELOAD
+constexpr auto g_asset_directory = "assets";
+#endif
+
+constexpr auto g_asset_cache_directory = ".cache/assets";
+constexpr auto g_pipeline_cache_path = ".cache/pipeline_cache.bin";
+
+constexpr std::uint32_t g_placeholder_max_size {16};
+
+// Resize events closer than this are a single resize, the swapchain is only
+// recreated once they stop, unless it can no longer be presented to
+constexpr std::chrono::milliseconds g_resize_settle_time {50};
 
 [[nodiscard]] bool instance_extensions_supported(
     const vk::raii::Context &context,
@@ -138,18 +139,19 @@ constexpr auto g_texture_path = "assets/texture.jpg";
 }
 
 [[nodiscard]] bool
-swapchain_extension_supported(const vk::raii::PhysicalDevice &physical_device)
+device_extension_supported(const vk::raii::PhysicalDevice &physical_device,
+                           const char *extension)
 {
     const auto available_extensions =
         physical_device.enumerateDeviceExtensionProperties();
 
     return std::any_of(available_extensions.begin(),
                        available_extensions.end(),
-                       [](const vk::ExtensionProperties &extension_properties)
+                       [&](const vk::ExtensionProperties &extension_properties)
                        {
                            return std::strcmp(
                                       extension_properties.extensionName,
-                                      VK_KHR_SWAPCHAIN_EXTENSION_NAME) == 0;
+                                      extension) == 0;
                        });
 }
 
@@ -170,7 +172,12 @@ get_queue_family_indices(const vk::raii::PhysicalDevice &physical_device,
             graphics_queue_family_index = i;
         }
 
-        if (physical_device.getSurfaceSupportKHR(i, surface))
+        // Nothing is presented when headless
+        if (!surface)
+        {
+            present_queue_family_index = graphics_queue_family_index;
+        }
+        else if (physical_device.getSurfaceSupportKHR(i, surface))
         {
             present_queue_family_index = i;
         }
@@ -192,19 +199,30 @@ get_queue_family_indices(const vk::raii::PhysicalDevice &physical_device,
 is_physical_device_suitable(const vk::raii::PhysicalDevice &physical_device,
                             vk::SurfaceKHR surface)
 {
-    if (!swapchain_extension_supported(physical_device))
+    // Frames are synchronized with a timeline semaphore
+    if (physical_device.getProperties().apiVersion < VK_API_VERSION_1_2)
     {
         return false;
     }
 
-    if (physical_device.getSurfaceFormatsKHR(surface).empty())
+    // Presentation is only required with a surface
+    if (surface)
     {
-        return false;
-    }
+        if (!device_extension_supported(physical_device,
+                                        VK_KHR_SWAPCHAIN_EXTENSION_NAME))
+        {
+            return false;
+        }
 
-    if (physical_device.getSurfacePresentModesKHR(surface).empty())
-    {
-        return false;
+        if (physical_device.getSurfaceFormatsKHR(surface).empty())
+        {
+            return false;
+        }
+
+        if (physical_device.getSurfacePresentModesKHR(surface).empty())
+        {
+            return false;
+        }
     }
 
     if (!get_queue_family_indices(physical_device, surface).has_value())
@@ -215,8 +233,10 @@ is_physical_device_suitable(const vk::raii::PhysicalDevice &physical_device,
     return true;
 }
 
+// The surface extensions are not enabled when headless, GLFW is not
+// initialized then
 [[nodiscard]] vk::raii::Instance
-create_instance(const vk::raii::Context &context)
+create_instance(const vk::raii::Context &context, bool headless)
 {
     constexpr vk::ApplicationInfo application_info {
         .pApplicationName = "Vulkan Experiment",
@@ -225,10 +245,14 @@ create_instance(const vk::raii::Context &context)
         .engineVersion = {},
         .apiVersion = VK_API_VERSION_1_3};
 
-    std::uint32_t extension_count {};
-    const auto extensions = glfwGetRequiredInstanceExtensions(&extension_count);
-    std::vector<const char *> required_extensions(extensions,
-                                                  extensions + extension_count);
+    std::vector<const char *> required_extensions;
+    if (!headless)
+    {
+        std::uint32_t extension_count {};
+        const auto extensions =
+            glfwGetRequiredInstanceExtensions(&extension_count);
+        required_extensions.assign(extensions, extensions + extension_count);
+    }
 
 #ifdef ENABLE_VALIDATION_LAYERS
 
@@ -337,9 +361,56 @@ select_physical_device(const vk::raii::Instance &instance,
     return suitable_devices.front();
 }
 
+[[nodiscard]] Rendering_path
+select_rendering_path(const vk::raii::PhysicalDevice &physical_device)
+{
+    // The dynamicRendering feature is required by Vulkan 1.3 and by the
+    // extension
+    const auto api_version = physical_device.getProperties().apiVersion;
+    if (api_version >= VK_API_VERSION_1_3)
+    {
+        return Rendering_path::dynamic_rendering;
+    }
+
+    // The dependencies of the extension are core in Vulkan 1.2
+    if (api_version >= VK_API_VERSION_1_2 &&
+        device_extension_supported(physical_device,
+                                   VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME))
+    {
+        return Rendering_path::dynamic_rendering_khr;
+    }
+
+    return Rendering_path::render_pass;
+}
+
+// Whether presents can be waited for, to measure when they reach the screen
+[[nodiscard]] bool
+present_wait_supported(const vk::raii::PhysicalDevice &physical_device)
+{
+    if (!device_extension_supported(physical_device,
+                                    VK_KHR_PRESENT_ID_EXTENSION_NAME) ||
+        !device_extension_supported(physical_device,
+                                    VK_KHR_PRESENT_WAIT_EXTENSION_NAME))
+    {
+        return false;
+    }
+
+    using Present_id_features = vk::PhysicalDevicePresentIdFeaturesKHR;
+    using Present_wait_features = vk::PhysicalDevicePresentWaitFeaturesKHR;
+    const auto features =
+        physical_device.getFeatures2<vk::PhysicalDeviceFeatures2,
+                                     Present_id_features,
+                                     Present_wait_features>();
+    return features.get<Present_id_features>().presentId &&
+           features.get<Present_wait_features>().presentWait;
+}
+
 [[nodiscard]] vk::raii::Device
 create_device(const vk::raii::PhysicalDevice &physical_device,
-              const Queue_family_indices &queue_family_indices)
+              const Queue_family_indices &queue_family_indices,
+              Rendering_path rendering_path,
+              bool headless,
+              bool present_wait)
 {
     std::vector<vk::DeviceQueueCreateInfo> queue_create_infos;
 
@@ -360,26 +431,107 @@ create_device(const vk::raii::PhysicalDevice &physical_device,
         queue_create_infos.push_back(present_queue_create_info);
     }
 
-    constexpr auto swapchain_extension = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
+    std::vector<const char *> extensions;
+    if (!headless)
+    {
+        extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    }
+    if (rendering_path == Rendering_path::dynamic_rendering_khr)
+    {
+        extensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+    }
+    if (present_wait)
+    {
+        extensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+        extensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+    }
+
+    vk::PhysicalDevicePresentIdFeaturesKHR present_id_features {
+        .presentId = VK_TRUE};
+    vk::PhysicalDevicePresentWaitFeaturesKHR present_wait_features {
+        .pNext = &present_id_features, .presentWait = VK_TRUE};
+
+    // Same structure for the core feature and the extension
+    vk::PhysicalDeviceDynamicRenderingFeatures dynamic_rendering_features {
+        .pNext = present_wait ? &present_wait_features : nullptr,
+        .dynamicRendering = VK_TRUE};
+
+    void *extension_features {};
+    if (rendering_path != Rendering_path::render_pass)
+    {
+        extension_features = &dynamic_rendering_features;
+    }
+    else if (present_wait)
+    {
+        extension_features = &present_wait_features;
+    }
+
+    const vk::PhysicalDeviceVulkan12Features vulkan_12_features {
+        .pNext = extension_features, .timelineSemaphore = VK_TRUE};
+
     const vk::DeviceCreateInfo device_create_info {
+        .pNext = &vulkan_12_features,
         .queueCreateInfoCount =
             static_cast<std::uint32_t>(queue_create_infos.size()),
         .pQueueCreateInfos = queue_create_infos.data(),
-        .enabledExtensionCount = 1,
-        .ppEnabledExtensionNames = &swapchain_extension};
+        .enabledExtensionCount = static_cast<std::uint32_t>(extensions.size()),
+        .ppEnabledExtensionNames = extensions.data()};
 
     // NOTE: set pEnabledFeatures if some specific device features are enabled
 
     return {physical_device, device_create_info};
 }
 
+[[nodiscard]] constexpr vk::PresentModeKHR
+vk_present_mode(Present_mode present_mode)
+{
+    switch (present_mode)
+    {
+    case Present_mode::fifo: return vk::PresentModeKHR::eFifo;
+    case Present_mode::fifo_relaxed: return vk::PresentModeKHR::eFifoRelaxed;
+    case Present_mode::mailbox: return vk::PresentModeKHR::eMailbox;
+    case Present_mode::immediate: return vk::PresentModeKHR::eImmediate;
+    }
+    return vk::PresentModeKHR::eFifo;
+}
+
+// Falls back to the closest supported mode in latency: immediate to mailbox,
+// then everything to FIFO, which is always supported
+[[nodiscard]] Present_mode
+select_present_mode(const vk::raii::PhysicalDevice &physical_device,
+                    vk::SurfaceKHR surface,
+                    Present_mode requested_present_mode)
+{
+    const auto present_modes =
+        physical_device.getSurfacePresentModesKHR(surface);
+    const auto is_supported = [&](Present_mode present_mode)
+    {
+        return std::find(present_modes.begin(),
+                         present_modes.end(),
+                         vk_present_mode(present_mode)) != present_modes.end();
+    };
+
+    if (is_supported(requested_present_mode))
+    {
+        return requested_present_mode;
+    }
+    if (requested_present_mode == Present_mode::immediate &&
+        is_supported(Present_mode::mailbox))
+    {
+        return Present_mode::mailbox;
+    }
+    return Present_mode::fifo;
+}
+
 [[nodiscard]] Vulkan_swapchain
 create_swapchain(const vk::raii::Device &device,
                  const vk::raii::PhysicalDevice &physical_device,
                  vk::SurfaceKHR surface,
                  const Queue_family_indices &queue_family_indices,
                  std::uint32_t width,
-                 std::uint32_t height)
+                 std::uint32_t height,
+                 Present_mode requested_present_mode,
+                 vk::SwapchainKHR old_swapchain)
 {
     const auto surface_formats = physical_device.getSurfaceFormatsKHR(surface);
     const auto surface_format_it = std::find_if(
@@ -424,6 +576,17 @@ create_swapchain(const vk::raii::Device &device,
         min_image_count = surface_capabilities.maxImageCount;
     }
 
+    const auto present_mode = select_present_mode(
+        physical_device, surface, requested_present_mode);
+
+    auto image_usage =
+        vk::ImageUsageFlags {vk::ImageUsageFlagBits::eColorAttachment};
+    if (surface_capabilities.supportedUsageFlags &
+        vk::ImageUsageFlagBits::eTransferSrc)
+    {
+        image_usage |= vk::ImageUsageFlagBits::eTransferSrc;
+    }
+
     vk::SwapchainCreateInfoKHR swapchain_create_info {
         .surface = surface,
         .minImageCount = min_image_count,
@@ -431,11 +594,12 @@ create_swapchain(const vk::raii::Device &device,
         .imageColorSpace = surface_format.colorSpace,
         .imageExtent = extent,
         .imageArrayLayers = 1,
-        .imageUsage = vk::ImageUsageFlagBits::eColorAttachment,
+        .imageUsage = image_usage,
         .preTransform = surface_capabilities.currentTransform,
         .compositeAlpha = vk::CompositeAlphaFlagBitsKHR::eOpaque,
-        .presentMode = vk::PresentModeKHR::eFifo,
-        .clipped = VK_TRUE};
+        .presentMode = vk_present_mode(present_mode),
+        .clipped = VK_TRUE,
+        .oldSwapchain = old_swapchain};
 
     const std::uint32_t queue_family_indices_array[] {
         queue_family_indices.graphics, queue_family_indices.present};
@@ -456,7 +620,25 @@ create_swapchain(const vk::raii::Device &device,
         .swapchain = vk::raii::SwapchainKHR(device, swapchain_create_info),
         .format = surface_format.format,
         .extent = extent,
-        .min_image_count = min_image_count};
+        .min_image_count = min_image_count,
+        .image_usage = image_usage,
+        .present_mode = present_mode};
+}
+
+// Describes the images rendered to when headless. The format matches the
+// channel order expected by write_image_to_png.
+[[nodiscard]] Vulkan_swapchain
+create_headless_swapchain(std::uint32_t width,
+                          std::uint32_t height,
+                          Present_mode present_mode)
+{
+    return {.swapchain = vk::raii::SwapchainKHR {nullptr},
+            .format = vk::Format::eR8G8B8A8Unorm,
+            .extent = {width, height},
+            .min_image_count = g_max_frames_in_flight,
+            .image_usage = vk::ImageUsageFlagBits::eColorAttachment |
+                           vk::ImageUsageFlagBits::eTransferSrc,
+            .present_mode = present_mode};
 }
 
 [[nodiscard]] std::vector<vk::Image>
@@ -518,6 +700,53 @@ create_command_pool(const vk::raii::Device &device,
     return {device, create_info};
 }
 
+// Nanoseconds per timestamp tick, or 0 if the queue family does not support
+// timestamps
+[[nodiscard]] float
+timestamp_period(const vk::raii::PhysicalDevice &physical_device,
+                 std::uint32_t graphics_family_index)
+{
+    const auto queue_families = physical_device.getQueueFamilyProperties();
+    if (queue_families[graphics_family_index].timestampValidBits == 0)
+    {
+        return 0.0f;
+    }
+    return physical_device.getProperties().limits.timestampPeriod;
+}
+
+// Of the bits the queue family writes in timestamps, which wrap around past
+// them
+[[nodiscard]] std::uint64_t
+timestamp_mask(const vk::raii::PhysicalDevice &physical_device,
+               std::uint32_t graphics_family_index)
+{
+    const auto valid_bits =
+        physical_device.getQueueFamilyProperties()[graphics_family_index]
+            .timestampValidBits;
+    if (valid_bits >= 64)
+    {
+        return ~std::uint64_t {};
+    }
+    return (std::uint64_t {1} << valid_bits) - 1;
+}
+
+[[nodiscard]] std::vector<vk::raii::QueryPool>
+create_timestamp_query_pools(const vk::raii::Device &device)
+{
+    constexpr vk::QueryPoolCreateInfo create_info {
+        .queryType = vk::QueryType::eTimestamp,
+        .queryCount = g_gpu_timestamp_count};
+
+    std::vector<vk::raii::QueryPool> query_pools;
+    query_pools.reserve(g_max_frames_in_flight);
+    for (std::uint32_t i {}; i < g_max_frames_in_flight; ++i)
+    {
+        query_pools.emplace_back(device, create_info);
+    }
+
+    return query_pools;
+}
+
 [[nodiscard]] vk::raii::CommandBuffer
 begin_one_time_submit_command_buffer(const vk::raii::Device &device,
                                      const vk::raii::CommandPool &command_pool)
@@ -538,7 +767,7 @@ begin_one_time_submit_command_buffer(const vk::raii::Device &device,
     return command_buffer;
 }
 
-void end_one_time_submit_command_buffer(
+void submit_one_time_submit_command_buffer(
     const vk::raii::CommandBuffer &command_buffer,
     const vk::raii::Queue &graphics_queue)
 {
@@ -548,6 +777,13 @@ void end_one_time_submit_command_buffer(
                                       .pCommandBuffers = &*command_buffer};
 
     graphics_queue.submit(submit_info);
+}
+
+void end_one_time_submit_command_buffer(
+    const vk::raii::CommandBuffer &command_buffer,
+    const vk::raii::Queue &graphics_queue)
+{
+    submit_one_time_submit_command_buffer(command_buffer, graphics_queue);
     graphics_queue.waitIdle();
 }
 
@@ -599,14 +835,145 @@ create_buffer(const vk::raii::Device &device,
     return {std::move(buffer), std::move(memory)};
 }
 
-[[nodiscard]] Vulkan_image
-create_image(const vk::raii::Device &device,
-             const vk::raii::PhysicalDevice &physical_device,
-             std::uint32_t width,
-             std::uint32_t height,
-             vk::Format format,
-             vk::ImageUsageFlags usage,
-             vk::MemoryPropertyFlags properties)
+[[nodiscard]] std::vector<Input_buffer>
+create_input_buffers(const vk::raii::Device &device,
+                     const vk::raii::PhysicalDevice &physical_device)
+{
+    std::vector<Input_buffer> input_buffers;
+    input_buffers.reserve(g_max_frames_in_flight);
+    for (std::uint32_t i {}; i < g_max_frames_in_flight; ++i)
+    {
+        auto buffer =
+            create_buffer(device,
+                          physical_device,
+                          sizeof(Latched_input),
+                          vk::BufferUsageFlagBits::eUniformBuffer,
+                          vk::MemoryPropertyFlagBits::eHostVisible |
+                              vk::MemoryPropertyFlagBits::eHostCoherent);
+        // Unmapped when the memory is freed
+        auto *const mapped = static_cast<Latched_input *>(
+            buffer.memory.mapMemory(0, sizeof(Latched_input)));
+        *mapped = {};
+        input_buffers.push_back(
+            {.buffer = std::move(buffer), .mapped = mapped});
+    }
+
+    return input_buffers;
+}
+
+// The CPU reads every byte, so cached memory is used if there is some
+[[nodiscard]] std::vector<Capture_buffer>
+create_capture_buffers(const vk::raii::Device &device,
+                       const vk::raii::PhysicalDevice &physical_device,
+                       vk::Extent2D extent)
+{
+    const auto size = static_cast<vk::DeviceSize>(extent.width) *
+                      extent.height * 4;
+
+    const auto coherent = vk::MemoryPropertyFlagBits::eHostVisible |
+                          vk::MemoryPropertyFlagBits::eHostCoherent;
+    const auto cached = coherent | vk::MemoryPropertyFlagBits::eHostCached;
+    const auto memory_properties = physical_device.getMemoryProperties();
+    const auto has_cached_memory = std::any_of(
+        memory_properties.memoryTypes.begin(),
+        memory_properties.memoryTypes.begin() +
+            memory_properties.memoryTypeCount,
+        [cached](const vk::MemoryType &type)
+        { return (type.propertyFlags & cached) == cached; });
+
+    std::vector<Capture_buffer> capture_buffers;
+    capture_buffers.reserve(g_capture_buffer_count);
+    for (std::uint32_t i {}; i < g_capture_buffer_count; ++i)
+    {
+        auto buffer = create_buffer(device,
+                                    physical_device,
+                                    size,
+                                    vk::BufferUsageFlagBits::eTransferDst,
+                                    has_cached_memory ? cached : coherent);
+        // Unmapped when the memory is freed
+        const auto *const mapped =
+            static_cast<const std::uint8_t *>(buffer.memory.mapMemory(0, size));
+        capture_buffers.push_back(
+            {.buffer = std::move(buffer), .mapped = mapped, .frame_number = 0});
+    }
+
+    return capture_buffers;
+}
+
+// Of the swapchain formats that can be captured
+[[nodiscard]] std::optional<Pixel_order> capture_pixel_order(vk::Format format)
+{
+    switch (format)
+    {
+    case vk::Format::eR8G8B8A8Unorm:
+    case vk::Format::eR8G8B8A8Srgb:
+        return Pixel_order::rgba;
+    case vk::Format::eB8G8R8A8Unorm:
+    case vk::Format::eB8G8R8A8Srgb:
+        return Pixel_order::bgra;
+    default:
+        return std::nullopt;
+    }
+}
+
+[[nodiscard]] Sprite_buffer
+create_sprite_buffer(const vk::raii::Device &device,
+                     const vk::raii::PhysicalDevice &physical_device,
+                     std::uint32_t capacity)
+{
+    capacity = std::max(capacity, 1u);
+    const auto size =
+        static_cast<vk::DeviceSize>(capacity) * 4 * sizeof(Vertex);
+    auto buffer = create_buffer(device,
+                                physical_device,
+                                size,
+                                vk::BufferUsageFlagBits::eVertexBuffer,
+                                vk::MemoryPropertyFlagBits::eHostVisible |
+                                    vk::MemoryPropertyFlagBits::eHostCoherent);
+    // Unmapped when the memory is freed
+    auto *const mapped =
+        static_cast<Vertex *>(buffer.memory.mapMemory(0, size));
+    return {
+        .buffer = std::move(buffer), .mapped = mapped, .capacity = capacity};
+}
+
+[[nodiscard]] std::vector<Sprite_buffer>
+create_sprite_buffers(const vk::raii::Device &device,
+                      const vk::raii::PhysicalDevice &physical_device,
+                      std::uint32_t capacity)
+{
+    std::vector<Sprite_buffer> sprite_buffers;
+    sprite_buffers.reserve(g_max_frames_in_flight);
+    for (std::uint32_t i {}; i < g_max_frames_in_flight; ++i)
+    {
+        sprite_buffers.push_back(
+            create_sprite_buffer(device, physical_device, capacity));
+    }
+    return sprite_buffers;
+}
+
+// Two triangles per quad, relative to the first vertex of the batch
+[[nodiscard]] std::vector<std::uint16_t> create_sprite_indices()
+{
+    std::vector<std::uint16_t> indices;
+    indices.reserve(g_sprite_batch_size * 6);
+    for (std::uint32_t i {}; i < g_sprite_batch_size; ++i)
+    {
+        for (const std::uint32_t index : {0, 1, 2, 2, 3, 0})
+        {
+            indices.push_back(static_cast<std::uint16_t>(i * 4 + index));
+        }
+    }
+    return indices;
+}
+
+// Memory must be bound before use
+[[nodiscard]] vk::raii::Image
+create_unbound_image(const vk::raii::Device &device,
+                     std::uint32_t width,
+                     std::uint32_t height,
+                     vk::Format format,
+                     vk::ImageUsageFlags usage)
 {
     const vk::ImageCreateInfo image_create_info {
         .imageType = vk::ImageType::e2D,
@@ -620,7 +987,19 @@ create_image(const vk::raii::Device &device,
         .sharingMode = vk::SharingMode::eExclusive,
         .initialLayout = vk::ImageLayout::eUndefined};
 
-    vk::raii::Image image(device, image_create_info);
+    return {device, image_create_info};
+}
+
+[[nodiscard]] Vulkan_image
+create_image(const vk::raii::Device &device,
+             const vk::raii::PhysicalDevice &physical_device,
+             std::uint32_t width,
+             std::uint32_t height,
+             vk::Format format,
+             vk::ImageUsageFlags usage,
+             vk::MemoryPropertyFlags properties)
+{
+    auto image = create_unbound_image(device, width, height, format, usage);
 
     const auto memory_requirements = image.getMemoryRequirements();
 
@@ -638,6 +1017,43 @@ create_image(const vk::raii::Device &device,
     return {std::move(image), std::move(view), std::move(memory)};
 }
 
+// Rendered to like swapchain images, and copied from to read frames back
+[[nodiscard]] std::vector<Vulkan_image>
+create_headless_images(const vk::raii::Device &device,
+                       const vk::raii::PhysicalDevice &physical_device,
+                       const Vulkan_swapchain &swapchain)
+{
+    std::vector<Vulkan_image> images;
+    images.reserve(swapchain.min_image_count);
+    for (std::uint32_t i {}; i < swapchain.min_image_count; ++i)
+    {
+        images.push_back(
+            create_image(device,
+                         physical_device,
+                         swapchain.extent.width,
+                         swapchain.extent.height,
+                         swapchain.format,
+                         swapchain.image_usage,
+                         vk::MemoryPropertyFlagBits::eDeviceLocal));
+    }
+
+    return images;
+}
+
+[[nodiscard]] std::vector<vk::Image>
+get_headless_images(const std::vector<Vulkan_image> &headless_images)
+{
+    std::vector<vk::Image> result;
+    result.reserve(headless_images.size());
+
+    for (const auto &image : headless_images)
+    {
+        result.push_back(*image.image);
+    }
+
+    return result;
+}
+
 void command_copy_buffer(const vk::raii::CommandBuffer &command_buffer,
                          vk::Buffer src,
                          vk::Buffer dst,
@@ -717,6 +1133,8 @@ void command_transition_image_layout(
         src_stage_mask, dst_stage_mask, {}, {}, {}, memory_barrier);
 }
 
+// The layout transitions and the synchronization with the other passes are
+// done by the barriers of the frame graph
 [[nodiscard]] vk::raii::RenderPass
 create_render_pass(const vk::raii::Device &device,
                    vk::Format color_attachment_format)
@@ -728,8 +1146,8 @@ create_render_pass(const vk::raii::Device &device,
         .storeOp = vk::AttachmentStoreOp::eStore,
         .stencilLoadOp = vk::AttachmentLoadOp::eDontCare,
         .stencilStoreOp = vk::AttachmentStoreOp::eDontCare,
-        .initialLayout = vk::ImageLayout::eUndefined,
-        .finalLayout = vk::ImageLayout::ePresentSrcKHR};
+        .initialLayout = vk::ImageLayout::eColorAttachmentOptimal,
+        .finalLayout = vk::ImageLayout::eColorAttachmentOptimal};
 
     constexpr vk::AttachmentReference color_attachment_reference {
         .attachment = 0, .layout = vk::ImageLayout::eColorAttachmentOptimal};
@@ -739,329 +1157,361 @@ create_render_pass(const vk::raii::Device &device,
         .colorAttachmentCount = 1,
         .pColorAttachments = &color_attachment_reference};
 
-    constexpr vk::SubpassDependency subpass_dependency {
-        .srcSubpass = VK_SUBPASS_EXTERNAL,
-        .dstSubpass = 0,
-        .srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput,
-        .dstStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput,
-        .srcAccessMask = {},
-        .dstAccessMask = vk::AccessFlagBits::eColorAttachmentWrite};
-
     const vk::RenderPassCreateInfo create_info {
         .attachmentCount = 1,
         .pAttachments = &color_attachment_description,
         .subpassCount = 1,
-        .pSubpasses = &subpass_description,
-        .dependencyCount = 1,
-        .pDependencies = &subpass_dependency};
+        .pSubpasses = &subpass_description};
 
     return {device, create_info};
 }
 
-[[nodiscard]] vk::raii::RenderPass
-create_offscreen_render_pass(const vk::raii::Device &device,
-                             vk::Format color_attachment_format)
+[[nodiscard]] vk::ShaderStageFlags shader_stage_flags(std::uint32_t stages)
 {
-    const vk::AttachmentDescription color_attachment_description {
-        .format = color_attachment_format,
-        .samples = vk::SampleCountFlagBits::e1,
-        .loadOp = vk::AttachmentLoadOp::eClear,
-        .storeOp = vk::AttachmentStoreOp::eStore,
-        .stencilLoadOp = vk::AttachmentLoadOp::eDontCare,
-        .stencilStoreOp = vk::AttachmentStoreOp::eDontCare,
-        .initialLayout = vk::ImageLayout::eUndefined,
-        .finalLayout = vk::ImageLayout::eShaderReadOnlyOptimal};
-
-    constexpr vk::AttachmentReference color_attachment_reference {
-        .attachment = 0, .layout = vk::ImageLayout::eColorAttachmentOptimal};
-
-    const vk::SubpassDescription subpass_description {
-        .pipelineBindPoint = vk::PipelineBindPoint::eGraphics,
-        .colorAttachmentCount = 1,
-        .pColorAttachments = &color_attachment_reference};
+    // Shader_stage has the same values as vk::ShaderStageFlagBits
+    return vk::ShaderStageFlags {stages};
+}
 
-    // Use subpass dependencies for layout transitions
-    constexpr vk::SubpassDependency subpass_dependencies[] {
-        {.srcSubpass = VK_SUBPASS_EXTERNAL,
-         .dstSubpass = 0,
-         .srcStageMask = vk::PipelineStageFlagBits::eFragmentShader,
-         .dstStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput,
-         .srcAccessMask = vk::AccessFlagBits::eShaderRead,
-         .dstAccessMask = vk::AccessFlagBits::eColorAttachmentWrite,
-         .dependencyFlags = vk::DependencyFlagBits::eByRegion},
-        {.srcSubpass = 0,
-         .dstSubpass = VK_SUBPASS_EXTERNAL,
-         .srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput,
-         .dstStageMask = vk::PipelineStageFlagBits::eFragmentShader,
-         .srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite,
-         .dstAccessMask = vk::AccessFlagBits::eShaderRead,
-         .dependencyFlags = vk::DependencyFlagBits::eByRegion}};
+[[nodiscard]] vk::raii::DescriptorSetLayout
+create_descriptor_set_layout(const vk::raii::Device &device,
+                             std::span<const Descriptor_binding> bindings)
+{
+    std::vector<vk::DescriptorSetLayoutBinding> layout_bindings;
+    layout_bindings.reserve(bindings.size());
+    for (const auto &binding : bindings)
+    {
+        layout_bindings.push_back(
+            {.binding = binding.binding,
+             .descriptorType = static_cast<vk::DescriptorType>(binding.type),
+             .descriptorCount = binding.count,
+             .stageFlags = shader_stage_flags(binding.stages)});
+    }
 
-    const vk::RenderPassCreateInfo create_info {
-        .attachmentCount = 1,
-        .pAttachments = &color_attachment_description,
-        .subpassCount = 1,
-        .pSubpasses = &subpass_description,
-        .dependencyCount = std::size(subpass_dependencies),
-        .pDependencies = subpass_dependencies};
+    const vk::DescriptorSetLayoutCreateInfo create_info {
+        .bindingCount = static_cast<std::uint32_t>(layout_bindings.size()),
+        .pBindings = layout_bindings.data()};
 
     return {device, create_info};
 }
 
-[[nodiscard]] vk::raii::DescriptorSetLayout
-create_offscreen_descriptor_set_layout(const vk::raii::Device &device)
+[[nodiscard]] vk::raii::PipelineLayout
+create_pipeline_layout(const vk::raii::Device &device,
+                       std::span<const vk::DescriptorSetLayout> set_layouts,
+                       const std::optional<Push_constant_range> &push_constants)
 {
-    constexpr vk::DescriptorSetLayoutBinding sampler_layout_binding {
-        .binding = 0,
-        .descriptorType = vk::DescriptorType::eCombinedImageSampler,
-        .descriptorCount = 1,
-        .stageFlags = vk::ShaderStageFlagBits::eFragment};
+    vk::PushConstantRange push_constant_range {};
+    if (push_constants.has_value())
+    {
+        push_constant_range = {
+            .stageFlags = shader_stage_flags(push_constants->stages),
+            .offset = push_constants->offset,
+            .size = push_constants->size};
+    }
 
-    const vk::DescriptorSetLayoutCreateInfo create_info {
-        .bindingCount = 1, .pBindings = &sampler_layout_binding};
+    const vk::PipelineLayoutCreateInfo create_info {
+        .setLayoutCount = static_cast<std::uint32_t>(set_layouts.size()),
+        .pSetLayouts = set_layouts.data(),
+        .pushConstantRangeCount = push_constants.has_value() ? 1u : 0u,
+        .pPushConstantRanges = &push_constant_range};
 
     return {device, create_info};
 }
 
-[[nodiscard]] vk::raii::DescriptorSetLayout
-create_descriptor_set_layout(const vk::raii::Device &device)
+// Returns true if the data was created by the same driver for the same device,
+// otherwise the driver might not be able to use it
+[[nodiscard]] bool
+is_pipeline_cache_compatible(const vk::raii::PhysicalDevice &physical_device,
+                             std::span<const std::uint8_t> data)
 {
-    constexpr vk::DescriptorSetLayoutBinding sampler_layout_binding {
-        .binding = 0,
-        .descriptorType = vk::DescriptorType::eCombinedImageSampler,
-        .descriptorCount = 1,
-        .stageFlags = vk::ShaderStageFlagBits::eFragment};
+    VkPipelineCacheHeaderVersionOne header;
+    if (data.size() < sizeof(header))
+    {
+        return false;
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
 
-    const vk::DescriptorSetLayoutCreateInfo create_info {
-        .bindingCount = 1, .pBindings = &sampler_layout_binding};
+    const auto properties = physical_device.getProperties();
 
-    return {device, create_info};
+    return header.headerSize >= sizeof(header) &&
+           header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header.vendorID == properties.vendorID &&
+           header.deviceID == properties.deviceID &&
+           std::memcmp(header.pipelineCacheUUID,
+                       properties.pipelineCacheUUID.data(),
+                       VK_UUID_SIZE) == 0;
 }
 
-[[nodiscard]] vk::raii::PipelineLayout create_offscreen_pipeline_layout(
-    const vk::raii::Device &device,
-    const vk::raii::DescriptorSetLayout &descriptor_set_layout)
+[[nodiscard]] vk::raii::PipelineCache
+create_pipeline_cache(const vk::raii::Device &device,
+                      const vk::raii::PhysicalDevice &physical_device)
 {
-    const vk::PushConstantRange push_constant_range {
-        .stageFlags = vk::ShaderStageFlagBits::eFragment,
-        .offset = 0,
-        .size = sizeof(Push_constants),
-    };
+    vk::PipelineCacheCreateInfo create_info {};
 
-    const vk::PipelineLayoutCreateInfo create_info {
-        .setLayoutCount = 1,
-        .pSetLayouts = &*descriptor_set_layout,
-        .pushConstantRangeCount = 1,
-        .pPushConstantRanges = &push_constant_range};
+    File_view initial_data;
+    if (std::filesystem::exists(g_pipeline_cache_path))
+    {
+        initial_data = open_file_view(g_pipeline_cache_path);
+    }
+
+    if (!initial_data.empty() &&
+        is_pipeline_cache_compatible(physical_device, initial_data.data()))
+    {
+        create_info.initialDataSize = initial_data.size();
+        create_info.pInitialData = initial_data.data().data();
+    }
 
     return {device, create_info};
 }
 
-[[nodiscard]] vk::raii::PipelineLayout create_pipeline_layout(
-    const vk::raii::Device &device,
-    const vk::raii::DescriptorSetLayout &descriptor_set_layout)
+void save_pipeline_cache(const vk::raii::PipelineCache &pipeline_cache)
 {
-    const vk::PipelineLayoutCreateInfo create_info {
-        .setLayoutCount = 1, .pSetLayouts = &*descriptor_set_layout};
+    const auto data = pipeline_cache.getData();
+    write_file_atomically(g_pipeline_cache_path, {data});
+}
 
-    return {device, create_info};
+template <typename F>
+[[nodiscard]] auto timed(std::chrono::duration<double, std::milli> &total,
+                         F &&f)
+{
+    const auto start = std::chrono::steady_clock::now();
+    auto result = f();
+    total += std::chrono::steady_clock::now() - start;
+    return result;
 }
 
 [[nodiscard]] vk::raii::ShaderModule
 create_shader_module(const vk::raii::Device &device,
-                     const std::vector<std::uint8_t> &shader_code)
+                     std::span<const std::uint32_t> shader_code)
 {
     const vk::ShaderModuleCreateInfo create_info {
-        .codeSize = shader_code.size(),
-        .pCode = reinterpret_cast<const std::uint32_t *>(shader_code.data())};
+        .codeSize = shader_code.size_bytes(), .pCode = shader_code.data()};
 
     return {device, create_info};
 }
 
-[[nodiscard]] vk::raii::Pipeline
-create_pipeline(const vk::raii::Device &device,
-                const char *vertex_shader_path,
-                const char *fragment_shader_path,
-                vk::Offset2D viewport_offset,
-                vk::Extent2D viewport_extent,
-                vk::Extent2D framebuffer_extent,
-                vk::PipelineLayout pipeline_layout,
-                vk::RenderPass render_pass)
+struct Shader_program_files
+{
+    const char *vertex_shader;
+    const char *fragment_shader;
+};
+
+// Indexed by Shader_program
+constexpr Shader_program_files g_shader_programs[g_shader_program_count] {
+    {g_offscreen_vertex_shader, g_offscreen_fragment_shader},
+    {g_final_vertex_shader, g_final_fragment_shader}};
+
+// Indexed by Shader_program. Drawn with until the requested variant is built.
+constexpr Pipeline_state g_default_pipeline_states[g_shader_program_count] {
+    {.program = Shader_program::offscreen,
+     .blend_mode = Blend_mode::opaque,
+     .features = shader_feature_cursor_highlight},
+    {.program = Shader_program::final,
+     .blend_mode = Blend_mode::opaque,
+     .features = 0}};
+
+[[nodiscard]] vk::Format vertex_input_format(const Vertex_input &input)
 {
-    const auto vertex_shader_code = load_binary_file(vertex_shader_path);
-    if (vertex_shader_code.empty())
+    // Indexed by Scalar_type, then by component count - 1
+    constexpr vk::Format formats[][4] {
+        {vk::Format::eR32Sfloat,
+         vk::Format::eR32G32Sfloat,
+         vk::Format::eR32G32B32Sfloat,
+         vk::Format::eR32G32B32A32Sfloat},
+        {vk::Format::eR32Sint,
+         vk::Format::eR32G32Sint,
+         vk::Format::eR32G32B32Sint,
+         vk::Format::eR32G32B32A32Sint},
+        {vk::Format::eR32Uint,
+         vk::Format::eR32G32Uint,
+         vk::Format::eR32G32B32Uint,
+         vk::Format::eR32G32B32A32Uint}};
+
+    if (input.components < 1 || input.components > 4)
     {
-        throw std::runtime_error(std::string("Failed to load shader \"") +
-                                 std::string(vertex_shader_path) +
-                                 std::string("\""));
+        throw std::runtime_error("Unsupported vertex input component count");
     }
-    const auto fragment_shader_code = load_binary_file(fragment_shader_path);
-    if (fragment_shader_code.empty())
+
+    return formats[static_cast<std::size_t>(input.type)]
+                  [input.components - 1];
+}
+
+// Vertex inputs are read from a single buffer, tightly packed in location
+// order like in the Vertex struct
+[[nodiscard]] std::uint32_t vertex_stride(const Shader_reflection &reflection)
+{
+    std::uint32_t stride {};
+    for (const auto &input : reflection.vertex_inputs)
     {
-        throw std::runtime_error(std::string("Failed to load shader \"") +
-                                 std::string(fragment_shader_path) +
-                                 std::string("\""));
+        stride += vertex_input_size(input);
     }
+    return stride;
+}
 
-    const auto vertex_shader_module =
-        create_shader_module(device, vertex_shader_code);
-    const auto fragment_shader_module =
-        create_shader_module(device, fragment_shader_code);
+[[nodiscard]] std::vector<vk::VertexInputAttributeDescription>
+vertex_input_attribute_descriptions(const Shader_reflection &reflection)
+{
+    std::vector<vk::VertexInputAttributeDescription> descriptions;
+    std::uint32_t offset {};
+    for (const auto &input : reflection.vertex_inputs)
+    {
+        descriptions.push_back({.location = input.location,
+                                .binding = 0,
+                                .format = vertex_input_format(input),
+                                .offset = offset});
+        offset += vertex_input_size(input);
+    }
+    return descriptions;
+}
 
-    const vk::PipelineShaderStageCreateInfo vertex_shader_stage_create_info {
-        .stage = vk::ShaderStageFlagBits::eVertex,
-        .module = *vertex_shader_module,
-        .pName = "main"};
+[[nodiscard]] Shader_modules
+create_shader_modules(const vk::raii::Device &device,
+                      Shader_program program,
+                      Shader_code (*load)(std::string_view name))
+{
+    const auto &files = g_shader_programs[static_cast<std::size_t>(program)];
 
-    const vk::PipelineShaderStageCreateInfo fragment_shader_stage_create_info {
-        .stage = vk::ShaderStageFlagBits::eFragment,
-        .module = *fragment_shader_module,
-        .pName = "main"};
+    const auto vertex_shader = load(files.vertex_shader);
+    const auto fragment_shader = load(files.fragment_shader);
+    auto reflection = merge_reflections(reflect_shader(vertex_shader.code),
+                                        reflect_shader(fragment_shader.code));
 
-    const vk::PipelineShaderStageCreateInfo shader_stage_create_infos[] {
-        vertex_shader_stage_create_info, fragment_shader_stage_create_info};
+    // The CPU side of the interface is still written by hand
+    if (!reflection.vertex_inputs.empty() &&
+        vertex_stride(reflection) != sizeof(Vertex))
+    {
+        throw std::runtime_error(std::string("The vertex inputs of \"") +
+                                 files.vertex_shader +
+                                 "\" do not match the Vertex struct");
+    }
+    if (reflection.push_constants.has_value() &&
+        reflection.push_constants->offset + reflection.push_constants->size >
+            sizeof(Push_constants))
+    {
+        throw std::runtime_error(std::string("The push constants of \"") +
+                                 files.fragment_shader +
+                                 "\" do not match the Push_constants struct");
+    }
 
-    const vk::PipelineVertexInputStateCreateInfo
-        vertex_input_state_create_info {};
-
-    const vk::PipelineInputAssemblyStateCreateInfo
-        input_assembly_state_create_info {
-            .topology = vk::PrimitiveTopology::eTriangleStrip,
-            .primitiveRestartEnable = VK_FALSE};
-
-    const vk::Viewport viewport {
-        .x = static_cast<float>(viewport_offset.x),
-        .y = static_cast<float>(viewport_offset.y),
-        .width = static_cast<float>(viewport_extent.width),
-        .height = static_cast<float>(viewport_extent.height),
-        .minDepth = 0.0f,
-        .maxDepth = 1.0f};
-
-    const vk::Rect2D scissor {.offset = {0, 0}, .extent = framebuffer_extent};
-
-    const vk::PipelineViewportStateCreateInfo viewport_state_create_info {
-        .viewportCount = 1,
-        .pViewports = &viewport,
-        .scissorCount = 1,
-        .pScissors = &scissor};
-
-    constexpr vk::PipelineRasterizationStateCreateInfo
-        rasterization_state_create_info {
-            .depthClampEnable = VK_FALSE,
-            .rasterizerDiscardEnable = VK_FALSE,
-            .polygonMode = vk::PolygonMode::eFill,
-            .cullMode = vk::CullModeFlagBits::eBack,
-            .frontFace = vk::FrontFace::eCounterClockwise,
-            .depthBiasEnable = VK_FALSE,
-            .lineWidth = 1.0f};
-
-    constexpr vk::PipelineMultisampleStateCreateInfo
-        multisample_state_create_info {.rasterizationSamples =
-                                           vk::SampleCountFlagBits::e1,
-                                       .sampleShadingEnable = VK_FALSE};
-
-    constexpr vk::PipelineColorBlendAttachmentState
-        color_blend_attachment_state {.blendEnable = VK_FALSE,
-                                      .colorWriteMask =
-                                          vk::ColorComponentFlagBits::eR |
-                                          vk::ColorComponentFlagBits::eG |
-                                          vk::ColorComponentFlagBits::eB |
-                                          vk::ColorComponentFlagBits::eA};
+    return {.vertex = create_shader_module(device, vertex_shader.code),
+            .fragment = create_shader_module(device, fragment_shader.code),
+            .reflection = std::move(reflection)};
+}
 
-    const vk::PipelineColorBlendStateCreateInfo color_blend_state_create_info {
-        .logicOpEnable = VK_FALSE,
-        .logicOp = vk::LogicOp::eCopy,
-        .attachmentCount = 1,
-        .pAttachments = &color_blend_attachment_state,
-        .blendConstants = {{0.0f, 0.0f, 0.0f, 0.0f}}};
+[[nodiscard]] vk::PipelineColorBlendAttachmentState
+color_blend_attachment_state(Blend_mode blend_mode)
+{
+    constexpr auto color_write_mask =
+        vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
+        vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
 
-    const vk::GraphicsPipelineCreateInfo pipeline_create_info {
-        .stageCount = 2,
-        .pStages = shader_stage_create_infos,
-        .pVertexInputState = &vertex_input_state_create_info,
-        .pInputAssemblyState = &input_assembly_state_create_info,
-        .pViewportState = &viewport_state_create_info,
-        .pRasterizationState = &rasterization_state_create_info,
-        .pMultisampleState = &multisample_state_create_info,
-        .pColorBlendState = &color_blend_state_create_info,
-        .layout = pipeline_layout,
-        .renderPass = render_pass,
-        .subpass = 0};
+    switch (blend_mode)
+    {
+    case Blend_mode::alpha:
+        return {.blendEnable = VK_TRUE,
+                .srcColorBlendFactor = vk::BlendFactor::eSrcAlpha,
+                .dstColorBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha,
+                .colorBlendOp = vk::BlendOp::eAdd,
+                .srcAlphaBlendFactor = vk::BlendFactor::eOne,
+                .dstAlphaBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha,
+                .alphaBlendOp = vk::BlendOp::eAdd,
+                .colorWriteMask = color_write_mask};
+    case Blend_mode::additive:
+        return {.blendEnable = VK_TRUE,
+                .srcColorBlendFactor = vk::BlendFactor::eSrcAlpha,
+                .dstColorBlendFactor = vk::BlendFactor::eOne,
+                .colorBlendOp = vk::BlendOp::eAdd,
+                .srcAlphaBlendFactor = vk::BlendFactor::eOne,
+                .dstAlphaBlendFactor = vk::BlendFactor::eOne,
+                .alphaBlendOp = vk::BlendOp::eAdd,
+                .colorWriteMask = color_write_mask};
+    case Blend_mode::opaque:
+        break;
+    }
 
-    return {device, VK_NULL_HANDLE, pipeline_create_info};
+    return {.blendEnable = VK_FALSE, .colorWriteMask = color_write_mask};
 }
 
-[[nodiscard]] vk::raii::Pipeline create_offscreen_pipeline(
-    const vk::raii::Device &device,
-    const char *vertex_shader_path,
-    const char *fragment_shader_path,
-    const vk::Extent2D &extent,
-    vk::PipelineLayout pipeline_layout,
-    vk::RenderPass render_pass,
-    const vk::VertexInputBindingDescription &vertex_binding_description,
-    const vk::VertexInputAttributeDescription *vertex_attribute_descriptions,
-    std::uint32_t num_vertex_attribute_descriptions)
+[[nodiscard]] vk::raii::Pipeline
+create_pipeline(const vk::raii::Device &device,
+                const vk::raii::PipelineCache &pipeline_cache,
+                const Pipeline_state &state,
+                const Shader_modules &modules,
+                vk::PipelineLayout pipeline_layout,
+                const Pipeline_target &target)
 {
-    const auto vertex_shader_code = load_binary_file(vertex_shader_path);
-    if (vertex_shader_code.empty())
+    // Feature bit i is the specialization constant with constant_id i.
+    // Constants that a shader does not declare are ignored.
+    std::array<vk::SpecializationMapEntry, g_shader_feature_count>
+        specialization_map_entries {};
+    std::array<vk::Bool32, g_shader_feature_count> specialization_data {};
+    for (std::uint32_t i {}; i < g_shader_feature_count; ++i)
     {
-        throw std::runtime_error(std::string("Failed to load shader \"") +
-                                 std::string(vertex_shader_path) +
-                                 std::string("\""));
-    }
-    const auto fragment_shader_code = load_binary_file(fragment_shader_path);
-    if (fragment_shader_code.empty())
-    {
-        throw std::runtime_error(std::string("Failed to load shader \"") +
-                                 std::string(fragment_shader_path) +
-                                 std::string("\""));
+        specialization_map_entries[i] = {
+            .constantID = i,
+            .offset = i * static_cast<std::uint32_t>(sizeof(vk::Bool32)),
+            .size = sizeof(vk::Bool32)};
+        specialization_data[i] = (state.features >> i) & 1u;
     }
 
-    const auto vertex_shader_module =
-        create_shader_module(device, vertex_shader_code);
-    const auto fragment_shader_module =
-        create_shader_module(device, fragment_shader_code);
+    const vk::SpecializationInfo specialization_info {
+        .mapEntryCount = g_shader_feature_count,
+        .pMapEntries = specialization_map_entries.data(),
+        .dataSize = sizeof(specialization_data),
+        .pData = specialization_data.data()};
 
     const vk::PipelineShaderStageCreateInfo vertex_shader_stage_create_info {
         .stage = vk::ShaderStageFlagBits::eVertex,
-        .module = *vertex_shader_module,
-        .pName = "main"};
+        .module = *modules.vertex,
+        .pName = "main",
+        .pSpecializationInfo = &specialization_info};
 
     const vk::PipelineShaderStageCreateInfo fragment_shader_stage_create_info {
         .stage = vk::ShaderStageFlagBits::eFragment,
-        .module = *fragment_shader_module,
-        .pName = "main"};
+        .module = *modules.fragment,
+        .pName = "main",
+        .pSpecializationInfo = &specialization_info};
 
     const vk::PipelineShaderStageCreateInfo shader_stage_create_infos[] {
         vertex_shader_stage_create_info, fragment_shader_stage_create_info};
 
+    const auto vertex_attribute_descriptions =
+        vertex_input_attribute_descriptions(modules.reflection);
+
+    const vk::VertexInputBindingDescription vertex_binding_description {
+        .binding = 0,
+        .stride = vertex_stride(modules.reflection),
+        .inputRate = vk::VertexInputRate::eVertex};
+
     const vk::PipelineVertexInputStateCreateInfo
         vertex_input_state_create_info {
-            .vertexBindingDescriptionCount = 1,
+            .vertexBindingDescriptionCount =
+                vertex_attribute_descriptions.empty() ? 0u : 1u,
             .pVertexBindingDescriptions = &vertex_binding_description,
-            .vertexAttributeDescriptionCount =
-                num_vertex_attribute_descriptions,
-            .pVertexAttributeDescriptions = vertex_attribute_descriptions};
+            .vertexAttributeDescriptionCount = static_cast<std::uint32_t>(
+                vertex_attribute_descriptions.size()),
+            .pVertexAttributeDescriptions =
+                vertex_attribute_descriptions.data()};
 
+    // The offscreen pass draws indexed quads, the final pass a fullscreen
+    // triangle strip generated in the vertex shader
     const vk::PipelineInputAssemblyStateCreateInfo
         input_assembly_state_create_info {
-            .topology = vk::PrimitiveTopology::eTriangleList,
+            .topology = state.program == Shader_program::offscreen
+                            ? vk::PrimitiveTopology::eTriangleList
+                            : vk::PrimitiveTopology::eTriangleStrip,
             .primitiveRestartEnable = VK_FALSE};
 
-    const vk::Viewport viewport {.x = 0.0f,
-                                 .y = 0.0f,
-                                 .width = static_cast<float>(extent.width),
-                                 .height = static_cast<float>(extent.height),
-                                 .minDepth = 0.0f,
-                                 .maxDepth = 1.0f};
+    // Set in record_command_buffer, so that resizing does not require a new
+    // pipeline
+    constexpr vk::PipelineViewportStateCreateInfo viewport_state_create_info {
+        .viewportCount = 1, .scissorCount = 1};
 
-    const vk::Rect2D scissor {.offset = {0, 0}, .extent = extent};
+    constexpr vk::DynamicState dynamic_states[] {vk::DynamicState::eViewport,
+                                                 vk::DynamicState::eScissor};
 
-    const vk::PipelineViewportStateCreateInfo viewport_state_create_info {
-        .viewportCount = 1,
-        .pViewports = &viewport,
-        .scissorCount = 1,
-        .pScissors = &scissor};
+    const vk::PipelineDynamicStateCreateInfo dynamic_state_create_info {
+        .dynamicStateCount = std::size(dynamic_states),
+        .pDynamicStates = dynamic_states};
 
     constexpr vk::PipelineRasterizationStateCreateInfo
         rasterization_state_create_info {
@@ -1078,22 +1528,23 @@ create_pipeline(const vk::raii::Device &device,
                                            vk::SampleCountFlagBits::e1,
                                        .sampleShadingEnable = VK_FALSE};
 
-    constexpr vk::PipelineColorBlendAttachmentState
-        color_blend_attachment_state {.blendEnable = VK_FALSE,
-                                      .colorWriteMask =
-                                          vk::ColorComponentFlagBits::eR |
-                                          vk::ColorComponentFlagBits::eG |
-                                          vk::ColorComponentFlagBits::eB |
-                                          vk::ColorComponentFlagBits::eA};
+    const auto color_blend_attachment =
+        color_blend_attachment_state(state.blend_mode);
 
     const vk::PipelineColorBlendStateCreateInfo color_blend_state_create_info {
         .logicOpEnable = VK_FALSE,
         .logicOp = vk::LogicOp::eCopy,
         .attachmentCount = 1,
-        .pAttachments = &color_blend_attachment_state,
+        .pAttachments = &color_blend_attachment,
         .blendConstants = {{0.0f, 0.0f, 0.0f, 0.0f}}};
 
+    // Only used with dynamic rendering
+    const vk::PipelineRenderingCreateInfo rendering_create_info {
+        .colorAttachmentCount = 1,
+        .pColorAttachmentFormats = &target.color_attachment_format};
+
     const vk::GraphicsPipelineCreateInfo pipeline_create_info {
+        .pNext = target.render_pass ? nullptr : &rendering_create_info,
         .stageCount = 2,
         .pStages = shader_stage_create_infos,
         .pVertexInputState = &vertex_input_state_create_info,
@@ -1102,11 +1553,12 @@ create_pipeline(const vk::raii::Device &device,
         .pRasterizationState = &rasterization_state_create_info,
         .pMultisampleState = &multisample_state_create_info,
         .pColorBlendState = &color_blend_state_create_info,
+        .pDynamicState = &dynamic_state_create_info,
         .layout = pipeline_layout,
-        .renderPass = render_pass,
+        .renderPass = target.render_pass,
         .subpass = 0};
 
-    return {device, VK_NULL_HANDLE, pipeline_create_info};
+    return {device, pipeline_cache, pipeline_create_info};
 }
 
 [[nodiscard]] vk::raii::Framebuffer
@@ -1161,27 +1613,204 @@ create_framebuffers(const vk::raii::Device &device,
     return {device, create_info};
 }
 
-[[nodiscard]] Vulkan_image
-create_texture_image(const vk::raii::Device &device,
-                     const vk::raii::PhysicalDevice &physical_device,
-                     const vk::raii::CommandPool &command_pool,
-                     const vk::raii::Queue &graphics_queue,
-                     const char *texture_path)
+struct Cached_texture_header
+{
+    std::uint32_t magic;
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t channels;
+};
+
+constexpr std::uint32_t g_cached_texture_magic {0x41424752}; // "RGBA"
+constexpr auto g_cached_texture_kind = "rgba";
+constexpr auto g_cached_placeholder_kind = "placeholder.rgba";
+
+[[nodiscard]] std::optional<Texture_data>
+load_cached_texture_data(const Asset_registry &asset_registry,
+                         Asset_hash hash,
+                         std::string_view kind)
+{
+    const auto file = asset_registry.load_cached(hash, kind);
+    if (file.size() < sizeof(Cached_texture_header))
+    {
+        return std::nullopt;
+    }
+
+    Cached_texture_header header;
+    std::memcpy(&header, file.data().data(), sizeof(header));
+    const auto pixels = file.data().subspan(sizeof(header));
+    if (header.magic != g_cached_texture_magic || header.channels != 4 ||
+        pixels.size() != std::size_t {header.width} * header.height * 4)
+    {
+        return std::nullopt;
+    }
+
+    return Texture_data {
+        .pixels = std::vector<std::uint8_t>(pixels.begin(), pixels.end()),
+        .width = header.width,
+        .height = header.height};
+}
+
+void store_cached_texture_data(const Asset_registry &asset_registry,
+                               Asset_hash hash,
+                               std::string_view kind,
+                               const Texture_data &texture)
+{
+    const Cached_texture_header header {.magic = g_cached_texture_magic,
+                                        .width = texture.width,
+                                        .height = texture.height,
+                                        .channels = 4};
+
+    asset_registry.store_cached(
+        hash,
+        kind,
+        {std::span {reinterpret_cast<const std::uint8_t *>(&header),
+                    sizeof(header)},
+         texture.pixels});
+}
+
+[[nodiscard]] File_view open_texture_file(const char *texture_path)
+{
+    // The file may be rewritten by an editor while hot reload reads it
+    auto file = open_file_view(texture_path, File_access::read);
+    if (file.empty())
+    {
+        throw std::runtime_error(
+            std::string("Failed to load texture image \"") +
+            std::string(texture_path) + std::string("\""));
+    }
+    return file;
+}
+
+// Decodes the file, whose content has the given hash, unless a decoded copy of
+// the same content is already in the asset cache. Safe to call from any
+// thread.
+[[nodiscard]] Texture_data
+load_texture_data(const Asset_registry &asset_registry,
+                  const File_view &file,
+                  Asset_hash hash,
+                  const char *texture_path)
 {
+    if (auto cached = load_cached_texture_data(
+            asset_registry, hash, g_cached_texture_kind))
+    {
+        return std::move(*cached);
+    }
+
     int width {};
     int height {};
     int channels {};
     auto *const pixels =
-        stbi_load(texture_path, &width, &height, &channels, STBI_rgb_alpha);
+        stbi_load_from_memory(file.data().data(),
+                              static_cast<int>(file.size()),
+                              &width,
+                              &height,
+                              &channels,
+                              STBI_rgb_alpha);
     if (!pixels)
     {
         throw std::runtime_error(
             std::string("Failed to load texture image \"") +
             std::string(texture_path) + std::string("\""));
     }
-    const auto image_size {static_cast<vk::DeviceSize>(width * height * 4)};
 
-    const auto staging_buffer =
+    Texture_data texture {
+        .pixels = std::vector<std::uint8_t>(
+            pixels, pixels + static_cast<std::size_t>(width * height * 4)),
+        .width = static_cast<std::uint32_t>(width),
+        .height = static_cast<std::uint32_t>(height)};
+
+    stbi_image_free(pixels);
+
+    store_cached_texture_data(
+        asset_registry, hash, g_cached_texture_kind, texture);
+
+    return texture;
+}
+
+// Box-filters the texture down so that its largest side is at most
+// g_placeholder_max_size texels
+[[nodiscard]] Texture_data
+create_placeholder_texture_data(const Texture_data &texture)
+{
+    const auto factor = std::max(
+        (std::max(texture.width, texture.height) + g_placeholder_max_size - 1) /
+            g_placeholder_max_size,
+        1u);
+
+    Texture_data placeholder {.pixels = {},
+                              .width = std::max(texture.width / factor, 1u),
+                              .height = std::max(texture.height / factor, 1u)};
+    placeholder.pixels.resize(placeholder.width * placeholder.height * 4);
+
+    for (std::uint32_t y {}; y < placeholder.height; ++y)
+    {
+        for (std::uint32_t x {}; x < placeholder.width; ++x)
+        {
+            std::uint32_t sum[4] {};
+            std::uint32_t count {};
+            for (auto sy = y * factor;
+                 sy < std::min((y + 1) * factor, texture.height);
+                 ++sy)
+            {
+                for (auto sx = x * factor;
+                     sx < std::min((x + 1) * factor, texture.width);
+                     ++sx)
+                {
+                    for (std::uint32_t c {}; c < 4; ++c)
+                    {
+                        sum[c] +=
+                            texture.pixels[(sy * texture.width + sx) * 4 + c];
+                    }
+                    ++count;
+                }
+            }
+            for (std::uint32_t c {}; c < 4; ++c)
+            {
+                placeholder.pixels[(y * placeholder.width + x) * 4 + c] =
+                    static_cast<std::uint8_t>(sum[c] / count);
+            }
+        }
+    }
+
+    return placeholder;
+}
+
+// The placeholder is cached on its own, so that registering a texture only
+// decodes the full image the first time its content is seen. Safe to call from
+// any thread.
+[[nodiscard]] Texture_data
+load_placeholder_texture_data(const Asset_registry &asset_registry,
+                              const File_view &file,
+                              Asset_hash hash,
+                              const char *texture_path)
+{
+    if (auto cached = load_cached_texture_data(
+            asset_registry, hash, g_cached_placeholder_kind))
+    {
+        return std::move(*cached);
+    }
+
+    auto placeholder = create_placeholder_texture_data(
+        load_texture_data(asset_registry, file, hash, texture_path));
+    store_cached_texture_data(
+        asset_registry, hash, g_cached_placeholder_kind, placeholder);
+    return placeholder;
+}
+
+// Does not wait for the upload to complete. The image can be used by
+// commands submitted later to the same queue.
+[[nodiscard]] Texture_upload
+upload_texture_image(const vk::raii::Device &device,
+                     const vk::raii::PhysicalDevice &physical_device,
+                     const vk::raii::CommandPool &command_pool,
+                     const vk::raii::Queue &graphics_queue,
+                     const Texture_data &texture)
+{
+    const auto image_size {
+        static_cast<vk::DeviceSize>(texture.width * texture.height * 4)};
+
+    auto staging_buffer =
         create_buffer(device,
                       physical_device,
                       image_size,
@@ -1190,21 +1819,20 @@ create_texture_image(const vk::raii::Device &device,
                           vk::MemoryPropertyFlagBits::eHostCoherent);
 
     auto *const data = staging_buffer.memory.mapMemory(0, image_size);
-    std::memcpy(data, pixels, static_cast<std::size_t>(image_size));
+    std::memcpy(
+        data, texture.pixels.data(), static_cast<std::size_t>(image_size));
     staging_buffer.memory.unmapMemory();
 
-    stbi_image_free(pixels);
-
     auto image = create_image(device,
                               physical_device,
-                              static_cast<std::uint32_t>(width),
-                              static_cast<std::uint32_t>(height),
+                              texture.width,
+                              texture.height,
                               vk::Format::eR8G8B8A8Srgb,
                               vk::ImageUsageFlagBits::eTransferDst |
                                   vk::ImageUsageFlagBits::eSampled,
                               vk::MemoryPropertyFlagBits::eDeviceLocal);
 
-    const auto command_buffer =
+    auto command_buffer =
         begin_one_time_submit_command_buffer(device, command_pool);
 
     command_transition_image_layout(command_buffer,
@@ -1219,8 +1847,8 @@ create_texture_image(const vk::raii::Device &device,
     command_copy_buffer_to_image(command_buffer,
                                  *staging_buffer.buffer,
                                  *image.image,
-                                 static_cast<std::uint32_t>(width),
-                                 static_cast<std::uint32_t>(height));
+                                 texture.width,
+                                 texture.height);
 
     command_transition_image_layout(command_buffer,
                                     *image.image,
@@ -1231,9 +1859,11 @@ create_texture_image(const vk::raii::Device &device,
                                     vk::AccessFlagBits::eTransferWrite,
                                     vk::AccessFlagBits::eShaderRead);
 
-    end_one_time_submit_command_buffer(command_buffer, graphics_queue);
+    submit_one_time_submit_command_buffer(command_buffer, graphics_queue);
 
-    return image;
+    return {.image = std::move(image),
+            .upload = {.command_buffer = std::move(command_buffer),
+                       .staging_buffer = std::move(staging_buffer)}};
 }
 
 void write_image_to_png(const vk::raii::Device &device,
@@ -1300,17 +1930,45 @@ void write_image_to_png(const vk::raii::Device &device,
     staging_buffer.memory.unmapMemory();
 }
 
-[[nodiscard]] vk::raii::DescriptorPool
-create_descriptor_pool(const vk::raii::Device &device)
+// Sized for the sets that are allocated from it: set 0 of each program, once
+// per frame in flight
+[[nodiscard]] vk::raii::DescriptorPool create_descriptor_pool(
+    const vk::raii::Device &device,
+    std::span<const std::shared_ptr<const Shader_modules>> programs)
 {
-    constexpr vk::DescriptorPoolSize pool_sizes[] {
-        {vk::DescriptorType::eCombinedImageSampler,
-         1 + g_max_frames_in_flight}};
+    std::vector<vk::DescriptorPoolSize> pool_sizes;
+    for (const auto &program : programs)
+    {
+        for (const auto &binding : program->reflection.bindings)
+        {
+            if (binding.set != 0)
+            {
+                continue;
+            }
+
+            const auto type = static_cast<vk::DescriptorType>(binding.type);
+            const auto count = binding.count * g_max_frames_in_flight;
+            const auto it = std::find_if(pool_sizes.begin(),
+                                         pool_sizes.end(),
+                                         [&](const vk::DescriptorPoolSize &size)
+                                         { return size.type == type; });
+            if (it == pool_sizes.end())
+            {
+                pool_sizes.push_back({.type = type, .descriptorCount = count});
+            }
+            else
+            {
+                it->descriptorCount += count;
+            }
+        }
+    }
+
     const vk::DescriptorPoolCreateInfo create_info {
         .flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet,
-        .maxSets = 1 + g_max_frames_in_flight,
-        .poolSizeCount = static_cast<std::uint32_t>(std::size(pool_sizes)),
-        .pPoolSizes = pool_sizes};
+        .maxSets = static_cast<std::uint32_t>(programs.size()) *
+                   g_max_frames_in_flight,
+        .poolSizeCount = static_cast<std::uint32_t>(pool_sizes.size()),
+        .pPoolSizes = pool_sizes.data()};
 
     return {device, create_info};
 }
@@ -1379,21 +2037,11 @@ create_descriptor_sets(const vk::raii::Device &device,
     return descriptor_sets;
 }
 
-[[nodiscard]] vk::DescriptorSet
-create_offscreen_descriptor_set(const vk::raii::Device &device,
-                                vk::DescriptorSetLayout descriptor_set_layout,
-                                vk::DescriptorPool descriptor_pool,
-                                vk::Sampler sampler,
-                                vk::ImageView texture_image_view)
+void update_descriptor_set(const vk::raii::Device &device,
+                           vk::DescriptorSet descriptor_set,
+                           vk::Sampler sampler,
+                           vk::ImageView texture_image_view)
 {
-    const vk::DescriptorSetAllocateInfo allocate_info {
-        .descriptorPool = descriptor_pool,
-        .descriptorSetCount = 1,
-        .pSetLayouts = &descriptor_set_layout};
-
-    auto descriptor_set =
-        (*device).allocateDescriptorSets(allocate_info).front();
-
     const vk::DescriptorImageInfo image_info {
         .sampler = sampler,
         .imageView = texture_image_view,
@@ -1408,8 +2056,6 @@ create_offscreen_descriptor_set(const vk::raii::Device &device,
         .pImageInfo = &image_info};
 
     device.updateDescriptorSets({descriptor_write}, {});
-
-    return descriptor_set;
 }
 
 [[nodiscard]] Vulkan_buffer
@@ -1505,40 +2151,142 @@ create_draw_command_buffers(const vk::raii::Device &device,
     return {device, allocate_info};
 }
 
-[[nodiscard]] Vulkan_image create_offscreen_color_attachment(
-    const vk::raii::Device &device,
-    const vk::raii::PhysicalDevice &physical_device,
-    const vk::raii::CommandPool &command_pool,
-    const vk::raii::Queue &graphics_queue,
-    std::uint32_t width,
-    std::uint32_t height,
-    vk::Format format)
+[[nodiscard]] Frame_graph
+create_frame_graph(const vk::raii::Device &device,
+                   const vk::raii::PhysicalDevice &physical_device,
+                   std::uint32_t offscreen_width,
+                   std::uint32_t offscreen_height,
+                   vk::Format format,
+                   bool headless)
 {
-    auto image = create_image(device,
-                              physical_device,
-                              width,
-                              height,
-                              format,
-                              vk::ImageUsageFlagBits::eColorAttachment |
-                                  vk::ImageUsageFlagBits::eSampled,
-                              vk::MemoryPropertyFlagBits::eDeviceLocal);
+    // The images are created first, their memory requirements are needed to
+    // assign them to memory slots
+    std::vector<std::pair<Render_resource, vk::raii::Image>> unbound_images;
+    Render_graph graph;
 
-    const auto command_buffer =
-        begin_one_time_submit_command_buffer(device, command_pool);
+    const auto add_transient_image =
+        [&](std::string name, std::uint32_t width, std::uint32_t height)
+    {
+        auto image = create_unbound_image(device,
+                                          width,
+                                          height,
+                                          format,
+                                          vk::ImageUsageFlagBits::
+                                                  eColorAttachment |
+                                              vk::ImageUsageFlagBits::eSampled);
+        const auto memory_requirements = image.getMemoryRequirements();
+        const auto resource = graph.add_transient_image(
+            std::move(name),
+            {.size = memory_requirements.size,
+             .alignment = memory_requirements.alignment,
+             .memory_type_bits = memory_requirements.memoryTypeBits});
+        unbound_images.emplace_back(resource, std::move(image));
+        return resource;
+    };
 
-    command_transition_image_layout(
-        command_buffer,
-        *image.image,
-        vk::ImageLayout::eUndefined,
-        vk::ImageLayout::eColorAttachmentOptimal,
-        vk::PipelineStageFlagBits::eTopOfPipe,
-        vk::PipelineStageFlagBits::eColorAttachmentOutput,
-        {},
-        vk::AccessFlagBits::eColorAttachmentWrite);
+    const auto offscreen_color = add_transient_image(
+        "offscreen_color", offscreen_width, offscreen_height);
+    // Headless frames are left ready to be copied back
+    const auto swapchain_image = graph.import_image(
+        "swapchain_image",
+        Resource_usage::undefined,
+        headless ? Resource_usage::transfer_src : Resource_usage::present);
 
-    end_one_time_submit_command_buffer(command_buffer, graphics_queue);
+    const auto offscreen_pass = graph.add_pass("offscreen");
+    graph.write(
+        offscreen_pass, offscreen_color, Resource_usage::color_attachment);
+
+    const auto final_pass = graph.add_pass("final");
+    graph.read(final_pass, offscreen_color, Resource_usage::sampled);
+    graph.write(final_pass, swapchain_image, Resource_usage::color_attachment);
+
+    // Writes nothing the graph needs, it is given side effects while
+    // capturing
+    const auto capture_pass = graph.add_pass("capture");
+    graph.read(capture_pass, swapchain_image, Resource_usage::transfer_src);
+
+    auto compiled = graph.compile();
+
+    std::vector<vk::raii::DeviceMemory> memory;
+    memory.reserve(compiled.memory_slots.size());
+    for (const auto &slot : compiled.memory_slots)
+    {
+        const vk::MemoryAllocateInfo allocate_info {
+            .allocationSize = slot.size,
+            .memoryTypeIndex =
+                find_memory_type(physical_device,
+                                 slot.memory_type_bits,
+                                 vk::MemoryPropertyFlagBits::eDeviceLocal)};
+        memory.emplace_back(device, allocate_info);
+    }
+
+    std::vector<std::optional<Transient_image>> images(
+        compiled.resource_slots.size());
+    for (auto &[resource, image] : unbound_images)
+    {
+        // Used by culled passes only
+        const auto slot = compiled.resource_slots[resource];
+        if (!slot.has_value())
+        {
+            continue;
+        }
+
+        image.bindMemory(*memory[*slot], 0);
+        auto view = create_image_view(device, *image, format);
+        images[resource] = Transient_image {.image = std::move(image),
+                                            .view = std::move(view)};
+    }
+
+    return {.graph = std::move(graph),
+            .compiled = std::move(compiled),
+            .offscreen_pass = offscreen_pass,
+            .final_pass = final_pass,
+            .capture_pass = capture_pass,
+            .offscreen_color = offscreen_color,
+            .swapchain_image = swapchain_image,
+            .memory = std::move(memory),
+            .images = std::move(images)};
+}
+
+struct Usage_scope
+{
+    vk::PipelineStageFlags stage;
+    vk::AccessFlags access;
+    vk::ImageLayout layout;
+};
+
+[[nodiscard]] constexpr Usage_scope usage_scope(Resource_usage usage)
+{
+    switch (usage)
+    {
+    case Resource_usage::undefined:
+        return {.stage = vk::PipelineStageFlagBits::eTopOfPipe,
+                .access = {},
+                .layout = vk::ImageLayout::eUndefined};
+    case Resource_usage::color_attachment:
+        return {.stage = vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                .access = vk::AccessFlagBits::eColorAttachmentRead |
+                          vk::AccessFlagBits::eColorAttachmentWrite,
+                .layout = vk::ImageLayout::eColorAttachmentOptimal};
+    case Resource_usage::sampled:
+        return {.stage = vk::PipelineStageFlagBits::eFragmentShader,
+                .access = vk::AccessFlagBits::eShaderRead,
+                .layout = vk::ImageLayout::eShaderReadOnlyOptimal};
+    case Resource_usage::transfer_src:
+        return {.stage = vk::PipelineStageFlagBits::eTransfer,
+                .access = vk::AccessFlagBits::eTransferRead,
+                .layout = vk::ImageLayout::eTransferSrcOptimal};
+    case Resource_usage::transfer_dst:
+        return {.stage = vk::PipelineStageFlagBits::eTransfer,
+                .access = vk::AccessFlagBits::eTransferWrite,
+                .layout = vk::ImageLayout::eTransferDstOptimal};
+    case Resource_usage::present:
+        return {.stage = vk::PipelineStageFlagBits::eBottomOfPipe,
+                .access = {},
+                .layout = vk::ImageLayout::ePresentSrcKHR};
+    }
 
-    return image;
+    return {};
 }
 
 void check_vk_result(VkResult result)
@@ -1549,6 +2297,19 @@ void check_vk_result(VkResult result)
             vk::to_string(static_cast<vk::Result>(result)));
 }
 
+// For jobs whose result is no longer needed. Done jobs must still be waited
+// for before they are destroyed, see Job_system::wait.
+void wait_for_job(Job_system &job_system, Job_counter &counter)
+{
+    try
+    {
+        job_system.wait(counter);
+    }
+    catch (const std::exception &)
+    {
+    }
+}
+
 [[nodiscard]] constexpr std::uint32_t
 scaling_factor(std::uint32_t offscreen_width,
                std::uint32_t offscreen_height,
@@ -1589,14 +2350,116 @@ viewport_offset(std::uint32_t offscreen_width,
     return {offset_x, offset_y};
 }
 
+#ifdef ENABLE_DEBUG_UI
+// Plots the samples in milliseconds, with their statistics as the overlay
+void plot_timing_history(const char *label, const Timing_history &history)
+{
+    const auto stats = history.stats();
+    char overlay[64] {};
+    std::snprintf(overlay,
+                  sizeof(overlay),
+                  "min %.3f avg %.3f p99 %.3f ms",
+                  static_cast<double>(stats.min),
+                  static_cast<double>(stats.average),
+                  static_cast<double>(stats.p99));
+    ImGui::PlotLines(label,
+                     history.data(),
+                     static_cast<int>(history.size()),
+                     static_cast<int>(history.offset()),
+                     overlay,
+                     0.0f,
+                     std::numeric_limits<float>::max(),
+                     ImVec2 {0.0f, 48.0f});
+}
+
+// One row per nesting level, with the threads stacked below each other
+void draw_flame_graph(const Profile_frames &frame)
+{
+    if (frame.zones.empty() || frame.end <= frame.begin)
+    {
+        ImGui::TextUnformatted("No CPU zones recorded");
+        return;
+    }
+
+    std::vector<std::uint32_t> thread_depths;
+    for (const auto &zone : frame.zones)
+    {
+        if (zone.thread_index >= thread_depths.size())
+        {
+            thread_depths.resize(zone.thread_index + 1);
+        }
+        thread_depths[zone.thread_index] =
+            std::max(thread_depths[zone.thread_index], zone.depth + 1);
+    }
+    std::vector<std::uint32_t> thread_rows(thread_depths.size());
+    std::exclusive_scan(thread_depths.begin(),
+                        thread_depths.end(),
+                        thread_rows.begin(),
+                        0u);
+    const auto row_count = thread_rows.back() + thread_depths.back();
+
+    constexpr float row_height {18.0f};
+    const auto origin = ImGui::GetCursorScreenPos();
+    const auto width = ImGui::GetContentRegionAvail().x;
+    const auto scale = width / static_cast<float>(frame.end - frame.begin);
+    auto *const draw_list = ImGui::GetWindowDrawList();
+
+    for (const auto &zone : frame.zones)
+    {
+        const auto begin = std::max(zone.begin, frame.begin) - frame.begin;
+        const auto end = std::min(zone.end, frame.end) - frame.begin;
+        const auto row = thread_rows[zone.thread_index] + zone.depth;
+        const ImVec2 min {origin.x + static_cast<float>(begin) * scale,
+                          origin.y + static_cast<float>(row) * row_height};
+        const ImVec2 max {
+            std::max(origin.x + static_cast<float>(end) * scale, min.x + 1.0f),
+            min.y + row_height - 1.0f};
+
+        // The same zone keeps its color across frames
+        const auto hue = static_cast<float>(
+            std::hash<std::string_view> {}(zone.name) % 360);
+        draw_list->AddRectFilled(
+            min, max, ImColor::HSV(hue / 360.0f, 0.5f, 0.8f));
+        draw_list->PushClipRect(min, max, true);
+        draw_list->AddText({min.x + 2.0f, min.y + 2.0f},
+                           IM_COL32_BLACK,
+                           zone.name);
+        draw_list->PopClipRect();
+
+        if (ImGui::IsMouseHoveringRect(min, max))
+        {
+            ImGui::SetTooltip(
+                "%s: %.3f ms",
+                zone.name,
+                static_cast<double>(zone.end - zone.begin) * 1e-6);
+        }
+    }
+
+    ImGui::Dummy({width, static_cast<float>(row_count) * row_height});
+}
+#endif
+
 } // namespace
 
+std::size_t
+Pipeline_state_hash::operator()(const Pipeline_state &state) const noexcept
+{
+    const auto key = static_cast<std::uint64_t>(state.program) |
+                     (static_cast<std::uint64_t>(state.blend_mode) << 8) |
+                     (static_cast<std::uint64_t>(state.features) << 32);
+    return static_cast<std::size_t>(xxhash64(
+        {reinterpret_cast<const std::uint8_t *>(&key), sizeof(key)}));
+}
+
 Renderer::Renderer(GLFWwindow *window,
                    std::uint32_t width,
-                   std::uint32_t height)
-    : m_context {}, m_instance
+                   std::uint32_t height,
+                   const Config &config,
+                   Job_system &job_system)
+    : m_headless {window == nullptr}, m_job_system {&job_system},
+      m_context {}, m_instance
 {
-    create_instance(m_context)
+    create_instance(m_context, m_headless)
 }
 #ifdef ENABLE_VALIDATION_LAYERS
 , m_debug_messenger
@@ -1604,66 +2467,88 @@ Renderer::Renderer(GLFWwindow *window,
     create_debug_utils_messenger(m_instance)
 }
 #endif
-, m_surface {create_surface(m_instance, window)},
+, m_surface {m_headless ? vk::raii::SurfaceKHR {nullptr}
+                       : create_surface(m_instance, window)},
     m_physical_device {select_physical_device(m_instance, *m_surface)},
     m_queue_family_indices {
         get_queue_family_indices(m_physical_device, *m_surface).value()},
-    m_device {create_device(m_physical_device, m_queue_family_indices)},
+    m_rendering_path {select_rendering_path(m_physical_device)},
+    m_present_wait {!m_headless && present_wait_supported(m_physical_device)},
+    m_device {create_device(m_physical_device,
+                            m_queue_family_indices,
+                            m_rendering_path,
+                            m_headless,
+                            m_present_wait)},
+    m_pipeline_cache {create_pipeline_cache(m_device, m_physical_device)},
+    m_shader_modules {
+        std::make_shared<const Shader_modules>(create_shader_modules(
+            m_device, Shader_program::offscreen, &load_shader)),
+        std::make_shared<const Shader_modules>(create_shader_modules(
+            m_device, Shader_program::final, &load_shader))},
     m_graphics_queue {m_device.getQueue(m_queue_family_indices.graphics, 0)},
     m_present_queue {m_device.getQueue(m_queue_family_indices.present, 0)},
-    m_swapchain {create_swapchain(m_device,
-                                  m_physical_device,
-                                  *m_surface,
-                                  m_queue_family_indices,
-                                  width,
-                                  height)},
-    m_swapchain_images {get_swapchain_images(m_swapchain.swapchain)},
+    m_present_mode {config.present_mode},
+    m_swapchain {m_headless
+                     ? create_headless_swapchain(width, height, m_present_mode)
+                     : create_swapchain(m_device,
+                                        m_physical_device,
+                                        *m_surface,
+                                        m_queue_family_indices,
+                                        width,
+                                        height,
+                                        m_present_mode,
+                                        nullptr)},
+    m_headless_images {
+        m_headless
+            ? create_headless_images(m_device, m_physical_device, m_swapchain)
+            : std::vector<Vulkan_image> {}},
+    m_swapchain_images {m_headless
+                            ? get_headless_images(m_headless_images)
+                            : get_swapchain_images(m_swapchain.swapchain)},
     m_swapchain_image_views {create_swapchain_image_views(
         m_device, m_swapchain_images, m_swapchain.format)},
     m_sampler {create_sampler(m_device)},
-    m_descriptor_pool {create_descriptor_pool(m_device)},
+    m_descriptor_pool {create_descriptor_pool(m_device, m_shader_modules)},
 #ifdef ENABLE_DEBUG_UI
     m_imgui_descriptor_pool {create_imgui_descriptor_pool(m_device)},
 #endif
     m_command_pool {
         create_command_pool(m_device, m_queue_family_indices.graphics)},
-    m_vertex_array {create_vertex_array()}, m_offscreen_width {160},
+    m_vertex_array {create_vertex_array()},
+    m_asset_registry {g_asset_cache_directory},
+    m_texture_streamer {std::uint64_t {config.texture_budget} * 1024 * 1024},
+    m_offscreen_width {160},
     m_offscreen_height {90},
-    m_offscreen_color_attachment {
-        create_offscreen_color_attachment(m_device,
-                                          m_physical_device,
-                                          m_command_pool,
-                                          m_graphics_queue,
-                                          m_offscreen_width,
-                                          m_offscreen_height,
-                                          m_swapchain.format)},
+    m_frame_graph {create_frame_graph(m_device,
+                                      m_physical_device,
+                                      m_offscreen_width,
+                                      m_offscreen_height,
+                                      m_swapchain.format,
+                                      m_headless)},
     m_offscreen_render_pass {
-        create_offscreen_render_pass(m_device, m_swapchain.format)},
-    m_offscreen_descriptor_set_layout {
-        create_offscreen_descriptor_set_layout(m_device)},
-    m_offscreen_pipeline_layout {create_offscreen_pipeline_layout(
-        m_device, m_offscreen_descriptor_set_layout)},
-    m_offscreen_pipeline {create_offscreen_pipeline(
-        m_device,
-        g_offscreen_vertex_shader_path,
-        g_offscreen_fragment_shader_path,
-        {m_offscreen_width, m_offscreen_height},
-        *m_offscreen_pipeline_layout,
-        *m_offscreen_render_pass,
-        g_vertex_input_binding_description,
-        g_vertex_input_attribute_descriptions.data(),
-        g_vertex_input_attribute_descriptions.size())},
+        m_rendering_path == Rendering_path::render_pass
+            ? create_render_pass(m_device, m_swapchain.format)
+            : vk::raii::RenderPass {nullptr}},
+    m_offscreen_descriptor_set_layout {get_descriptor_set_layout(
+        m_shader_modules[static_cast<std::size_t>(Shader_program::offscreen)]
+            ->reflection,
+        0)},
+    m_offscreen_pipeline_layout {get_pipeline_layout(
+        m_shader_modules[static_cast<std::size_t>(Shader_program::offscreen)]
+            ->reflection)},
+    m_offscreen_pipeline_state {
+        g_default_pipeline_states[static_cast<std::size_t>(
+            Shader_program::offscreen)]},
     m_offscreen_framebuffer {
-        create_framebuffer(m_device,
-                           m_offscreen_color_attachment.view,
-                           *m_offscreen_render_pass,
-                           m_offscreen_width,
-                           m_offscreen_height)},
-    m_offscreen_texture_image {create_texture_image(m_device,
-                                                    m_physical_device,
-                                                    m_command_pool,
-                                                    m_graphics_queue,
-                                                    g_texture_path)},
+        m_rendering_path == Rendering_path::render_pass
+            ? create_framebuffer(
+                  m_device,
+                  m_frame_graph.images[m_frame_graph.offscreen_color]->view,
+                  *m_offscreen_render_pass,
+                  m_offscreen_width,
+                  m_offscreen_height)
+            : vk::raii::Framebuffer {nullptr}},
+    m_offscreen_texture {add_texture(g_texture_path)},
     m_offscreen_vertex_buffer {
         create_vertex_buffer(m_device,
                              m_physical_device,
@@ -1678,83 +2563,178 @@ Renderer::Renderer(GLFWwindow *window,
         m_graphics_queue,
         m_vertex_array.indices.data(),
         m_vertex_array.indices.size() * sizeof(std::uint16_t))},
-    m_offscreen_descriptor_set {
-        create_offscreen_descriptor_set(m_device,
-                                        *m_offscreen_descriptor_set_layout,
-                                        *m_descriptor_pool,
-                                        *m_sampler,
-                                        *m_offscreen_texture_image.view)},
+    m_sprite_index_buffer {create_index_buffer(
+        m_device,
+        m_physical_device,
+        m_command_pool,
+        m_graphics_queue,
+        create_sprite_indices().data(),
+        g_sprite_batch_size * 6 * sizeof(std::uint16_t))},
+    m_sprite_buffers {create_sprite_buffers(
+        m_device, m_physical_device, config.sprite_count)},
+    m_offscreen_descriptor_sets {
+        create_descriptor_sets(m_device,
+                               m_offscreen_descriptor_set_layout,
+                               *m_descriptor_pool,
+                               *m_sampler,
+                               streamed_texture_view(m_offscreen_texture))},
+    m_offscreen_descriptor_generations(
+        g_max_frames_in_flight, m_textures[m_offscreen_texture].generation),
     m_framebuffer_width {width}, m_framebuffer_height {height},
-    m_render_pass {create_render_pass(m_device, m_swapchain.format)},
-    m_descriptor_set_layout {create_descriptor_set_layout(m_device)},
-    m_pipeline_layout {
-        create_pipeline_layout(m_device, m_descriptor_set_layout)},
-    m_pipeline {create_pipeline(m_device,
-                                g_final_vertex_shader_path,
-                                g_final_fragment_shader_path,
-                                viewport_offset(m_offscreen_width,
-                                                m_offscreen_height,
-                                                m_swapchain.extent.width,
-                                                m_swapchain.extent.height),
-                                viewport_extent(m_offscreen_width,
-                                                m_offscreen_height,
-                                                m_swapchain.extent.width,
-                                                m_swapchain.extent.height),
-                                {m_framebuffer_width, m_framebuffer_height},
-                                *m_pipeline_layout,
-                                *m_render_pass)},
-    m_framebuffers {create_framebuffers(m_device,
-                                        m_swapchain_image_views,
-                                        *m_render_pass,
-                                        m_swapchain.extent.width,
-                                        m_swapchain.extent.height)},
+    m_render_pass {m_rendering_path == Rendering_path::render_pass
+                       ? create_render_pass(m_device, m_swapchain.format)
+                       : vk::raii::RenderPass {nullptr}},
+    m_descriptor_set_layout {get_descriptor_set_layout(
+        m_shader_modules[static_cast<std::size_t>(Shader_program::final)]
+            ->reflection,
+        0)},
+    m_pipeline_layout {get_pipeline_layout(
+        m_shader_modules[static_cast<std::size_t>(Shader_program::final)]
+            ->reflection)},
+    m_pipeline_state {g_default_pipeline_states[static_cast<std::size_t>(
+        Shader_program::final)]},
+    m_framebuffers {m_rendering_path == Rendering_path::render_pass
+                        ? create_framebuffers(m_device,
+                                              m_swapchain_image_views,
+                                              *m_render_pass,
+                                              m_swapchain.extent.width,
+                                              m_swapchain.extent.height)
+                        : std::vector<vk::raii::Framebuffer> {}},
     m_descriptor_sets {
         create_descriptor_sets(m_device,
-                               *m_descriptor_set_layout,
+                               m_descriptor_set_layout,
                                *m_descriptor_pool,
                                *m_sampler,
-                               *m_offscreen_color_attachment.view)},
+                               *m_frame_graph
+                                    .images[m_frame_graph.offscreen_color]
+                                    ->view)},
     m_draw_command_buffers {
         create_draw_command_buffers(m_device, m_command_pool)},
-    m_sync_objects {create_sync_objects()}
+    m_sync_objects {create_sync_objects()},
+    m_frames_in_flight {config.frames_in_flight},
+    m_requested_frames_in_flight {config.frames_in_flight},
+    m_timestamp_period {timestamp_period(m_physical_device,
+                                         m_queue_family_indices.graphics)},
+    m_timestamp_mask {timestamp_mask(m_physical_device,
+                                     m_queue_family_indices.graphics)},
+    m_timestamp_query_pools {create_timestamp_query_pools(m_device)},
+    m_input_buffers {create_input_buffers(m_device, m_physical_device)}
+#ifdef ENABLE_HOT_RELOAD
+, m_file_watcher
 {
-#ifdef ENABLE_DEBUG_UI
-    ImGui_ImplGlfw_InitForVulkan(window, true);
-    ImGui_ImplVulkan_InitInfo init_info {};
-    init_info.Instance = *m_instance;
-    init_info.PhysicalDevice = *m_physical_device;
-    init_info.Device = *m_device;
-    init_info.QueueFamily = m_queue_family_indices.graphics;
-    init_info.Queue = *m_graphics_queue;
-    init_info.DescriptorPool = *m_imgui_descriptor_pool;
-    init_info.Subpass = 0;
-    init_info.MinImageCount = m_swapchain.min_image_count;
-    init_info.ImageCount =
-        static_cast<std::uint32_t>(m_swapchain_images.size());
-    init_info.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
-    init_info.CheckVkResultFn = &check_vk_result;
-    ImGui_ImplVulkan_Init(&init_info, *m_render_pass);
-
-    ImFontConfig font_config {};
-    font_config.SizePixels = 32.0f;
-    ImGui::GetIO().Fonts->AddFontDefault(&font_config);
+    std::vector<std::filesystem::path> {g_shader_directory, g_asset_directory}
+}
+#endif
+{
+    write_input_descriptors();
 
-    const auto command_buffer =
-        begin_one_time_submit_command_buffer(m_device, m_command_pool);
-    ImGui_ImplVulkan_CreateFontsTexture(*command_buffer);
-    end_one_time_submit_command_buffer(command_buffer, m_graphics_queue);
-    m_device.waitIdle();
-    ImGui_ImplVulkan_DestroyFontUploadObjects();
+    // The first frames skip the draws that are not ready yet
+    for (const auto &state : g_default_pipeline_states)
+    {
+        prewarm_pipeline(state);
+    }
+
+    if (m_present_wait)
+    {
+        m_present_waiter.emplace(m_device);
+    }
+
+    if (m_swapchain.present_mode != m_present_mode)
+    {
+        std::cerr << "Present mode " << present_mode_name(m_present_mode)
+                  << " is not supported, using "
+                  << present_mode_name(m_swapchain.present_mode) << '\n';
+    }
+
+#ifdef ENABLE_DEBUG_UI
+    // There is no window to draw the debug UI over
+    if (!m_headless)
+    {
+        ImGui_ImplGlfw_InitForVulkan(window, true);
+        ImGui_ImplVulkan_InitInfo init_info {};
+        init_info.Instance = *m_instance;
+        init_info.PhysicalDevice = *m_physical_device;
+        init_info.Device = *m_device;
+        init_info.QueueFamily = m_queue_family_indices.graphics;
+        init_info.Queue = *m_graphics_queue;
+        init_info.DescriptorPool = *m_imgui_descriptor_pool;
+        init_info.Subpass = 0;
+        init_info.MinImageCount = m_swapchain.min_image_count;
+        // ImGui cycles through one set of vertex and index buffers per image,
+        // a set must not be reused while a frame in flight still reads it
+        init_info.ImageCount = std::max<std::uint32_t>(
+            static_cast<std::uint32_t>(m_swapchain_images.size()),
+            g_max_frames_in_flight);
+        init_info.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
+        init_info.CheckVkResultFn = &check_vk_result;
+        // Without a render pass, ImGui builds its pipeline for the format
+        init_info.UseDynamicRendering =
+            m_rendering_path != Rendering_path::render_pass;
+        init_info.ColorAttachmentFormat =
+            static_cast<VkFormat>(m_swapchain.format);
+        ImGui_ImplVulkan_Init(&init_info, *m_render_pass);
+
+        ImFontConfig font_config {};
+        font_config.SizePixels = 32.0f;
+        ImGui::GetIO().Fonts->AddFontDefault(&font_config);
+
+        const auto command_buffer =
+            begin_one_time_submit_command_buffer(m_device, m_command_pool);
+        ImGui_ImplVulkan_CreateFontsTexture(*command_buffer);
+        end_one_time_submit_command_buffer(command_buffer, m_graphics_queue);
+        m_device.waitIdle();
+        ImGui_ImplVulkan_DestroyFontUploadObjects();
+    }
 #endif
 }
 
 Renderer::~Renderer()
 {
+    // The long jobs reference the device and the asset registry
+    for (auto &[state, pending] : m_pending_pipelines)
+    {
+        wait_for_job(*m_job_system, pending.pipeline->counter);
+    }
+    for (auto &texture : m_textures)
+    {
+        if (texture.loading != nullptr)
+        {
+            wait_for_job(*m_job_system, texture.loading->counter);
+        }
+    }
+#ifdef ENABLE_HOT_RELOAD
+    for (auto &pending : m_pending_programs)
+    {
+        if (pending != nullptr)
+        {
+            wait_for_job(*m_job_system, pending->counter);
+        }
+    }
+    for (auto &reload : m_pending_texture_reloads)
+    {
+        wait_for_job(*m_job_system, reload.texture->counter);
+    }
+#endif
+
     m_device.waitIdle();
 
+    stop_capture();
+
+    try
+    {
+        save_pipeline_cache(m_pipeline_cache);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Failed to save pipeline cache: " << e.what() << '\n';
+    }
+
 #ifdef ENABLE_DEBUG_UI
-    ImGui_ImplVulkan_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
+    if (!m_headless)
+    {
+        ImGui_ImplVulkan_Shutdown();
+        ImGui_ImplGlfw_Shutdown();
+    }
 #endif
 }
 
@@ -1794,172 +2774,1425 @@ Vertex_array Renderer::create_vertex_array()
     return vertex_array;
 }
 
-Sync_objects Renderer::create_sync_objects()
+void Renderer::write_sprites(std::span<const Sprite> sprites)
 {
-    Sync_objects result;
-
-    for (std::size_t i {}; i < g_max_frames_in_flight; ++i)
+    // The frame that last used the buffer has retired
+    auto &sprite_buffer = m_sprite_buffers[m_current_frame];
+    const auto sprite_count = static_cast<std::uint32_t>(sprites.size());
+    if (sprite_count > sprite_buffer.capacity)
     {
-        constexpr vk::SemaphoreCreateInfo semaphore_create_info {};
+        sprite_buffer = create_sprite_buffer(
+            m_device,
+            m_physical_device,
+            std::max(sprite_count, sprite_buffer.capacity * 2));
+    }
 
-        constexpr vk::FenceCreateInfo fence_create_info {
-            .flags = vk::FenceCreateFlagBits::eSignaled};
+    // The chunks write disjoint vertices
+    m_job_system->parallel_for(
+        sprites.size(),
+        g_sprites_per_job,
+        [&sprites, vertices = sprite_buffer.mapped](std::size_t first,
+                                                    std::size_t last)
+        {
+            auto *vertex = vertices + first * 4;
+            for (auto i = first; i < last; ++i)
+            {
+                const auto x = sprites[i].position.x;
+                const auto y = sprites[i].position.y;
+                const auto x_end = x + sprites[i].size.x;
+                const auto y_end = y + sprites[i].size.y;
+                *vertex++ = {{x, y, 0.0f}, {0.0f, 0.0f}};
+                *vertex++ = {{x, y_end, 0.0f}, {0.0f, 1.0f}};
+                *vertex++ = {{x_end, y_end, 0.0f}, {1.0f, 1.0f}};
+                *vertex++ = {{x_end, y, 0.0f}, {1.0f, 0.0f}};
+            }
+        });
+    m_sprite_count = sprite_count;
+}
 
-        result.image_available_semaphores.emplace_back(m_device,
+Sync_objects Renderer::create_sync_objects()
+{
+    constexpr vk::SemaphoreTypeCreateInfo semaphore_type_create_info {
+        .semaphoreType = vk::SemaphoreType::eTimeline, .initialValue = 0};
+
+    const vk::SemaphoreCreateInfo timeline_semaphore_create_info {
+        .pNext = &semaphore_type_create_info};
+
+    Sync_objects result {
+        .image_available_semaphores = {},
+        .render_finished_semaphores = {},
+        .frame_timeline = {m_device, timeline_semaphore_create_info}};
+
+    for (std::size_t i {}; i < g_max_frames_in_flight; ++i)
+    {
+        constexpr vk::SemaphoreCreateInfo semaphore_create_info {};
+
+        result.image_available_semaphores.emplace_back(m_device,
                                                        semaphore_create_info);
         result.render_finished_semaphores.emplace_back(m_device,
                                                        semaphore_create_info);
-        result.in_flight_fences.emplace_back(m_device, fence_create_info);
     }
 
-    return result;
+    return result;
+}
+
+bool Renderer::is_frame_retired(std::uint64_t frame_number) const
+{
+    return m_sync_objects.frame_timeline.getCounterValue() > frame_number;
+}
+
+void Renderer::wait_for_frame(std::uint64_t frame_number) const
+{
+    const Profile_zone zone {"Wait for frame"};
+
+    const auto value = frame_number + 1;
+    const vk::SemaphoreWaitInfo wait_info {
+        .semaphoreCount = 1,
+        .pSemaphores = &*m_sync_objects.frame_timeline,
+        .pValues = &value};
+
+    if (m_device.waitSemaphores(wait_info,
+                                std::numeric_limits<std::uint64_t>::max()) !=
+        vk::Result::eSuccess)
+    {
+        throw std::runtime_error("Error while waiting for a frame");
+    }
+}
+
+Texture_id Renderer::add_texture(const char *path)
+{
+    // Read and hashed once, the placeholder is decoded from the same view
+    const auto file = open_texture_file(path);
+    const auto hash = xxhash64(file.data());
+
+    if (const auto id = m_asset_registry.acquire(hash))
+    {
+        return *id;
+    }
+
+    auto [placeholder, upload] = upload_texture_image(
+        m_device,
+        m_physical_device,
+        m_command_pool,
+        m_graphics_queue,
+        load_placeholder_texture_data(m_asset_registry, file, hash, path));
+    // Submitted before the current frame, so it completes before it
+    m_deletion_queue.push(m_frame_number, std::move(upload));
+
+    m_textures.push_back({.path = path,
+                          .hash = hash,
+                          .registry_hash = hash,
+                          .placeholder = std::move(placeholder),
+                          .full = std::nullopt,
+                          .loading = nullptr,
+                          .uploading = std::nullopt,
+                          .upload_frame = 0,
+                          .generation = 0});
+
+    const auto id = m_texture_streamer.add_texture();
+    m_asset_registry.insert(hash, id);
+    return id;
+}
+
+void Renderer::release_texture(Texture_id id)
+{
+    auto &texture = m_textures[id];
+    if (!m_asset_registry.release(texture.registry_hash))
+    {
+        return;
+    }
+
+    // The slot is left empty, ids are not reused. A load in progress is
+    // dropped once it is done.
+    m_deletion_queue.push(m_frame_number, std::move(texture.placeholder));
+    for (auto *const image : {&texture.full, &texture.uploading})
+    {
+        if (image->has_value())
+        {
+            m_deletion_queue.push(m_frame_number, std::move(**image));
+            image->reset();
+        }
+    }
+    texture.path.clear();
+    m_texture_streamer.remove_texture(id);
+}
+
+vk::ImageView Renderer::streamed_texture_view(Texture_id id) const
+{
+    const auto &texture = m_textures[id];
+    return texture.full.has_value() ? *texture.full->view
+                                    : *texture.placeholder.view;
+}
+
+void Renderer::update_streamed_textures()
+{
+    if (m_stream_full_textures &&
+        m_texture_streamer.use(m_offscreen_texture, m_frame_number))
+    {
+        auto &texture = m_textures[m_offscreen_texture];
+        if (texture.loading == nullptr && !texture.uploading.has_value())
+        {
+            // Registering the texture stored its decoded content in the
+            // asset cache, the file is only read again on a cache miss
+            texture.loading = m_job_system->submit_long(
+                [&asset_registry = m_asset_registry,
+                 hash = texture.hash,
+                 path = texture.path]
+                {
+                    if (auto cached = load_cached_texture_data(
+                            asset_registry, hash, g_cached_texture_kind))
+                    {
+                        return std::move(*cached);
+                    }
+                    const auto file = open_texture_file(path.c_str());
+                    return load_texture_data(asset_registry,
+                                             file,
+                                             xxhash64(file.data()),
+                                             path.c_str());
+                });
+        }
+    }
+
+    for (Texture_id id {}; id < m_textures.size(); ++id)
+    {
+        auto &texture = m_textures[id];
+        // Released while loading
+        if (texture.loading != nullptr && texture.loading->counter.is_done() &&
+            texture.path.empty())
+        {
+            wait_for_job(*m_job_system, texture.loading->counter);
+            texture.loading.reset();
+        }
+
+        if (texture.loading != nullptr && texture.loading->counter.is_done())
+        {
+            try
+            {
+                auto [image, upload] =
+                    upload_texture_image(m_device,
+                                         m_physical_device,
+                                         m_command_pool,
+                                         m_graphics_queue,
+                                         m_job_system->take_result(
+                                             *texture.loading));
+                m_deletion_queue.push(m_frame_number, std::move(upload));
+                texture.uploading = std::move(image);
+                texture.upload_frame = m_frame_number;
+                m_texture_streamer.set_resident(
+                    id, texture.uploading->image.getMemoryRequirements().size);
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "Failed to load texture: " << e.what() << '\n';
+                // Not retried on every use, the placeholder stays in use
+                m_texture_streamer.set_resident(id, 0);
+            }
+            texture.loading.reset();
+        }
+
+        if (texture.uploading.has_value() &&
+            is_frame_retired(texture.upload_frame))
+        {
+            if (texture.full.has_value())
+            {
+                m_deletion_queue.push(m_frame_number, std::move(*texture.full));
+            }
+            texture.full = std::move(texture.uploading);
+            texture.uploading.reset();
+            ++texture.generation;
+        }
+    }
+
+    // Evicted images may still be referenced by frames in flight, their
+    // destruction is deferred until the current frame has retired
+    for (const auto id : m_texture_streamer.evict_over_budget(m_frame_number))
+    {
+        auto &texture = m_textures[id];
+        if (texture.full.has_value())
+        {
+            m_deletion_queue.push(m_frame_number, std::move(*texture.full));
+            texture.full.reset();
+            ++texture.generation;
+        }
+        if (texture.uploading.has_value())
+        {
+            m_deletion_queue.push(m_frame_number,
+                                  std::move(*texture.uploading));
+            texture.uploading.reset();
+        }
+    }
+
+    // The descriptor set of the current frame is no longer in use by the GPU.
+    // Comparing generations rather than views, a destroyed view's handle may
+    // have been reused.
+    const auto generation = m_textures[m_offscreen_texture].generation;
+    if (m_offscreen_descriptor_generations[m_current_frame] != generation)
+    {
+        update_descriptor_set(m_device,
+                              m_offscreen_descriptor_sets[m_current_frame],
+                              *m_sampler,
+                              streamed_texture_view(m_offscreen_texture));
+        m_offscreen_descriptor_generations[m_current_frame] = generation;
+    }
+}
+
+vk::Pipeline Renderer::get_pipeline(const Pipeline_state &state)
+{
+    if (const auto it = m_pipelines.find(state); it != m_pipelines.end())
+    {
+        ++m_pipeline_variant_hits;
+        return *it->second;
+    }
+
+    ++m_pipeline_variant_misses;
+    prewarm_pipeline(state);
+
+    const auto fallback = m_pipelines.find(
+        g_default_pipeline_states[static_cast<std::size_t>(state.program)]);
+    return fallback != m_pipelines.end() ? *fallback->second : vk::Pipeline {};
+}
+
+void Renderer::prewarm_pipeline(const Pipeline_state &state)
+{
+    if (m_pipelines.contains(state) || m_pending_pipelines.contains(state))
+    {
+        return;
+    }
+
+    auto modules = m_shader_modules[static_cast<std::size_t>(state.program)];
+
+    auto job = m_job_system->submit_long(
+        [&device = m_device,
+         &pipeline_cache = m_pipeline_cache,
+         state,
+         modules,
+         pipeline_layout = pipeline_layout(state.program),
+         target = pipeline_target(state.program)]
+        {
+            const Profile_zone zone {"Create pipeline"};
+            std::chrono::duration<double, std::milli> creation_time {};
+            auto pipeline = timed(creation_time,
+                                  [&]
+                                  {
+                                      return create_pipeline(device,
+                                                             pipeline_cache,
+                                                             state,
+                                                             *modules,
+                                                             pipeline_layout,
+                                                             target);
+                                  });
+            return Compiled_pipeline {.pipeline = std::move(pipeline),
+                                      .creation_time = creation_time};
+        });
+
+    m_pending_pipelines.emplace(
+        state,
+        Pending_pipeline {.modules = std::move(modules),
+                          .pipeline = std::move(job)});
+}
+
+void Renderer::collect_pipelines()
+{
+    for (auto it = m_pending_pipelines.begin();
+         it != m_pending_pipelines.end();)
+    {
+        auto &[state, pending] = *it;
+        if (!pending.pipeline->counter.is_done())
+        {
+            ++it;
+            continue;
+        }
+
+        try
+        {
+            auto compiled = m_job_system->take_result(*pending.pipeline);
+            m_pipeline_creation_time += compiled.creation_time;
+
+            // Discarded if the shaders have been hot reloaded in the meantime,
+            // it is built again on its next use
+            const auto program = static_cast<std::size_t>(state.program);
+            if (pending.modules == m_shader_modules[program])
+            {
+                m_pipelines.try_emplace(state, std::move(compiled.pipeline));
+            }
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Failed to create pipeline: " << e.what() << '\n';
+        }
+
+        it = m_pending_pipelines.erase(it);
+    }
+}
+
+std::vector<Pipeline_state>
+Renderer::invalidate_pipelines(Shader_program program)
+{
+    std::vector<Pipeline_state> states;
+
+    for (auto it = m_pipelines.begin(); it != m_pipelines.end();)
+    {
+        if (it->first.program != program)
+        {
+            ++it;
+            continue;
+        }
+
+        states.push_back(it->first);
+        m_deletion_queue.push(m_frame_number, std::move(it->second));
+        it = m_pipelines.erase(it);
+    }
+
+    return states;
+}
+
+vk::PipelineLayout Renderer::pipeline_layout(Shader_program program) const
+{
+    return program == Shader_program::offscreen ? m_offscreen_pipeline_layout
+                                                : m_pipeline_layout;
+}
+
+Pipeline_target Renderer::pipeline_target(Shader_program program) const
+{
+    // The offscreen color attachment has the format of the swapchain too
+    return {.render_pass = program == Shader_program::offscreen
+                               ? *m_offscreen_render_pass
+                               : *m_render_pass,
+            .color_attachment_format = m_swapchain.format};
+}
+
+vk::DescriptorSetLayout
+Renderer::get_descriptor_set_layout(const Shader_reflection &reflection,
+                                    std::uint32_t set)
+{
+    std::vector<Descriptor_binding> bindings;
+    for (const auto &binding : reflection.bindings)
+    {
+        if (binding.set == set)
+        {
+            bindings.push_back(binding);
+            bindings.back().set = 0;
+        }
+    }
+
+    auto it = m_descriptor_set_layouts.find(bindings);
+    if (it == m_descriptor_set_layouts.end())
+    {
+        auto layout = create_descriptor_set_layout(m_device, bindings);
+        it = m_descriptor_set_layouts.emplace(bindings, std::move(layout))
+                 .first;
+    }
+
+    return *it->second;
+}
+
+vk::PipelineLayout
+Renderer::get_pipeline_layout(const Shader_reflection &reflection)
+{
+    auto key = std::pair {reflection.bindings, reflection.push_constants};
+    if (const auto it = m_pipeline_layouts.find(key);
+        it != m_pipeline_layouts.end())
+    {
+        return *it->second;
+    }
+
+    // Every set up to the last one used needs a layout, possibly empty. The
+    // bindings are sorted by set.
+    const auto set_count =
+        reflection.bindings.empty() ? 0u : reflection.bindings.back().set + 1;
+    std::vector<vk::DescriptorSetLayout> set_layouts;
+    for (std::uint32_t set {}; set < set_count; ++set)
+    {
+        set_layouts.push_back(get_descriptor_set_layout(reflection, set));
+    }
+
+    auto layout = create_pipeline_layout(
+        m_device, set_layouts, reflection.push_constants);
+    return *m_pipeline_layouts.emplace(std::move(key), std::move(layout))
+                .first->second;
+}
+
+#ifdef ENABLE_HOT_RELOAD
+
+void Renderer::process_hot_reload()
+{
+    for (const auto &path : m_file_watcher.poll())
+    {
+        for (std::size_t i {}; i < g_shader_program_count; ++i)
+        {
+            if (path == shader_path(g_shader_programs[i].vertex_shader) ||
+                path == shader_path(g_shader_programs[i].fragment_shader))
+            {
+                m_dirty_programs[i] = true;
+            }
+        }
+
+        for (Texture_id id {}; id < m_textures.size(); ++id)
+        {
+            if (path != m_textures[id].path)
+            {
+                continue;
+            }
+
+            m_pending_texture_reloads.push_back(
+                {.id = id,
+                 .texture = m_job_system->submit_long(
+                     [&asset_registry = m_asset_registry,
+                      texture_path = m_textures[id].path]
+                     {
+                         const auto file =
+                             open_texture_file(texture_path.c_str());
+                         const auto hash = xxhash64(file.data());
+                         auto full = load_texture_data(asset_registry,
+                                                       file,
+                                                       hash,
+                                                       texture_path.c_str());
+                         auto placeholder =
+                             create_placeholder_texture_data(full);
+                         store_cached_texture_data(asset_registry,
+                                                   hash,
+                                                   g_cached_placeholder_kind,
+                                                   placeholder);
+                         return Decoded_texture {
+                             .hash = hash,
+                             .full = std::move(full),
+                             .placeholder = std::move(placeholder)};
+                     })});
+        }
+    }
+
+    // Only one rebuild per program at a time, further changes are picked up
+    // once the current one is done
+    for (std::size_t i {}; i < g_shader_program_count; ++i)
+    {
+        if (!m_dirty_programs[i] || m_pending_programs[i].has_value())
+        {
+            continue;
+        }
+        m_dirty_programs[i] = false;
+
+        const auto program = static_cast<Shader_program>(i);
+
+        // Every cached variant is rebuilt with the new shaders
+        std::vector<Pipeline_state> states;
+        for (const auto &[state, pipeline] : m_pipelines)
+        {
+            if (state.program == program)
+            {
+                states.push_back(state);
+            }
+        }
+
+        m_pending_programs[i] = m_job_system->submit_long(
+            [&device = m_device,
+             &pipeline_cache = m_pipeline_cache,
+             program,
+             current_modules = m_shader_modules[i],
+             states = std::move(states),
+             pipeline_layout = pipeline_layout(program),
+             target = pipeline_target(program)]
+            {
+                Reloaded_program reloaded {
+                    .modules = std::make_shared<const Shader_modules>(
+                        create_shader_modules(
+                            device, program, &load_shader_from_disk)),
+                    .pipelines = {}};
+
+                // The layouts and descriptor sets were built for the current
+                // interface
+                if (reloaded.modules->reflection != current_modules->reflection)
+                {
+                    throw std::runtime_error(
+                        "the shader interface changed, restart to apply");
+                }
+
+                for (const auto &state : states)
+                {
+                    reloaded.pipelines.emplace_back(
+                        state,
+                        create_pipeline(device,
+                                        pipeline_cache,
+                                        state,
+                                        *reloaded.modules,
+                                        pipeline_layout,
+                                        target));
+                }
+
+                return reloaded;
+            });
+    }
+
+    for (std::size_t i {}; i < g_shader_program_count; ++i)
+    {
+        auto &pending = m_pending_programs[i];
+        if (pending == nullptr || !pending->counter.is_done())
+        {
+            continue;
+        }
+
+        try
+        {
+            auto reloaded = m_job_system->take_result(*pending);
+
+            // Variants added since the rebuild started were built with the
+            // old shaders, they are rebuilt on their next use
+            invalidate_pipelines(static_cast<Shader_program>(i));
+            m_shader_modules[i] = std::move(reloaded.modules);
+            for (auto &[state, pipeline] : reloaded.pipelines)
+            {
+                m_pipelines.insert_or_assign(state, std::move(pipeline));
+            }
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Failed to reload pipeline: " << e.what() << '\n';
+        }
+
+        pending.reset();
+    }
+
+    for (auto it = m_pending_texture_reloads.begin();
+         it != m_pending_texture_reloads.end();)
+    {
+        // A first-use load still in progress decoded the previous content,
+        // the reload replaces it once it is uploaded
+        if (!it->texture->counter.is_done() ||
+            m_textures[it->id].loading != nullptr)
+        {
+            ++it;
+            continue;
+        }
+
+        // Released meanwhile
+        if (m_textures[it->id].path.empty())
+        {
+            wait_for_job(*m_job_system, it->texture->counter);
+            it = m_pending_texture_reloads.erase(it);
+            continue;
+        }
+
+        try
+        {
+            const auto decoded = m_job_system->take_result(*it->texture);
+            auto &texture = m_textures[it->id];
+
+            // Later loads must not come back to the previous content from the
+            // cache, and textures added with it must not share this one
+            texture.hash = decoded.hash;
+            if (m_asset_registry.rename(texture.registry_hash, decoded.hash))
+            {
+                texture.registry_hash = decoded.hash;
+            }
+
+            auto placeholder = upload_texture_image(m_device,
+                                                    m_physical_device,
+                                                    m_command_pool,
+                                                    m_graphics_queue,
+                                                    decoded.placeholder);
+            m_deletion_queue.push(m_frame_number,
+                                  std::move(texture.placeholder));
+            m_deletion_queue.push(m_frame_number,
+                                  std::move(placeholder.upload));
+            texture.placeholder = std::move(placeholder.image);
+            ++texture.generation;
+
+            // The current full image stays in use until the new one is
+            // uploaded
+            if (texture.full.has_value() || texture.uploading.has_value())
+            {
+                auto full = upload_texture_image(m_device,
+                                                 m_physical_device,
+                                                 m_command_pool,
+                                                 m_graphics_queue,
+                                                 decoded.full);
+                if (texture.uploading.has_value())
+                {
+                    m_deletion_queue.push(m_frame_number,
+                                          std::move(*texture.uploading));
+                }
+                m_deletion_queue.push(m_frame_number, std::move(full.upload));
+                texture.uploading = std::move(full.image);
+                texture.upload_frame = m_frame_number;
+                m_texture_streamer.set_resident(
+                    it->id,
+                    texture.uploading->image.getMemoryRequirements().size);
+            }
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Failed to reload texture: " << e.what() << '\n';
+        }
+
+        it = m_pending_texture_reloads.erase(it);
+    }
+}
+
+#endif
+
+void Renderer::record_command_buffer(std::uint32_t image_index,
+                                     const Push_constants &push_constants)
+{
+    const Profile_zone zone {"Record"};
+
+    const auto &command_buffer = m_draw_command_buffers[m_current_frame];
+
+    command_buffer.begin({});
+
+    if (m_timestamp_period > 0.0f)
+    {
+        command_buffer.resetQueryPool(*m_timestamp_query_pools[m_current_frame],
+                                      0,
+                                      g_gpu_timestamp_count);
+        m_timestamps_written[m_current_frame] = true;
+        m_timestamp_frames[m_current_frame] = m_frame_number;
+    }
+    write_timestamp(command_buffer,
+                    Gpu_timestamp::frame_begin,
+                    vk::PipelineStageFlagBits::eTopOfPipe);
+
+    for (const auto &pass : m_frame_graph.compiled.passes)
+    {
+        record_barriers(command_buffer, pass.barriers, image_index);
+
+        if (pass.pass == m_frame_graph.offscreen_pass)
+        {
+            record_offscreen_pass(command_buffer, push_constants);
+            write_timestamp(command_buffer,
+                            Gpu_timestamp::offscreen_end,
+                            vk::PipelineStageFlagBits::eBottomOfPipe);
+        }
+        else if (pass.pass == m_frame_graph.final_pass)
+        {
+            record_final_pass(command_buffer, image_index);
+        }
+        else if (pass.pass == m_frame_graph.capture_pass)
+        {
+            record_capture_copy(command_buffer, image_index);
+        }
+    }
+
+    record_barriers(
+        command_buffer, m_frame_graph.compiled.final_barriers, image_index);
+
+    command_buffer.end();
+}
+
+void Renderer::record_offscreen_pass(
+    const vk::raii::CommandBuffer &command_buffer,
+    const Push_constants &push_constants)
+{
+    begin_rendering(
+        command_buffer,
+        *m_offscreen_render_pass,
+        *m_offscreen_framebuffer,
+        *m_frame_graph.images[m_frame_graph.offscreen_color]->view,
+        {m_offscreen_width, m_offscreen_height});
+
+    // Skipped until the variant or its fallback has been built
+    if (const auto pipeline = get_pipeline(m_offscreen_pipeline_state))
+    {
+        command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+                                          m_offscreen_pipeline_layout,
+                                          0,
+                                          m_offscreen_descriptor_sets
+                                              [m_current_frame],
+                                          {});
+
+        command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics,
+                                    pipeline);
+
+        const vk::Viewport viewport {
+            .x = 0.0f,
+            .y = 0.0f,
+            .width = static_cast<float>(m_offscreen_width),
+            .height = static_cast<float>(m_offscreen_height),
+            .minDepth = 0.0f,
+            .maxDepth = 1.0f};
+        command_buffer.setViewport(0, viewport);
+
+        const vk::Rect2D scissor {
+            .offset = {0, 0},
+            .extent = {m_offscreen_width, m_offscreen_height}};
+        command_buffer.setScissor(0, scissor);
+
+        command_buffer.bindVertexBuffers(
+            0, *m_offscreen_vertex_buffer.buffer, {0});
+
+        command_buffer.bindIndexBuffer(
+            *m_offscreen_index_buffer.buffer, 0, vk::IndexType::eUint16);
+
+        command_buffer.pushConstants<Push_constants>(
+            m_offscreen_pipeline_layout,
+            vk::ShaderStageFlagBits::eFragment,
+            0,
+            {push_constants});
+
+        command_buffer.drawIndexed(
+            static_cast<std::uint32_t>(m_vertex_array.indices.size()),
+            1,
+            0,
+            0,
+            0);
+
+        if (m_sprite_count > 0)
+        {
+            command_buffer.bindVertexBuffers(
+                0, *m_sprite_buffers[m_current_frame].buffer.buffer, {0});
+            command_buffer.bindIndexBuffer(
+                *m_sprite_index_buffer.buffer, 0, vk::IndexType::eUint16);
+        }
+        for (std::uint32_t first {}; first < m_sprite_count;
+             first += g_sprite_batch_size)
+        {
+            const auto count =
+                std::min(g_sprite_batch_size, m_sprite_count - first);
+            command_buffer.drawIndexed(
+                count * 6, 1, 0, static_cast<std::int32_t>(first * 4), 0);
+        }
+    }
+
+    end_rendering(command_buffer);
+}
+
+void Renderer::record_final_pass(const vk::raii::CommandBuffer &command_buffer,
+                                 std::uint32_t image_index)
+{
+    begin_rendering(command_buffer,
+                    *m_render_pass,
+                    m_framebuffers.empty() ? vk::Framebuffer {}
+                                           : *m_framebuffers[image_index],
+                    *m_swapchain_image_views[image_index],
+                    m_swapchain.extent);
+
+    if (const auto pipeline = get_pipeline(m_pipeline_state))
+    {
+        command_buffer.bindDescriptorSets(
+            vk::PipelineBindPoint::eGraphics,
+            m_pipeline_layout,
+            0,
+            m_descriptor_sets[m_current_frame],
+            {});
+
+        command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics,
+                                    pipeline);
+
+        const auto offset = viewport_offset(m_offscreen_width,
+                                            m_offscreen_height,
+                                            m_swapchain.extent.width,
+                                            m_swapchain.extent.height);
+        const auto extent = viewport_extent(m_offscreen_width,
+                                            m_offscreen_height,
+                                            m_swapchain.extent.width,
+                                            m_swapchain.extent.height);
+        const vk::Viewport viewport {
+            .x = static_cast<float>(offset.x),
+            .y = static_cast<float>(offset.y),
+            .width = static_cast<float>(extent.width),
+            .height = static_cast<float>(extent.height),
+            .minDepth = 0.0f,
+            .maxDepth = 1.0f};
+        command_buffer.setViewport(0, viewport);
+
+        const vk::Rect2D scissor {.offset = {0, 0},
+                                  .extent = m_swapchain.extent};
+        command_buffer.setScissor(0, scissor);
+
+        command_buffer.draw(4, 1, 0, 0);
+    }
+
+    write_timestamp(command_buffer,
+                    Gpu_timestamp::final_end,
+                    vk::PipelineStageFlagBits::eBottomOfPipe);
+
+#ifdef ENABLE_DEBUG_UI
+    if (!m_headless)
+    {
+        ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), *command_buffer);
+    }
+#endif
+
+    write_timestamp(command_buffer,
+                    Gpu_timestamp::ui_end,
+                    vk::PipelineStageFlagBits::eBottomOfPipe);
+
+    end_rendering(command_buffer);
+}
+
+void Renderer::write_timestamp(const vk::raii::CommandBuffer &command_buffer,
+                               Gpu_timestamp timestamp,
+                               vk::PipelineStageFlagBits stage) const
+{
+    if (m_timestamp_period > 0.0f)
+    {
+        command_buffer.writeTimestamp(
+            stage,
+            *m_timestamp_query_pools[m_current_frame],
+            static_cast<std::uint32_t>(timestamp));
+    }
+}
+
+void Renderer::read_gpu_timestamps()
+{
+    if (!m_timestamps_written[m_current_frame])
+    {
+        return;
+    }
+    m_timestamps_written[m_current_frame] = false;
+
+    // No wait flag, the frame has retired so the results are available
+    const auto [result, timestamps] =
+        m_timestamp_query_pools[m_current_frame].getResults<std::uint64_t>(
+            0,
+            g_gpu_timestamp_count,
+            g_gpu_timestamp_count * sizeof(std::uint64_t),
+            sizeof(std::uint64_t),
+            vk::QueryResultFlagBits::e64);
+    if (result != vk::Result::eSuccess)
+    {
+        return;
+    }
+
+    Gpu_frame_times frame_times {
+        .frame_number = m_timestamp_frames[m_current_frame], .pass_times = {}};
+    for (std::size_t i {}; i < g_gpu_pass_count; ++i)
+    {
+        // Masked, the counter may have wrapped between the two timestamps
+        const auto ticks =
+            (timestamps[i + 1] - timestamps[i]) & m_timestamp_mask;
+        frame_times.pass_times[i] = static_cast<float>(
+            static_cast<double>(ticks) * m_timestamp_period * 1e-6);
+        m_gpu_pass_times[i].push(frame_times.pass_times[i]);
+    }
+    m_last_gpu_frame_times = frame_times;
+}
+
+void Renderer::begin_rendering(const vk::raii::CommandBuffer &command_buffer,
+                               vk::RenderPass render_pass,
+                               vk::Framebuffer framebuffer,
+                               vk::ImageView color_attachment,
+                               vk::Extent2D extent) const
+{
+    constexpr vk::ClearValue clear_color_value {
+        .color = {{{0.0f, 0.0f, 0.0f, 1.0f}}}};
+
+    if (m_rendering_path == Rendering_path::render_pass)
+    {
+        const vk::RenderPassBeginInfo render_pass_begin_info {
+            .renderPass = render_pass,
+            .framebuffer = framebuffer,
+            .renderArea = {.offset = {0, 0}, .extent = extent},
+            .clearValueCount = 1,
+            .pClearValues = &clear_color_value};
+
+        command_buffer.beginRenderPass(render_pass_begin_info,
+                                       vk::SubpassContents::eInline);
+        return;
+    }
+
+    // The layout is set by the barriers of the frame graph
+    const vk::RenderingAttachmentInfo color_attachment_info {
+        .imageView = color_attachment,
+        .imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
+        .loadOp = vk::AttachmentLoadOp::eClear,
+        .storeOp = vk::AttachmentStoreOp::eStore,
+        .clearValue = clear_color_value};
+
+    const vk::RenderingInfo rendering_info {
+        .renderArea = {.offset = {0, 0}, .extent = extent},
+        .layerCount = 1,
+        .colorAttachmentCount = 1,
+        .pColorAttachments = &color_attachment_info};
+
+    if (m_rendering_path == Rendering_path::dynamic_rendering)
+    {
+        command_buffer.beginRendering(rendering_info);
+    }
+    else
+    {
+        command_buffer.beginRenderingKHR(rendering_info);
+    }
+}
+
+void Renderer::end_rendering(
+    const vk::raii::CommandBuffer &command_buffer) const
+{
+    switch (m_rendering_path)
+    {
+    case Rendering_path::render_pass: command_buffer.endRenderPass(); break;
+    case Rendering_path::dynamic_rendering:
+        command_buffer.endRendering();
+        break;
+    case Rendering_path::dynamic_rendering_khr:
+        command_buffer.endRenderingKHR();
+        break;
+    }
+}
+
+void Renderer::present(std::uint32_t image_index)
+{
+    // Unique and increasing, as present ids must be
+    const auto present_id = m_frame_number + 1;
+    const vk::PresentIdKHR present_id_info {.swapchainCount = 1,
+                                            .pPresentIds = &present_id};
+
+    const vk::PresentInfoKHR present_info {
+        .pNext = m_present_waiter.has_value() ? &present_id_info : nullptr,
+        .waitSemaphoreCount = 1,
+        .pWaitSemaphores =
+            &*m_sync_objects.render_finished_semaphores[m_current_frame],
+        .swapchainCount = 1,
+        .pSwapchains = &*m_swapchain.swapchain,
+        .pImageIndices = &image_index};
+
+    const auto present_result = [&]
+    {
+        const Profile_zone zone {"Present"};
+        const auto lock = lock_swapchain();
+        return m_present_queue.presentKHR(present_info);
+    }();
+
+    if (m_present_waiter.has_value() &&
+        (present_result == vk::Result::eSuccess ||
+         present_result == vk::Result::eSuboptimalKHR))
+    {
+        m_present_waiter->wait_for(*m_swapchain.swapchain,
+                                   present_id,
+                                   m_input_samples[m_current_frame]->time);
+    }
+
+    if (present_result == vk::Result::eErrorOutOfDateKHR)
+    {
+        recreate_swapchain();
+    }
+    else if (present_result != vk::Result::eSuccess &&
+             present_result != vk::Result::eSuboptimalKHR)
+    {
+        throw std::runtime_error("Failed to present swapchain image");
+    }
+    else if ((present_result == vk::Result::eSuboptimalKHR ||
+              m_swapchain_outdated) &&
+             std::chrono::steady_clock::now() - m_last_resize_time >=
+                 g_resize_settle_time)
+    {
+        recreate_swapchain();
+    }
+}
+
+void Renderer::write_last_frame_to_png(const std::filesystem::path &path)
+{
+    if (!m_headless)
+    {
+        throw std::runtime_error(
+            "Frames can only be written back in headless mode");
+    }
+    if (m_frame_number == 0)
+    {
+        throw std::runtime_error("No frame has been rendered yet");
+    }
+
+    wait_for_frame(m_frame_number - 1);
+
+    // The final barriers of the frame graph left it in this layout
+    write_image_to_png(m_device,
+                       m_physical_device,
+                       m_command_pool,
+                       m_graphics_queue,
+                       m_swapchain_images[m_last_image_index],
+                       m_swapchain.extent.width,
+                       m_swapchain.extent.height,
+                       vk::ImageLayout::eTransferSrcOptimal,
+                       vk::PipelineStageFlagBits::eTransfer,
+                       {},
+                       path.string().c_str());
 }
 
-void Renderer::record_command_buffer(std::uint32_t image_index,
-                                     const Push_constants &push_constants)
+void Renderer::start_capture(const std::filesystem::path &path)
 {
-    const auto &command_buffer = m_draw_command_buffers[m_current_frame];
+    if (m_frame_encoder.has_value())
+    {
+        stop_capture();
+    }
 
-    command_buffer.begin({});
+    const auto pixel_order = capture_pixel_order(m_swapchain.format);
+    if (!(m_swapchain.image_usage & vk::ImageUsageFlagBits::eTransferSrc) ||
+        !pixel_order.has_value())
+    {
+        throw std::runtime_error("The swapchain images cannot be captured");
+    }
+
+    m_capture_extent = m_swapchain.extent;
+    m_capture_buffers =
+        create_capture_buffers(m_device, m_physical_device, m_capture_extent);
+    m_capture_copied_count = 0;
+    m_capture_queued_count = 0;
+    m_capture_dropped_count = 0;
+    m_frame_encoder.emplace(path,
+                            m_capture_extent.width,
+                            m_capture_extent.height,
+                            *pixel_order,
+                            g_capture_frame_rate);
+
+    // The frames in flight were recorded with the other graph, which leaves
+    // the images in the same final usage
+    m_frame_graph.graph.set_side_effects(m_frame_graph.capture_pass, true);
+    m_frame_graph.compiled = m_frame_graph.graph.compile();
+}
 
-    // Offscreen pass
+void Renderer::stop_capture()
+{
+    if (!m_frame_encoder.has_value())
     {
-        constexpr vk::ClearValue clear_color_value {
-            .color = {{{0.0f, 0.0f, 0.0f, 1.0f}}}};
+        return;
+    }
 
-        const vk::RenderPassBeginInfo render_pass_begin_info {
-            .renderPass = *m_offscreen_render_pass,
-            .framebuffer = *m_offscreen_framebuffer,
-            .renderArea = {.offset = {0, 0},
-                           .extent = {m_offscreen_width, m_offscreen_height}},
-            .clearValueCount = 1,
-            .pClearValues = &clear_color_value};
+    if (m_frame_number > 0)
+    {
+        wait_for_frame(m_frame_number - 1);
+    }
+    encode_captured_frames(m_frame_number);
 
-        command_buffer.beginRenderPass(render_pass_begin_info,
-                                       vk::SubpassContents::eInline);
+    const auto encoded_count = m_frame_encoder->encoded_frame_count();
+    // Joins the workers once they have encoded every frame
+    m_frame_encoder.reset();
+    m_capture_buffers.clear();
 
-        command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
-                                          *m_offscreen_pipeline_layout,
-                                          0,
-                                          m_offscreen_descriptor_set,
-                                          {});
+    m_frame_graph.graph.set_side_effects(m_frame_graph.capture_pass, false);
+    m_frame_graph.compiled = m_frame_graph.graph.compile();
 
-        command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics,
-                                    *m_offscreen_pipeline);
+    std::cout << "Captured " << encoded_count << " frames, dropped "
+              << m_capture_dropped_count << '\n';
+}
 
-        command_buffer.bindVertexBuffers(
-            0, *m_offscreen_vertex_buffer.buffer, {0});
+void Renderer::record_capture_copy(
+    const vk::raii::CommandBuffer &command_buffer, std::uint32_t image_index)
+{
+    const auto index = m_capture_copied_count % g_capture_buffer_count;
 
-        command_buffer.bindIndexBuffer(
-            *m_offscreen_index_buffer.buffer, 0, vk::IndexType::eUint16);
+    // Headless frames are not shown, waiting keeps every frame
+    if (m_headless)
+    {
+        m_capture_buffers_encoding[index].wait(true, std::memory_order_acquire);
+    }
 
-        command_buffer.pushConstants<Push_constants>(
-            *m_offscreen_pipeline_layout,
-            vk::ShaderStageFlagBits::eFragment,
-            0,
-            {push_constants});
+    if (m_swapchain.extent != m_capture_extent ||
+        m_capture_copied_count - m_capture_queued_count ==
+            g_capture_buffer_count ||
+        m_capture_buffers_encoding[index].load(std::memory_order_acquire))
+    {
+        ++m_capture_dropped_count;
+        return;
+    }
 
-        command_buffer.drawIndexed(
-            static_cast<std::uint32_t>(m_vertex_array.indices.size()),
-            1,
-            0,
-            0,
-            0);
+    auto &capture_buffer = m_capture_buffers[index];
+    capture_buffer.frame_number = m_frame_number;
+    ++m_capture_copied_count;
+
+    // The graph's barriers put the image in transfer_src before the capture
+    // pass, and back to its final usage after it
+    command_copy_image_to_buffer(command_buffer,
+                                 m_swapchain_images[image_index],
+                                 *capture_buffer.buffer.buffer,
+                                 m_capture_extent.width,
+                                 m_capture_extent.height);
+
+    const vk::MemoryBarrier host_barrier {
+        .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+        .dstAccessMask = vk::AccessFlagBits::eHostRead};
+    command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                                   vk::PipelineStageFlagBits::eHost,
+                                   {},
+                                   host_barrier,
+                                   {},
+                                   {});
+}
+
+void Renderer::encode_captured_frames(std::uint64_t retired_frame_count)
+{
+    while (m_capture_queued_count < m_capture_copied_count)
+    {
+        const auto index = m_capture_queued_count % g_capture_buffer_count;
+        const auto &capture_buffer = m_capture_buffers[index];
+        if (capture_buffer.frame_number >= retired_frame_count)
+        {
+            break;
+        }
 
-        command_buffer.endRenderPass();
+        auto &encoding = m_capture_buffers_encoding[index];
+        encoding.store(true, std::memory_order_relaxed);
+        m_frame_encoder->encode(
+            capture_buffer.mapped,
+            [&encoding]
+            {
+                encoding.store(false, std::memory_order_release);
+                encoding.notify_one();
+            });
+        ++m_capture_queued_count;
     }
+}
 
-    // NOTE: explicit synchronization not required between the render
-    // passes, as it is done implicitly via subpass dependencies
+void Renderer::read_input_latencies(std::uint64_t retired_frame_count)
+{
+    if (m_present_waiter.has_value())
+    {
+        for (const auto latency : m_present_waiter->take_latencies())
+        {
+            m_input_latencies.push(latency);
+        }
+        return;
+    }
 
-    // Final pass
+    const auto now = std::chrono::steady_clock::now();
+    for (auto &sample : m_input_samples)
     {
-        constexpr vk::ClearValue clear_color_value {
-            .color = {{{0.0f, 0.0f, 0.0f, 1.0f}}}};
+        if (sample.has_value() && sample->frame_number < retired_frame_count)
+        {
+            const std::chrono::duration<float, std::milli> latency {
+                now - sample->time};
+            m_input_latencies.push(latency.count());
+            sample.reset();
+        }
+    }
+}
 
-        const vk::RenderPassBeginInfo render_pass_begin_info {
-            .renderPass = *m_render_pass,
-            .framebuffer = *m_framebuffers[image_index],
-            .renderArea = {.offset = {0, 0}, .extent = m_swapchain.extent},
-            .clearValueCount = 1,
-            .pClearValues = &clear_color_value};
+std::unique_lock<std::mutex> Renderer::lock_swapchain()
+{
+    return m_present_waiter.has_value() ? m_present_waiter->lock_swapchain()
+                                        : std::unique_lock<std::mutex> {};
+}
 
-        command_buffer.beginRenderPass(render_pass_begin_info,
-                                       vk::SubpassContents::eInline);
+glm::vec2
+Renderer::offscreen_cursor_position(const glm::vec2 &cursor_position) const
+{
+    const auto [offset_x, offset_y] = viewport_offset(m_offscreen_width,
+                                                      m_offscreen_height,
+                                                      m_framebuffer_width,
+                                                      m_framebuffer_height);
+    const auto [extent_x, extent_y] = viewport_extent(m_offscreen_width,
+                                                      m_offscreen_height,
+                                                      m_framebuffer_width,
+                                                      m_framebuffer_height);
+    const auto normalized = (cursor_position - glm::vec2 {offset_x, offset_y}) /
+                            glm::vec2 {extent_x, extent_y};
+    return normalized * glm::vec2 {m_offscreen_width, m_offscreen_height};
+}
 
-        command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
-                                          *m_pipeline_layout,
-                                          0,
-                                          m_descriptor_sets[m_current_frame],
-                                          {});
+void Renderer::write_input_descriptors()
+{
+    for (std::size_t i {}; i < g_max_frames_in_flight; ++i)
+    {
+        const vk::DescriptorBufferInfo buffer_info {
+            .buffer = *m_input_buffers[i].buffer.buffer,
+            .offset = 0,
+            .range = sizeof(Latched_input)};
+
+        const vk::WriteDescriptorSet descriptor_write {
+            .dstSet = m_offscreen_descriptor_sets[i],
+            .dstBinding = 1,
+            .dstArrayElement = 0,
+            .descriptorCount = 1,
+            .descriptorType = vk::DescriptorType::eUniformBuffer,
+            .pBufferInfo = &buffer_info};
 
-        command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics,
-                                    *m_pipeline);
+        m_device.updateDescriptorSets(descriptor_write, {});
+    }
+}
 
-        command_buffer.draw(4, 1, 0, 0);
+void Renderer::record_barriers(const vk::raii::CommandBuffer &command_buffer,
+                               std::span<const Render_barrier> barriers,
+                               std::uint32_t image_index) const
+{
+    if (barriers.empty())
+    {
+        return;
+    }
 
-#ifdef ENABLE_DEBUG_UI
-        ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), *command_buffer);
-#endif
+    vk::PipelineStageFlags src_stage_mask {};
+    vk::PipelineStageFlags dst_stage_mask {};
+    std::vector<vk::ImageMemoryBarrier> memory_barriers;
+    memory_barriers.reserve(barriers.size());
+
+    for (const auto &barrier : barriers)
+    {
+        auto before = usage_scope(barrier.before);
+        const auto after = usage_scope(barrier.after);
+
+        // Nothing to wait for, except the stage the swapchain image
+        // acquisition semaphore waits on, which is where the image is first
+        // used
+        if (barrier.before == Resource_usage::undefined)
+        {
+            before.stage = after.stage;
+        }
 
-        command_buffer.endRenderPass();
+        src_stage_mask |= before.stage;
+        dst_stage_mask |= after.stage;
+
+        memory_barriers.push_back(
+            {.srcAccessMask = before.access,
+             .dstAccessMask = after.access,
+             .oldLayout = barrier.discard ? vk::ImageLayout::eUndefined
+                                          : before.layout,
+             .newLayout = after.layout,
+             .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+             .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+             .image = graph_image(barrier.resource, image_index),
+             .subresourceRange = {.aspectMask = vk::ImageAspectFlagBits::eColor,
+                                  .baseMipLevel = 0,
+                                  .levelCount = 1,
+                                  .baseArrayLayer = 0,
+                                  .layerCount = 1}});
     }
 
-    command_buffer.end();
+    command_buffer.pipelineBarrier(
+        src_stage_mask, dst_stage_mask, {}, {}, {}, memory_barriers);
+}
+
+vk::Image Renderer::graph_image(Render_resource resource,
+                                std::uint32_t image_index) const
+{
+    if (resource == m_frame_graph.swapchain_image)
+    {
+        return m_swapchain_images[image_index];
+    }
+    return *m_frame_graph.images[resource]->image;
 }
 
 void Renderer::recreate_swapchain()
 {
+    m_swapchain_outdated = false;
     if (m_framebuffer_width == 0 || m_framebuffer_height == 0)
     {
         return;
     }
 
-    m_device.waitIdle();
+    // The frames in flight keep rendering to the old images, which are
+    // destroyed once they have retired. The current frame may have been
+    // submitted already.
+    const auto last_frame_number = m_frame_number;
+
+    // The old swapchain is retired, its remaining presents are not measured
+    if (m_present_waiter.has_value())
+    {
+        m_present_waiter->abandon();
+    }
 
-    m_swapchain = create_swapchain(m_device,
-                                   m_physical_device,
-                                   *m_surface,
-                                   m_queue_family_indices,
-                                   m_framebuffer_width,
-                                   m_framebuffer_height);
+    const auto old_format = m_swapchain.format;
+#ifdef ENABLE_DEBUG_UI
+    const auto old_min_image_count = m_swapchain.min_image_count;
+#endif
+
+    auto swapchain = create_swapchain(m_device,
+                                      m_physical_device,
+                                      *m_surface,
+                                      m_queue_family_indices,
+                                      m_framebuffer_width,
+                                      m_framebuffer_height,
+                                      m_present_mode,
+                                      *m_swapchain.swapchain);
+    m_deletion_queue.push(last_frame_number, std::move(m_swapchain.swapchain));
+    m_deletion_queue.push(last_frame_number,
+                          std::move(m_swapchain_image_views));
+    m_swapchain = std::move(swapchain);
     m_swapchain_images = get_swapchain_images(m_swapchain.swapchain);
     m_swapchain_image_views = create_swapchain_image_views(
         m_device, m_swapchain_images, m_swapchain.format);
-    m_render_pass = create_render_pass(m_device, m_swapchain.format);
-    m_pipeline_layout =
-        create_pipeline_layout(m_device, m_descriptor_set_layout);
-    m_pipeline = create_pipeline(m_device,
-                                 g_final_vertex_shader_path,
-                                 g_final_fragment_shader_path,
-                                 viewport_offset(m_offscreen_width,
-                                                 m_offscreen_height,
-                                                 m_swapchain.extent.width,
-                                                 m_swapchain.extent.height),
-                                 viewport_extent(m_offscreen_width,
-                                                 m_offscreen_height,
-                                                 m_swapchain.extent.width,
-                                                 m_swapchain.extent.height),
-                                 {m_framebuffer_width, m_framebuffer_height},
-                                 *m_pipeline_layout,
-                                 *m_render_pass);
-    m_framebuffers = create_framebuffers(m_device,
-                                         m_swapchain_image_views,
-                                         *m_render_pass,
-                                         m_swapchain.extent.width,
-                                         m_swapchain.extent.height);
+
+#ifdef ENABLE_DEBUG_UI
+    // Waits for the device to be idle, but the count rarely changes
+    if (m_swapchain.min_image_count != old_min_image_count)
+    {
+        ImGui_ImplVulkan_SetMinImageCount(m_swapchain.min_image_count);
+    }
+#endif
+
+    // Viewport and scissor are dynamic, so the render pass and the pipelines
+    // only depend on the format
+    if (m_swapchain.format != old_format)
+    {
+#ifdef ENABLE_HOT_RELOAD
+        constexpr auto final_program =
+            static_cast<std::size_t>(Shader_program::final);
+
+        // The pending pipelines target the old format, and the render pass
+        // that is about to be destroyed. They are rebuilt from disk for the
+        // new format at the next frame.
+        if (m_pending_programs[final_program].has_value())
+        {
+            m_pending_programs[final_program]->wait();
+            m_pending_programs[final_program].reset();
+            m_dirty_programs[final_program] = true;
+        }
+#endif
+
+        // Variants being built on worker threads target them too, they are
+        // requested again on their next use
+        for (auto it = m_pending_pipelines.begin();
+             it != m_pending_pipelines.end();)
+        {
+            if (it->first.program != Shader_program::final)
+            {
+                ++it;
+                continue;
+            }
+            it->second.pipeline.wait();
+            it = m_pending_pipelines.erase(it);
+        }
+
+        if (m_rendering_path == Rendering_path::render_pass)
+        {
+            m_deletion_queue.push(last_frame_number, std::move(m_render_pass));
+            m_render_pass = create_render_pass(m_device, m_swapchain.format);
+        }
+        for (const auto &state : invalidate_pipelines(Shader_program::final))
+        {
+            prewarm_pipeline(state);
+        }
+    }
+
+    // With dynamic rendering, the passes render to the image views directly
+    if (m_rendering_path == Rendering_path::render_pass)
+    {
+        m_deletion_queue.push(last_frame_number, std::move(m_framebuffers));
+        m_framebuffers = create_framebuffers(m_device,
+                                             m_swapchain_image_views,
+                                             *m_render_pass,
+                                             m_swapchain.extent.width,
+                                             m_swapchain.extent.height);
+    }
 }
 
 void Renderer::resize_framebuffer(std::uint32_t width, std::uint32_t height)
 {
-    m_framebuffer_resized = true;
+    m_swapchain_outdated = true;
+    m_last_resize_time = std::chrono::steady_clock::now();
     m_framebuffer_width = width;
     m_framebuffer_height = height;
 }
 
-void Renderer::draw_frame(const glm::vec2 &mouse_position)
+void Renderer::set_present_mode(Present_mode present_mode)
+{
+    if (present_mode != m_present_mode)
+    {
+        m_present_mode = present_mode;
+        m_swapchain_outdated = true;
+    }
+}
+
+void Renderer::set_frames_in_flight(std::uint32_t frames_in_flight)
 {
+    if (frames_in_flight < g_min_frames_in_flight ||
+        frames_in_flight > g_max_frames_in_flight)
+    {
+        throw std::runtime_error("Invalid number of frames in flight");
+    }
+    m_requested_frames_in_flight = frames_in_flight;
+}
+
 #ifdef ENABLE_DEBUG_UI
+void Renderer::build_debug_ui()
+{
+    const Profile_zone zone {"Build UI"};
+
     ImGui_ImplVulkan_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
@@ -1985,56 +4218,236 @@ void Renderer::draw_frame(const glm::vec2 &mouse_position)
                     scale);
         ImGui::Text(
             "Framebuffer: %d x %d", m_framebuffer_width, m_framebuffer_height);
+
+        auto present_mode = static_cast<int>(m_present_mode);
+        if (ImGui::Combo("Present mode",
+                         &present_mode,
+                         "FIFO\0FIFO relaxed\0Mailbox\0Immediate\0"))
+        {
+            set_present_mode(static_cast<Present_mode>(present_mode));
+        }
+        if (m_swapchain.present_mode != m_present_mode)
+        {
+            ImGui::Text("Not supported, using %s",
+                        present_mode_name(m_swapchain.present_mode).data());
+        }
+        auto frames_in_flight = static_cast<int>(m_requested_frames_in_flight);
+        if (ImGui::SliderInt("Frames in flight",
+                             &frames_in_flight,
+                             static_cast<int>(g_min_frames_in_flight),
+                             static_cast<int>(g_max_frames_in_flight),
+                             "%d",
+                             ImGuiSliderFlags_AlwaysClamp))
+        {
+            set_frames_in_flight(static_cast<std::uint32_t>(frames_in_flight));
+        }
+        constexpr const char *rendering_path_names[] {
+            "render passes", "dynamic rendering", "VK_KHR_dynamic_rendering"};
+        ImGui::Text("Rendering path: %s",
+                    rendering_path_names[static_cast<std::size_t>(
+                        m_rendering_path)]);
+        ImGui::Text("Pipeline creation: %.2f ms",
+                    m_pipeline_creation_time.count());
+        ImGui::Text("Pipeline variants: %zu (%zu building), %llu hits, "
+                    "%llu misses",
+                    m_pipelines.size(),
+                    m_pending_pipelines.size(),
+                    static_cast<unsigned long long>(m_pipeline_variant_hits),
+                    static_cast<unsigned long long>(m_pipeline_variant_misses));
+
+        bool cursor_highlight {(m_offscreen_pipeline_state.features &
+                                shader_feature_cursor_highlight) != 0};
+        if (ImGui::Checkbox("Cursor highlight", &cursor_highlight))
+        {
+            m_offscreen_pipeline_state.features ^=
+                shader_feature_cursor_highlight;
+        }
+        auto blend_mode =
+            static_cast<int>(m_offscreen_pipeline_state.blend_mode);
+        if (ImGui::Combo(
+                "Blend mode", &blend_mode, "Opaque\0Alpha\0Additive\0"))
+        {
+            m_offscreen_pipeline_state.blend_mode =
+                static_cast<Blend_mode>(blend_mode);
+        }
+        ImGui::Text("Textures: %zu resident, %.1f / %.1f MiB",
+                    m_texture_streamer.resident_count(),
+                    static_cast<double>(m_texture_streamer.resident_size()) /
+                        (1024.0 * 1024.0),
+                    static_cast<double>(m_texture_streamer.budget()) /
+                        (1024.0 * 1024.0));
+        // Unchecking with a budget below the size of the texture evicts it
+        auto texture_budget = static_cast<int>(m_texture_streamer.budget() /
+                                               (1024 * 1024));
+        if (ImGui::SliderInt("Texture budget (MiB)",
+                             &texture_budget,
+                             0,
+                             1024,
+                             "%d",
+                             ImGuiSliderFlags_AlwaysClamp))
+        {
+            m_texture_streamer.set_budget(
+                static_cast<std::uint64_t>(texture_budget) * 1024 * 1024);
+        }
+        ImGui::Checkbox("Full-resolution textures", &m_stream_full_textures);
+
+        const auto &compiled_graph = m_frame_graph.compiled;
+        std::size_t barrier_count {compiled_graph.final_barriers.size()};
+        for (const auto &pass : compiled_graph.passes)
+        {
+            barrier_count += pass.barriers.size();
+        }
+        ImGui::Text("Render graph: %zu passes (%zu culled), %zu barriers, "
+                    "%zu memory slots",
+                    compiled_graph.passes.size(),
+                    compiled_graph.culled_pass_count,
+                    barrier_count,
+                    compiled_graph.memory_slots.size());
+
+        if (m_timestamp_period > 0.0f)
+        {
+            constexpr const char *gpu_pass_names[] {
+                "Offscreen", "Final", "ImGui"};
+            for (std::size_t i {}; i < g_gpu_pass_count; ++i)
+            {
+                plot_timing_history(gpu_pass_names[i], m_gpu_pass_times[i]);
+            }
+        }
+        else
+        {
+            ImGui::TextUnformatted("GPU timestamps not supported");
+        }
+
+        if (m_frame_encoder.has_value())
+        {
+            ImGui::Text("Capturing: %llu frames encoded, %llu dropped",
+                        static_cast<unsigned long long>(
+                            m_frame_encoder->encoded_frame_count()),
+                        static_cast<unsigned long long>(
+                            m_capture_dropped_count));
+        }
+
+        if (m_picked_sprite.has_value())
+        {
+            ImGui::Text("Sprite under the cursor: %u", *m_picked_sprite);
+        }
+        else
+        {
+            ImGui::TextUnformatted("No sprite under the cursor");
+        }
+
+        ImGui::Checkbox("Late input latching", &m_late_input_latching);
+        plot_timing_history(m_present_waiter.has_value()
+                                ? "Input to present"
+                                : "Input to GPU completion",
+                            m_input_latencies);
+
+        // The frame in progress is still being recorded
+        ImGui::TextUnformatted("CPU zones, last frame:");
+        draw_flame_graph(profiler_frames(1));
     }
     ImGui::End();
 
     ImGui::Render();
+}
 #endif
 
-    const auto wait_result = m_device.waitForFences(
-        *m_sync_objects.in_flight_fences[m_current_frame],
-        VK_TRUE,
-        std::numeric_limits<std::uint64_t>::max());
-    if (wait_result != vk::Result::eSuccess)
+void Renderer::draw_frame(const Cursor_sampler &sample_cursor,
+                          std::span<const Sprite> sprites)
+{
+    // Sampled again right before submitting with late input latching
+    auto input_sample_time = std::chrono::steady_clock::now();
+    auto cursor_position = sample_cursor();
+
+#ifdef ENABLE_DEBUG_UI
+    if (!m_headless)
     {
-        throw std::runtime_error("Error while waiting for fences");
+        build_debug_ui();
     }
+#endif
 
-    const auto &[result, image_index] = m_swapchain.swapchain.acquireNextImage(
-        std::numeric_limits<std::uint64_t>::max(),
-        *m_sync_objects.image_available_semaphores[m_current_frame]);
+    // The slots in use change, so every frame in flight must have retired
+    if (m_requested_frames_in_flight != m_frames_in_flight)
+    {
+        if (m_frame_number > 0)
+        {
+            wait_for_frame(m_frame_number - 1);
+        }
+        m_frames_in_flight = m_requested_frames_in_flight;
+        m_current_frame = 0;
+    }
 
-    if (result == vk::Result::eErrorOutOfDateKHR)
+    // Wait for the frame that last used this slot
+    if (m_frame_number >= m_frames_in_flight)
     {
-        recreate_swapchain();
-        return;
+        wait_for_frame(m_frame_number - m_frames_in_flight);
     }
-    else if (result != vk::Result::eSuccess &&
-             result != vk::Result::eSuboptimalKHR)
+
+    read_gpu_timestamps();
+
+    // Frames may have retired after the one waited for
+    if (const auto retired_frame_count =
+            m_sync_objects.frame_timeline.getCounterValue();
+        retired_frame_count > 0)
     {
-        throw std::runtime_error("Failed to acquire swapchain image");
+        m_deletion_queue.collect(retired_frame_count - 1);
+        read_input_latencies(retired_frame_count);
+        if (m_frame_encoder.has_value())
+        {
+            encode_captured_frames(retired_frame_count);
+        }
     }
 
-    const auto [offset_x, offset_y] = viewport_offset(m_offscreen_width,
-                                                      m_offscreen_height,
-                                                      m_framebuffer_width,
-                                                      m_framebuffer_height);
-    const auto [extent_x, extent_y] = viewport_extent(m_offscreen_width,
-                                                      m_offscreen_height,
-                                                      m_framebuffer_width,
-                                                      m_framebuffer_height);
-    const auto offscreen_mouse_normalized =
-        (mouse_position - glm::vec2 {offset_x, offset_y}) /
-        glm::vec2 {extent_x, extent_y};
-    const auto offscreen_mouse_pos =
-        offscreen_mouse_normalized *
-        glm::vec2 {m_offscreen_width, m_offscreen_height};
+    // A failed capture is not fatal
+    if (m_frame_encoder.has_value())
+    {
+        if (const auto error = m_frame_encoder->error(); error.has_value())
+        {
+            std::cerr << "Capture failed: " << *error << '\n';
+            stop_capture();
+        }
+    }
+
+    collect_pipelines();
+
+#ifdef ENABLE_HOT_RELOAD
+    process_hot_reload();
+#endif
+
+    // Headless, each frame slot has its own image
+    auto image_index = m_current_frame;
+    if (!m_headless)
+    {
+        const auto [result, acquired_image_index] = [this]
+        {
+            const Profile_zone zone {"Acquire"};
+            const auto lock = lock_swapchain();
+            return m_swapchain.swapchain.acquireNextImage(
+                std::numeric_limits<std::uint64_t>::max(),
+                *m_sync_objects.image_available_semaphores[m_current_frame]);
+        }();
+
+        if (result == vk::Result::eErrorOutOfDateKHR)
+        {
+            recreate_swapchain();
+            return;
+        }
+        else if (result != vk::Result::eSuccess &&
+                 result != vk::Result::eSuboptimalKHR)
+        {
+            throw std::runtime_error("Failed to acquire swapchain image");
+        }
+        image_index = acquired_image_index;
+    }
+    m_last_image_index = image_index;
+
     const Push_constants push_constants {
         .resolution = {static_cast<float>(m_offscreen_width),
-                       static_cast<float>(m_offscreen_height)},
-        .mouse_position = offscreen_mouse_pos};
+                       static_cast<float>(m_offscreen_height)}};
+
+    write_sprites(sprites);
 
-    m_device.resetFences(*m_sync_objects.in_flight_fences[m_current_frame]);
+    update_streamed_textures();
 
     m_draw_command_buffers[m_current_frame].reset();
 
@@ -2043,40 +4456,59 @@ void Renderer::draw_frame(const glm::vec2 &mouse_position)
     const vk::PipelineStageFlags wait_stages[] {
         vk::PipelineStageFlagBits::eColorAttachmentOutput};
 
+    // The binary semaphores come last, headless frames only signal the
+    // timeline
+    const vk::Semaphore signal_semaphores[] {
+        *m_sync_objects.frame_timeline,
+        *m_sync_objects.render_finished_semaphores[m_current_frame]};
+    const std::uint32_t binary_semaphore_count {m_headless ? 0u : 1u};
+
+    // The value is ignored for the binary semaphores
+    const std::uint64_t wait_values[] {0};
+    const std::uint64_t signal_values[] {m_frame_number + 1, 0};
+
+    const vk::TimelineSemaphoreSubmitInfo timeline_submit_info {
+        .waitSemaphoreValueCount = binary_semaphore_count,
+        .pWaitSemaphoreValues = wait_values,
+        .signalSemaphoreValueCount = 1 + binary_semaphore_count,
+        .pSignalSemaphoreValues = signal_values};
+
     const vk::SubmitInfo submit_info {
-        .waitSemaphoreCount = 1,
+        .pNext = &timeline_submit_info,
+        .waitSemaphoreCount = binary_semaphore_count,
         .pWaitSemaphores =
             &*m_sync_objects.image_available_semaphores[m_current_frame],
         .pWaitDstStageMask = wait_stages,
         .commandBufferCount = 1,
         .pCommandBuffers = &*m_draw_command_buffers[m_current_frame],
-        .signalSemaphoreCount = 1,
-        .pSignalSemaphores =
-            &*m_sync_objects.render_finished_semaphores[m_current_frame]};
-
-    m_graphics_queue.submit(submit_info,
-                            *m_sync_objects.in_flight_fences[m_current_frame]);
-
-    const vk::PresentInfoKHR present_info {
-        .waitSemaphoreCount = 1,
-        .pWaitSemaphores =
-            &*m_sync_objects.render_finished_semaphores[m_current_frame],
-        .swapchainCount = 1,
-        .pSwapchains = &*m_swapchain.swapchain,
-        .pImageIndices = &image_index};
+        .signalSemaphoreCount = 1 + binary_semaphore_count,
+        .pSignalSemaphores = signal_semaphores};
 
-    const auto present_result = m_present_queue.presentKHR(present_info);
+    // The frame that last read this slot's input buffer has retired
+    if (m_late_input_latching)
+    {
+        input_sample_time = std::chrono::steady_clock::now();
+        cursor_position = sample_cursor();
+    }
+    const auto offscreen_cursor = offscreen_cursor_position(cursor_position);
+    m_input_buffers[m_current_frame].mapped->mouse_position = offscreen_cursor;
+    m_cursor_sprite_position =
+        offscreen_cursor /
+            glm::vec2 {m_offscreen_width, m_offscreen_height} * 2.0f -
+        1.0f;
+    m_input_samples[m_current_frame] = {.frame_number = m_frame_number,
+                                        .time = input_sample_time};
 
-    if (present_result == vk::Result::eErrorOutOfDateKHR ||
-        present_result == vk::Result::eSuboptimalKHR || m_framebuffer_resized)
     {
-        recreate_swapchain();
-        m_framebuffer_resized = false;
+        const Profile_zone zone {"Submit"};
+        m_graphics_queue.submit(submit_info);
     }
-    else if (present_result != vk::Result::eSuccess)
+
+    if (!m_headless)
     {
-        throw std::runtime_error("Failed to present swapchain image");
+        present(image_index);
     }
 
-    m_current_frame = (m_current_frame + 1) % g_max_frames_in_flight;
+    m_current_frame = (m_current_frame + 1) % m_frames_in_flight;
+    ++m_frame_number;
 }
@@ -29,8 +29,32 @@
 #pragma GCC diagnostic pop
 #endif
 
+#include "asset_registry.hpp"
+#include "config.hpp"
+#include "deletion_queue.hpp"
+#include "file_watcher.hpp"
+#include "frame_encoder.hpp"
+#include "job_system.hpp"
+#include "present_waiter.hpp"
+#include "render_graph.hpp"
+#include "spirv_reflection.hpp"
+#include "sprite.hpp"
+#include "texture_streamer.hpp"
+#include "timing_history.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #ifndef NDEBUG
@@ -39,6 +63,10 @@
 
 #define ENABLE_DEBUG_UI
 
+#ifndef NDEBUG
+#define ENABLE_HOT_RELOAD
+#endif
+
 struct Queue_family_indices
 {
     std::uint32_t graphics;
@@ -51,6 +79,10 @@ struct Vulkan_swapchain
     vk::Format format;
     vk::Extent2D extent;
     std::uint32_t min_image_count;
+    // Includes transfer_src if the surface supports it, to capture frames
+    vk::ImageUsageFlags image_usage;
+    // May differ from the requested one if the surface does not support it
+    Present_mode present_mode;
 };
 
 struct Vulkan_image
@@ -66,6 +98,47 @@ struct Vulkan_buffer
     vk::raii::DeviceMemory memory;
 };
 
+struct Texture_data
+{
+    std::vector<std::uint8_t> pixels;
+    std::uint32_t width;
+    std::uint32_t height;
+};
+
+struct Decoded_texture
+{
+    // Of the file that was decoded
+    Asset_hash hash;
+    Texture_data full;
+    Texture_data placeholder;
+};
+
+struct Pending_texture_reload
+{
+    Texture_id id;
+    std::unique_ptr<Long_job<Decoded_texture>> texture;
+};
+
+// The full-resolution image is decoded by a long job on first use, then
+// uploaded, and replaces the placeholder once the upload has retired
+struct Streamed_texture
+{
+    std::string path;
+    // Of the current content, names its entries in the asset cache
+    Asset_hash hash;
+    // Of the texture in the asset registry. The hash of the content, unless
+    // the file was edited into a copy of another texture.
+    Asset_hash registry_hash;
+    Vulkan_image placeholder;
+    std::optional<Vulkan_image> full;
+    std::unique_ptr<Long_job<Texture_data>> loading;
+    std::optional<Vulkan_image> uploading;
+    // The upload was submitted before this frame
+    std::uint64_t upload_frame;
+    // Incremented each time the image to sample changes
+    std::uint64_t generation;
+};
+
 struct Vertex
 {
     glm::vec3 pos;
@@ -78,53 +151,463 @@ struct Vertex_array
     std::vector<std::uint16_t> indices;
 };
 
+// Sprites are drawn in batches of this many quads, whose vertices can be
+// addressed by 16-bit indices
+inline constexpr std::uint32_t g_sprite_batch_size {16384};
+
+// Persistently mapped, host-coherent, rewritten each frame
+struct Sprite_buffer
+{
+    Vulkan_buffer buffer;
+    Vertex *mapped;
+    // In sprites, of 4 vertices each
+    std::uint32_t capacity;
+};
+
+// Image whose memory is owned by a Frame_graph and may be shared with other
+// transient images
+struct Transient_image
+{
+    vk::raii::Image image;
+    vk::raii::ImageView view;
+};
+
+// The passes of a frame and the images they use
+struct Frame_graph
+{
+    Render_graph graph;
+    Compiled_render_graph compiled;
+    Render_pass_id offscreen_pass;
+    Render_pass_id final_pass;
+    // Copies the swapchain image back, culled unless capturing
+    Render_pass_id capture_pass;
+    Render_resource offscreen_color;
+    Render_resource swapchain_image;
+    // One allocation per memory slot of the compiled graph
+    std::vector<vk::raii::DeviceMemory> memory;
+    // Indexed by resource, empty for imported and culled resources
+    std::vector<std::optional<Transient_image>> images;
+};
+
+enum class Rendering_path : std::uint8_t
+{
+    // Render pass and framebuffer objects
+    render_pass,
+    // Vulkan 1.3
+    dynamic_rendering,
+    // VK_KHR_dynamic_rendering, on Vulkan 1.2 devices
+    dynamic_rendering_khr
+};
+
+// Written in order in each frame's command buffer
+enum class Gpu_timestamp : std::uint32_t
+{
+    frame_begin,
+    offscreen_end,
+    final_end,
+    ui_end
+};
+
+inline constexpr std::uint32_t g_gpu_timestamp_count {4};
+
+// Measured between consecutive timestamps
+enum class Gpu_pass : std::uint8_t
+{
+    offscreen,
+    final,
+    ui
+};
+
+inline constexpr std::size_t g_gpu_pass_count {3};
+
 struct Sync_objects
 {
+    // Binary semaphores, required by the swapchain
     std::vector<vk::raii::Semaphore> image_available_semaphores;
     std::vector<vk::raii::Semaphore> render_finished_semaphores;
-    std::vector<vk::raii::Fence> in_flight_fences;
+    // Timeline semaphore counting the retired frames: frame N signals N + 1
+    // when it completes
+    vk::raii::Semaphore frame_timeline;
+};
+
+// Resources of a submitted upload, to keep alive until it has completed
+struct Pending_upload
+{
+    vk::raii::CommandBuffer command_buffer;
+    Vulkan_buffer staging_buffer;
+};
+
+struct Texture_upload
+{
+    Vulkan_image image;
+    Pending_upload upload;
 };
 
 struct Push_constants
 {
     glm::vec2 resolution;
+};
+
+// GPU time of each pass of a frame, in milliseconds, indexed by Gpu_pass
+struct Gpu_frame_times
+{
+    std::uint64_t frame_number;
+    std::array<float, g_gpu_pass_count> pass_times;
+};
+
+// Written by the CPU right before submitting the frame that reads it, in
+// offscreen pixels
+struct Latched_input
+{
     glm::vec2 mouse_position;
 };
 
+// Persistently mapped, host-coherent
+struct Input_buffer
+{
+    Vulkan_buffer buffer;
+    Latched_input *mapped;
+};
+
+// When the input of a frame in flight was sampled
+struct Input_sample
+{
+    std::uint64_t frame_number;
+    std::chrono::steady_clock::time_point time;
+};
+
+// Frames copied back while capturing, more than the frames in flight so that
+// the encoder can hold some while the GPU writes the others
+inline constexpr std::uint32_t g_capture_buffer_count {8};
+
+// Of Y4M captures, frames are captured as they are rendered
+inline constexpr std::uint32_t g_capture_frame_rate {60};
+
+// Persistently mapped, a frame is copied into it by the GPU, then read by the
+// encoder threads once the frame has retired
+struct Capture_buffer
+{
+    Vulkan_buffer buffer;
+    const std::uint8_t *mapped;
+    // Of the frame copied into it, until handed to the encoder
+    std::uint64_t frame_number;
+};
+
+// Returns the cursor position in window coordinates
+using Cursor_sampler = std::function<glm::vec2()>;
+
+enum class Shader_program : std::uint8_t
+{
+    offscreen,
+    final
+};
+
+inline constexpr std::size_t g_shader_program_count {2};
+
+enum class Blend_mode : std::uint8_t
+{
+    opaque,
+    alpha,
+    additive
+};
+
+// Bits of Pipeline_state::features. Bit i is passed to the shaders as the
+// boolean specialization constant with constant_id i.
+enum Shader_feature : std::uint32_t
+{
+    shader_feature_cursor_highlight = 1 << 0
+};
+
+inline constexpr std::uint32_t g_shader_feature_count {1};
+
+// Everything that differs between the variants of a pipeline. The vertex
+// input, topology, layout and target are given by the program.
+struct Pipeline_state
+{
+    Shader_program program;
+    Blend_mode blend_mode;
+    std::uint32_t features;
+
+    [[nodiscard]] bool operator==(const Pipeline_state &) const = default;
+};
+
+// What a pipeline renders to. With dynamic rendering, the render pass is
+// null and the pipeline only depends on the attachment format.
+struct Pipeline_target
+{
+    vk::RenderPass render_pass;
+    vk::Format color_attachment_format;
+};
+
+struct Pipeline_state_hash
+{
+    [[nodiscard]] std::size_t
+    operator()(const Pipeline_state &state) const noexcept;
+};
+
+struct Shader_modules
+{
+    vk::raii::ShaderModule vertex;
+    vk::raii::ShaderModule fragment;
+    // Of both stages
+    Shader_reflection reflection;
+};
+
+struct Compiled_pipeline
+{
+    vk::raii::Pipeline pipeline;
+    std::chrono::duration<double, std::milli> creation_time;
+};
+
+struct Pending_pipeline
+{
+    // Keeps the modules alive while the pipeline is being built, and tells
+    // whether they have been hot reloaded in the meantime
+    std::shared_ptr<const Shader_modules> modules;
+    std::unique_ptr<Long_job<Compiled_pipeline>> pipeline;
+};
+
+struct Reloaded_program
+{
+    std::shared_ptr<const Shader_modules> modules;
+    std::vector<std::pair<Pipeline_state, vk::raii::Pipeline>> pipelines;
+};
+
 class Renderer
 {
 public:
+    // Without a window, renders headless: there is no surface, swapchain or
+    // debug UI, and frames are rendered to images owned by the renderer. The
+    // job system must outlive the renderer.
     [[nodiscard]] Renderer(GLFWwindow *window,
                            std::uint32_t width,
-                           std::uint32_t height);
+                           std::uint32_t height,
+                           const Config &config,
+                           Job_system &job_system);
     ~Renderer();
 
     void resize_framebuffer(std::uint32_t width, std::uint32_t height);
 
-    void draw_frame(const glm::vec2 &mouse_position);
+    // The swapchain is recreated at the end of the current frame
+    void set_present_mode(Present_mode present_mode);
+
+    // Applied at the start of the next frame, after waiting for the frames in
+    // flight. Must be between g_min_frames_in_flight and
+    // g_max_frames_in_flight.
+    void set_frames_in_flight(std::uint32_t frames_in_flight);
+
+    // The cursor is sampled once per frame, right before submitting unless
+    // late input latching is disabled. The sprites are copied.
+    void draw_frame(const Cursor_sampler &sample_cursor,
+                    std::span<const Sprite> sprites);
+
+    // The last frame whose timestamps have been read, a frame or more behind
+    // the current one. Empty until then, or if timestamps are not supported.
+    [[nodiscard]] const std::optional<Gpu_frame_times> &
+    last_gpu_frame_times() const noexcept
+    {
+        return m_last_gpu_frame_times;
+    }
+
+    // Waits for the last frame and writes it as PNG. Headless mode only.
+    void write_last_frame_to_png(const std::filesystem::path &path);
+
+    // Copies the following frames into a ring of readback buffers, which are
+    // encoded on worker threads a frame or more later. Frames are dropped
+    // rather than waited for when the ring is full. The format is chosen by
+    // capture_format. Throws std::runtime_error if the frames cannot be
+    // copied or the output cannot be created.
+    void start_capture(const std::filesystem::path &path);
+
+    // Waits for the captured frames to be encoded
+    void stop_capture();
+
+    [[nodiscard]] bool is_capturing() const noexcept
+    {
+        return m_frame_encoder.has_value();
+    }
+
+    // Where the cursor was sampled for the last frame, in the normalized
+    // device coordinates of the sprites
+    [[nodiscard]] glm::vec2 cursor_sprite_position() const noexcept
+    {
+        return m_cursor_sprite_position;
+    }
+
+    // Shown in the debug UI
+    void set_picked_sprite(std::optional<std::uint32_t> sprite) noexcept
+    {
+        m_picked_sprite = sprite;
+    }
+
+    // Textures with identical content share the same id, each call must be
+    // matched by a call to release_texture
+    [[nodiscard]] Texture_id add_texture(const char *path);
+
+    void release_texture(Texture_id id);
+
+    // Starts building the variant on a worker thread, so that content using
+    // it later does not have to wait or fall back
+    void prewarm_pipeline(const Pipeline_state &state);
+
+    // Work submitted before frame N, such as uploads, has completed too once
+    // it has retired
+    [[nodiscard]] bool is_frame_retired(std::uint64_t frame_number) const;
 
 private:
+    void wait_for_frame(std::uint64_t frame_number) const;
+
     void record_command_buffer(std::uint32_t image_index,
                                const Push_constants &push_constants);
 
+    void record_offscreen_pass(const vk::raii::CommandBuffer &command_buffer,
+                               const Push_constants &push_constants);
+
+    void record_final_pass(const vk::raii::CommandBuffer &command_buffer,
+                           std::uint32_t image_index);
+
+    void write_timestamp(const vk::raii::CommandBuffer &command_buffer,
+                         Gpu_timestamp timestamp,
+                         vk::PipelineStageFlagBits stage) const;
+
+    // Reads the timestamps of the last frame that used the current slot,
+    // which has retired
+    void read_gpu_timestamps();
+
+    // Presents the image rendered by the current frame, and recreates the
+    // swapchain if needed
+    void present(std::uint32_t image_index);
+
+    // Copies the swapchain image into the next capture buffer, or drops the
+    // frame if the encoder still holds it
+    void record_capture_copy(const vk::raii::CommandBuffer &command_buffer,
+                             std::uint32_t image_index);
+
+    // Hands the captured frames below retired_frame_count to the encoder, in
+    // order
+    void encode_captured_frames(std::uint64_t retired_frame_count);
+
+    // Records the input latency of the presented frames, or of the frames
+    // below retired_frame_count if presents cannot be waited for
+    void read_input_latencies(std::uint64_t retired_frame_count);
+
+    // Empty without a present waiter
+    [[nodiscard]] std::unique_lock<std::mutex> lock_swapchain();
+
+    [[nodiscard]] glm::vec2
+    offscreen_cursor_position(const glm::vec2 &cursor_position) const;
+
+    // Points the offscreen descriptor sets to the input buffers
+    void write_input_descriptors();
+
+    // Records the barriers of the frame graph as a single pipeline barrier
+    void record_barriers(const vk::raii::CommandBuffer &command_buffer,
+                         std::span<const Render_barrier> barriers,
+                         std::uint32_t image_index) const;
+
+    [[nodiscard]] vk::Image graph_image(Render_resource resource,
+                                        std::uint32_t image_index) const;
+
     [[nodiscard]] static Vertex_array create_vertex_array();
 
+    // Into the current frame's sprite buffer, which grows as needed
+    void write_sprites(std::span<const Sprite> sprites);
+
     [[nodiscard]] Sync_objects create_sync_objects();
 
+    // Hands the old swapchain over to the new one without waiting for the
+    // GPU, its image views and framebuffers are destroyed once the frames in
+    // flight have retired
     void recreate_swapchain();
 
+    [[nodiscard]] vk::ImageView streamed_texture_view(Texture_id id) const;
+
+    // Starts loading the full-resolution image of the textures used by the
+    // current frame, swaps in those that are uploaded and evicts over budget
+    void update_streamed_textures();
+
+    // Returns the variant for the given state. On first use, the variant is
+    // built on a worker thread and the default variant of the program is
+    // returned instead, or a null handle if that one is not ready either.
+    [[nodiscard]] vk::Pipeline get_pipeline(const Pipeline_state &state);
+
+    // Moves the pipelines that finished building into the cache
+    void collect_pipelines();
+
+    // Removes every variant of the program from the cache, they are destroyed
+    // once the frames in flight have retired. Returns their states.
+    std::vector<Pipeline_state> invalidate_pipelines(Shader_program program);
+
+    [[nodiscard]] vk::PipelineLayout
+    pipeline_layout(Shader_program program) const;
+
+    // The layouts are cached, programs with identical bindings share them
+    [[nodiscard]] vk::DescriptorSetLayout
+    get_descriptor_set_layout(const Shader_reflection &reflection,
+                              std::uint32_t set);
+
+    [[nodiscard]] vk::PipelineLayout
+    get_pipeline_layout(const Shader_reflection &reflection);
+
+    [[nodiscard]] Pipeline_target pipeline_target(Shader_program program) const;
+
+    // Begins a render pass or, with dynamic rendering, rendering directly to
+    // the image view. The color attachment is cleared.
+    void begin_rendering(const vk::raii::CommandBuffer &command_buffer,
+                         vk::RenderPass render_pass,
+                         vk::Framebuffer framebuffer,
+                         vk::ImageView color_attachment,
+                         vk::Extent2D extent) const;
+
+    void end_rendering(const vk::raii::CommandBuffer &command_buffer) const;
+
+#ifdef ENABLE_DEBUG_UI
+    // Builds the debug window and ends the ImGui frame
+    void build_debug_ui();
+#endif
+
+#ifdef ENABLE_HOT_RELOAD
+    // Starts rebuilding the pipelines and textures whose files have changed,
+    // and swaps in those that are ready. Must be called at a frame boundary.
+    void process_hot_reload();
+#endif
+
+    bool m_headless;
+    Job_system *m_job_system;
     vk::raii::Context m_context;
     vk::raii::Instance m_instance;
 #ifdef ENABLE_VALIDATION_LAYERS
     vk::raii::DebugUtilsMessengerEXT m_debug_messenger;
 #endif
+    // Null when headless
     vk::raii::SurfaceKHR m_surface;
     vk::raii::PhysicalDevice m_physical_device;
     Queue_family_indices m_queue_family_indices;
+    Rendering_path m_rendering_path;
+    // VK_KHR_present_id and VK_KHR_present_wait are enabled
+    bool m_present_wait;
     vk::raii::Device m_device;
+    vk::raii::PipelineCache m_pipeline_cache;
+    // Time spent creating pipelines on worker threads
+    std::chrono::duration<double, std::milli> m_pipeline_creation_time {};
+    // Indexed by Shader_program
+    std::array<std::shared_ptr<const Shader_modules>, g_shader_program_count>
+        m_shader_modules;
+    // Keyed by their bindings, with the set number zeroed
+    std::map<std::vector<Descriptor_binding>, vk::raii::DescriptorSetLayout>
+        m_descriptor_set_layouts {};
+    std::map<std::pair<std::vector<Descriptor_binding>,
+                       std::optional<Push_constant_range>>,
+             vk::raii::PipelineLayout>
+        m_pipeline_layouts {};
     vk::raii::Queue m_graphics_queue;
     vk::raii::Queue m_present_queue;
+    // Requested, see Vulkan_swapchain::present_mode for the one in use
+    Present_mode m_present_mode;
+    // The swapchain is null when headless
     Vulkan_swapchain m_swapchain;
+    // Stand in for the swapchain images when headless, one per frame in flight
+    std::vector<Vulkan_image> m_headless_images;
     std::vector<vk::Image> m_swapchain_images;
     std::vector<vk::raii::ImageView> m_swapchain_image_views;
     vk::raii::Sampler m_sampler;
@@ -135,33 +618,123 @@ private:
     vk::raii::CommandPool m_command_pool;
     Vertex_array m_vertex_array;
 
+    // Before the textures, uploads in the constructor are retired by frame 0
+    std::uint64_t m_frame_number {};
+
+    // Texture streaming
+    Deletion_queue m_deletion_queue;
+    Asset_registry m_asset_registry;
+    Texture_streamer m_texture_streamer;
+    std::vector<Streamed_texture> m_textures;
+
     // Offscreen pass
     std::uint32_t m_offscreen_width;
     std::uint32_t m_offscreen_height;
-    Vulkan_image m_offscreen_color_attachment;
+    // Owns the offscreen color attachment
+    Frame_graph m_frame_graph;
+    // Null with dynamic rendering, as are the framebuffers
     vk::raii::RenderPass m_offscreen_render_pass;
-    vk::raii::DescriptorSetLayout m_offscreen_descriptor_set_layout;
-    vk::raii::PipelineLayout m_offscreen_pipeline_layout;
-    vk::raii::Pipeline m_offscreen_pipeline;
+    vk::DescriptorSetLayout m_offscreen_descriptor_set_layout;
+    vk::PipelineLayout m_offscreen_pipeline_layout;
+    Pipeline_state m_offscreen_pipeline_state;
     vk::raii::Framebuffer m_offscreen_framebuffer;
-    Vulkan_image m_offscreen_texture_image;
+    Texture_id m_offscreen_texture;
     Vulkan_buffer m_offscreen_vertex_buffer;
     Vulkan_buffer m_offscreen_index_buffer;
-    vk::DescriptorSet m_offscreen_descriptor_set;
+    // The indices of a batch of sprites, each batch uses them
+    Vulkan_buffer m_sprite_index_buffer;
+    // One per frame in flight
+    std::vector<Sprite_buffer> m_sprite_buffers;
+    // Of the frame being recorded
+    std::uint32_t m_sprite_count {};
+    std::vector<vk::DescriptorSet> m_offscreen_descriptor_sets;
+    // Generation of the texture currently written to each frame's offscreen
+    // descriptor set
+    std::vector<std::uint64_t> m_offscreen_descriptor_generations;
+    // Otherwise the textures are not used, and are evicted once over budget
+    bool m_stream_full_textures {true};
 
     // Final pass
     std::uint32_t m_framebuffer_width;
     std::uint32_t m_framebuffer_height;
+    // Null with dynamic rendering, and there are no framebuffers
     vk::raii::RenderPass m_render_pass;
-    vk::raii::DescriptorSetLayout m_descriptor_set_layout;
-    vk::raii::PipelineLayout m_pipeline_layout;
-    vk::raii::Pipeline m_pipeline;
+    vk::DescriptorSetLayout m_descriptor_set_layout;
+    vk::PipelineLayout m_pipeline_layout;
+    Pipeline_state m_pipeline_state;
     std::vector<vk::raii::Framebuffer> m_framebuffers;
     std::vector<vk::DescriptorSet> m_descriptor_sets;
     vk::raii::CommandBuffers m_draw_command_buffers;
     Sync_objects m_sync_objects;
+    // Per-frame resources are created for g_max_frames_in_flight, only the
+    // first m_frames_in_flight are used
+    std::uint32_t m_frames_in_flight;
+    std::uint32_t m_requested_frames_in_flight;
     std::uint32_t m_current_frame {};
-    bool m_framebuffer_resized {};
+    std::uint32_t m_last_image_index {};
+    // Set on resize and present mode changes
+    bool m_swapchain_outdated {};
+    // The swapchain is recreated once resize events stop coming
+    std::chrono::steady_clock::time_point m_last_resize_time {};
+
+    // GPU profiling, disabled if the period is 0
+    float m_timestamp_period;
+    // Of the valid timestamp bits
+    std::uint64_t m_timestamp_mask;
+    // One per frame in flight
+    std::vector<vk::raii::QueryPool> m_timestamp_query_pools;
+    std::array<bool, g_max_frames_in_flight> m_timestamps_written {};
+    // In milliseconds
+    std::array<Timing_history, g_gpu_pass_count> m_gpu_pass_times {};
+    std::optional<Gpu_frame_times> m_last_gpu_frame_times {};
+    // Frame number of the timestamps in each query pool
+    std::array<std::uint64_t, g_max_frames_in_flight> m_timestamp_frames {};
+
+    // Input latching, one buffer per frame in flight
+    std::vector<Input_buffer> m_input_buffers;
+    std::array<std::optional<Input_sample>, g_max_frames_in_flight>
+        m_input_samples {};
+    // Otherwise the cursor is sampled at the start of the frame
+    bool m_late_input_latching {true};
+    // From sampling the cursor until the frame is presented, in milliseconds.
+    // Without a present waiter, until the frame is seen retired at the start
+    // of a later frame.
+    Timing_history m_input_latencies {};
+    std::optional<Present_waiter> m_present_waiter {};
+    glm::vec2 m_cursor_sprite_position {};
+    std::optional<std::uint32_t> m_picked_sprite {};
+
+    // Frame capture, used as a ring: the frames from m_capture_queued_count to
+    // m_capture_copied_count are being copied by the GPU
+    std::vector<Capture_buffer> m_capture_buffers {};
+    // Set while the encoder holds the buffer
+    std::array<std::atomic<bool>, g_capture_buffer_count>
+        m_capture_buffers_encoding {};
+    std::uint64_t m_capture_copied_count {};
+    std::uint64_t m_capture_queued_count {};
+    std::uint64_t m_capture_dropped_count {};
+    // Frames of another size are dropped
+    vk::Extent2D m_capture_extent {};
+    // After the buffers, so that its workers have stopped reading them when
+    // they are destroyed
+    std::optional<Frame_encoder> m_frame_encoder {};
+
+    // Pipeline variants
+    std::unordered_map<Pipeline_state, vk::raii::Pipeline, Pipeline_state_hash>
+        m_pipelines {};
+    std::unordered_map<Pipeline_state, Pending_pipeline, Pipeline_state_hash>
+        m_pending_pipelines {};
+    std::uint64_t m_pipeline_variant_hits {};
+    std::uint64_t m_pipeline_variant_misses {};
+
+#ifdef ENABLE_HOT_RELOAD
+    File_watcher m_file_watcher;
+    std::array<bool, g_shader_program_count> m_dirty_programs {};
+    std::array<std::unique_ptr<Long_job<Reloaded_program>>,
+               g_shader_program_count>
+        m_pending_programs {};
+    std::vector<Pending_texture_reload> m_pending_texture_reloads {};
+#endif
 };
 
 #endif // RENDERER_HPP
@@ -0,0 +1,55 @@
+#include "shaders.hpp"
+
+#ifdef EMBED_SHADERS
+#include "embedded_shaders.hpp"
+#endif
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+std::filesystem::path shader_path(std::string_view name)
+{
+    return std::filesystem::path {g_shader_directory} /
+           (std::string {name} + ".spv");
+}
+
+Shader_code load_shader(std::string_view name)
+{
+#ifdef EMBED_SHADERS
+    const auto it = std::find_if(std::begin(embedded_shaders::g_shaders),
+                                 std::end(embedded_shaders::g_shaders),
+                                 [&](const embedded_shaders::Shader &shader)
+                                 { return shader.name == name; });
+    if (it == std::end(embedded_shaders::g_shaders))
+    {
+        throw std::runtime_error(std::string("Shader \"") + std::string(name) +
+                                 std::string("\" is not embedded"));
+    }
+    return {.file = {}, .code = it->code};
+#else
+    return load_shader_from_disk(name);
+#endif
+}
+
+Shader_code load_shader_from_disk(std::string_view name)
+{
+    const auto path = shader_path(name);
+
+    // Hot reload reads the shaders while glslc may be rewriting them
+    auto file = open_file_view(path, File_access::read);
+    if (file.empty() || file.size() % sizeof(std::uint32_t) != 0)
+    {
+        throw std::runtime_error(std::string("Failed to load shader \"") +
+                                 path.string() + std::string("\""));
+    }
+
+    // Mapped files are page-aligned and buffers come from operator new, so the
+    // data is suitably aligned for std::uint32_t
+    const std::span code {
+        reinterpret_cast<const std::uint32_t *>(file.data().data()),
+        file.size() / sizeof(std::uint32_t)};
+
+    return {.file = std::move(file), .code = code};
+}
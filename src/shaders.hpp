@@ -0,0 +1,32 @@
+#ifndef SHADERS_HPP
+#define SHADERS_HPP
+
+#include "utils.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string_view>
+
+inline constexpr auto g_shader_directory = "shaders/spv";
+
+struct Shader_code
+{
+    // Empty for embedded shaders
+    File_view file;
+    std::span<const std::uint32_t> code;
+};
+
+// Path of the compiled shader, e.g. "shaders/spv/final.vert.spv" for the
+// shader named "final.vert"
+[[nodiscard]] std::filesystem::path shader_path(std::string_view name);
+
+// Returns the shader embedded into the executable when built with
+// EMBED_SHADERS, in which case no file is read, otherwise reads it from
+// g_shader_directory. Throws if the shader cannot be found.
+[[nodiscard]] Shader_code load_shader(std::string_view name);
+
+// Always reads the shader from g_shader_directory, for hot reload
+[[nodiscard]] Shader_code load_shader_from_disk(std::string_view name);
+
+#endif // SHADERS_HPP
@@ -0,0 +1,88 @@
+#include "simulation.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+// Maps the index to [-1, 1), the same on every run
+[[nodiscard]] float hash_to_unit(std::uint32_t value) noexcept
+{
+    value ^= value >> 16;
+    value *= 0x7feb352d;
+    value ^= value >> 15;
+    value *= 0x846ca68b;
+    value ^= value >> 16;
+    return static_cast<float>(value >> 8) / static_cast<float>(1 << 23) -
+           1.0f;
+}
+
+// Reflects the sprite into [-1, 1] along one axis
+void bounce(float &position, float size, float &velocity) noexcept
+{
+    if (position < -1.0f)
+    {
+        position = -2.0f - position;
+        velocity = std::abs(velocity);
+    }
+    else if (position + size > 1.0f)
+    {
+        position = 2.0f - 2.0f * size - position;
+        velocity = -std::abs(velocity);
+    }
+}
+
+} // namespace
+
+Simulation::Simulation(std::uint32_t sprite_count)
+{
+    const auto columns = static_cast<std::uint32_t>(
+        std::ceil(std::sqrt(static_cast<float>(sprite_count))));
+    for (std::uint32_t i {}; i < sprite_count; ++i)
+    {
+        const auto cell_size = 2.0f / static_cast<float>(columns);
+        m_world.create(
+            Sprite {.position = {-1.0f + static_cast<float>(i % columns) *
+                                             cell_size,
+                                 -1.0f + static_cast<float>(i / columns) *
+                                             cell_size},
+                    .size = glm::vec2 {cell_size * 0.8f}},
+            Velocity {.value = {0.5f * hash_to_unit(i * 2),
+                                0.5f * hash_to_unit(i * 2 + 1)}});
+    }
+    extract_sprites();
+}
+
+void Simulation::update(float step, Job_system &job_system)
+{
+    // Each sprite only depends on itself, so the result does not depend on
+    // which thread updates which chunk
+    m_world.parallel_for_each_chunk<Sprite, Velocity>(
+        job_system,
+        [step](std::span<const Entity> /*entities*/,
+               std::span<Sprite> sprites,
+               std::span<Velocity> velocities)
+        {
+            for (std::size_t i {}; i < sprites.size(); ++i)
+            {
+                auto &sprite = sprites[i];
+                auto &velocity = velocities[i].value;
+                sprite.position += velocity * step;
+                bounce(sprite.position.x, sprite.size.x, velocity.x);
+                bounce(sprite.position.y, sprite.size.y, velocity.y);
+            }
+        });
+    extract_sprites();
+    ++m_tick;
+}
+
+void Simulation::extract_sprites()
+{
+    m_sprites.resize(m_world.size());
+    auto *sprite = m_sprites.data();
+    m_world.for_each_chunk<const Sprite>(
+        [&sprite](std::span<const Entity> /*entities*/,
+                  std::span<const Sprite> sprites)
+        { sprite = std::copy(sprites.begin(), sprites.end(), sprite); });
+}
@@ -0,0 +1,54 @@
+#ifndef SIMULATION_HPP
+#define SIMULATION_HPP
+
+#include "ecs.hpp"
+#include "job_system.hpp"
+#include "sprite.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// In viewports per second
+struct Velocity
+{
+    glm::vec2 value;
+};
+
+// Sprites bouncing off the edges of the viewport, entities with a Sprite and a
+// Velocity. Deterministic: the same steps give the same sprites.
+class Simulation
+{
+public:
+    // The sprites start in a square grid over the whole viewport
+    [[nodiscard]] explicit Simulation(std::uint32_t sprite_count);
+
+    // Advances by a step, in seconds, the chunks in parallel
+    void update(float step, Job_system &job_system);
+
+    // The Sprite components after the last step, in the order of the chunks
+    [[nodiscard]] const std::vector<Sprite> &sprites() const noexcept
+    {
+        return m_sprites;
+    }
+
+    [[nodiscard]] World &world() noexcept
+    {
+        return m_world;
+    }
+
+    // Number of steps simulated
+    [[nodiscard]] std::uint64_t tick() const noexcept
+    {
+        return m_tick;
+    }
+
+private:
+    // Copies the Sprite array of each chunk
+    void extract_sprites();
+
+    World m_world;
+    std::vector<Sprite> m_sprites;
+    std::uint64_t m_tick {};
+};
+
+#endif // SIMULATION_HPP
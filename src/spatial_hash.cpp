@@ -0,0 +1,315 @@
+#include "spatial_hash.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+
+namespace
+{
+
+[[nodiscard]] glm::vec2 center(const Aabb &box) noexcept
+{
+    return {(box.min.x + box.max.x) * 0.5f, (box.min.y + box.max.y) * 0.5f};
+}
+
+[[nodiscard]] bool contains_point(const Aabb &box, glm::vec2 point) noexcept
+{
+    return point.x >= box.min.x && point.x <= box.max.x &&
+           point.y >= box.min.y && point.y <= box.max.y;
+}
+
+[[nodiscard]] bool overlaps(const Aabb &a, const Aabb &b) noexcept
+{
+    return a.min.x <= b.max.x && b.min.x <= a.max.x && a.min.y <= b.max.y &&
+           b.min.y <= a.max.y;
+}
+
+[[nodiscard]] bool overlaps(const Aabb &box, const Circle &circle) noexcept
+{
+    const auto dx =
+        circle.center.x - std::clamp(circle.center.x, box.min.x, box.max.x);
+    const auto dy =
+        circle.center.y - std::clamp(circle.center.y, box.min.y, box.max.y);
+    return dx * dx + dy * dy <= circle.radius * circle.radius;
+}
+
+[[nodiscard]] std::uint64_t pack_cell_key(std::int32_t x,
+                                          std::int32_t y) noexcept
+{
+    return (std::uint64_t {static_cast<std::uint32_t>(x)} << 32) |
+           static_cast<std::uint32_t>(y);
+}
+
+// Neighbouring cells differ in few bits, which must spread over the table
+[[nodiscard]] std::uint64_t hash_cell_key(std::uint64_t key) noexcept
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccd;
+    key ^= key >> 33;
+    return key;
+}
+
+} // namespace
+
+Spatial_hash::Spatial_hash(float cell_size) : m_cell_size {cell_size}
+{
+    if (!(cell_size > 0.0f))
+    {
+        throw std::runtime_error("The cell size must be positive");
+    }
+}
+
+void Spatial_hash::set(std::uint32_t id, const Aabb &bounds)
+{
+    if (id >= m_objects.size())
+    {
+        m_objects.resize(
+            id + std::size_t {1},
+            {.bounds = {}, .key = {}, .cell = g_no_cell, .slot = 0});
+    }
+
+    auto &object = m_objects[id];
+    object.bounds = bounds;
+    m_max_extent = std::max({m_max_extent,
+                             bounds.max.x - bounds.min.x,
+                             bounds.max.y - bounds.min.y});
+
+    const auto key = cell_key(center(bounds));
+    if (object.cell == g_no_cell || object.key != key)
+    {
+        move_to_cell(id, key);
+    }
+}
+
+void Spatial_hash::remove(std::uint32_t id)
+{
+    if (!contains(id))
+    {
+        return;
+    }
+
+    auto &object = m_objects[id];
+    auto &cell = m_cells[object.cell];
+    const auto moved = cell.back();
+    cell[object.slot] = moved;
+    m_objects[moved].slot = object.slot;
+    cell.pop_back();
+
+    object.cell = g_no_cell;
+    --m_size;
+}
+
+void Spatial_hash::set_all(std::span<const Aabb> bounds,
+                           Job_system &job_system)
+{
+    for (auto id = bounds.size(); id < m_objects.size(); ++id)
+    {
+        remove(static_cast<std::uint32_t>(id));
+    }
+    m_objects.resize(bounds.size(),
+                     {.bounds = {}, .key = {}, .cell = g_no_cell, .slot = 0});
+    m_new_keys.resize(bounds.size());
+
+    // Only the bounds and keys of each chunk's own objects are written
+    std::mutex max_extent_mutex;
+    job_system.parallel_for(
+        bounds.size(),
+        g_objects_per_job,
+        [&](std::size_t first, std::size_t last)
+        {
+            float max_extent {};
+            for (auto i = first; i < last; ++i)
+            {
+                m_objects[i].bounds = bounds[i];
+                m_new_keys[i] = cell_key(center(bounds[i]));
+                max_extent = std::max({max_extent,
+                                       bounds[i].max.x - bounds[i].min.x,
+                                       bounds[i].max.y - bounds[i].min.y});
+            }
+            const std::scoped_lock lock {max_extent_mutex};
+            m_max_extent = std::max(m_max_extent, max_extent);
+        });
+
+    for (std::size_t i {}; i < bounds.size(); ++i)
+    {
+        const auto &object = m_objects[i];
+        if (object.cell == g_no_cell || object.key != m_new_keys[i])
+        {
+            move_to_cell(static_cast<std::uint32_t>(i), m_new_keys[i]);
+        }
+    }
+}
+
+void Spatial_hash::query(glm::vec2 point,
+                         std::vector<std::uint32_t> &ids) const
+{
+    for_each_candidate({.min = point, .max = point},
+                       [&](std::uint32_t id)
+                       {
+                           if (contains_point(m_objects[id].bounds, point))
+                           {
+                               ids.push_back(id);
+                           }
+                       });
+}
+
+void Spatial_hash::query(const Aabb &box,
+                         std::vector<std::uint32_t> &ids) const
+{
+    for_each_candidate(box,
+                       [&](std::uint32_t id)
+                       {
+                           if (overlaps(m_objects[id].bounds, box))
+                           {
+                               ids.push_back(id);
+                           }
+                       });
+}
+
+void Spatial_hash::query(const Circle &circle,
+                         std::vector<std::uint32_t> &ids) const
+{
+    const glm::vec2 extent {circle.radius, circle.radius};
+    for_each_candidate({.min = circle.center - extent,
+                        .max = circle.center + extent},
+                       [&](std::uint32_t id)
+                       {
+                           if (overlaps(m_objects[id].bounds, circle))
+                           {
+                               ids.push_back(id);
+                           }
+                       });
+}
+
+std::int32_t Spatial_hash::cell_coordinate(float position) const noexcept
+{
+    // Positions beyond the range share the outermost cells
+    constexpr auto limit =
+        static_cast<float>(std::numeric_limits<std::int32_t>::max() / 2);
+    return static_cast<std::int32_t>(
+        std::clamp(std::floor(position / m_cell_size), -limit, limit));
+}
+
+Spatial_hash::Cell_key
+Spatial_hash::cell_key(glm::vec2 position) const noexcept
+{
+    return pack_cell_key(cell_coordinate(position.x),
+                         cell_coordinate(position.y));
+}
+
+std::uint32_t Spatial_hash::find_cell(Cell_key key) const noexcept
+{
+    if (m_cell_slots.empty())
+    {
+        return g_no_cell;
+    }
+
+    const auto mask = m_cell_slots.size() - 1;
+    for (auto i = hash_cell_key(key) & mask;; i = (i + 1) & mask)
+    {
+        const auto &slot = m_cell_slots[i];
+        if (slot.cell == g_no_cell || slot.key == key)
+        {
+            return slot.cell;
+        }
+    }
+}
+
+std::uint32_t Spatial_hash::insert_cell(Cell_key key)
+{
+    if (const auto cell = find_cell(key); cell != g_no_cell)
+    {
+        return cell;
+    }
+
+    // Cells are never removed, so growing only has to reinsert them
+    if ((m_cells.size() + 1) * 2 > m_cell_slots.size())
+    {
+        std::vector<Cell_slot> slots(
+            std::max(m_cell_slots.size() * 2, std::size_t {64}),
+            {.key = 0, .cell = g_no_cell});
+        const auto mask = slots.size() - 1;
+        for (const auto &slot : m_cell_slots)
+        {
+            if (slot.cell == g_no_cell)
+            {
+                continue;
+            }
+            auto i = hash_cell_key(slot.key) & mask;
+            while (slots[i].cell != g_no_cell)
+            {
+                i = (i + 1) & mask;
+            }
+            slots[i] = slot;
+        }
+        m_cell_slots = std::move(slots);
+    }
+
+    const auto cell = static_cast<std::uint32_t>(m_cells.size());
+    m_cells.emplace_back();
+    const auto mask = m_cell_slots.size() - 1;
+    auto i = hash_cell_key(key) & mask;
+    while (m_cell_slots[i].cell != g_no_cell)
+    {
+        i = (i + 1) & mask;
+    }
+    m_cell_slots[i] = {.key = key, .cell = cell};
+    return cell;
+}
+
+void Spatial_hash::move_to_cell(std::uint32_t id, Cell_key key)
+{
+    remove(id);
+
+    const auto cell_index = insert_cell(key);
+    auto &cell = m_cells[cell_index];
+    auto &object = m_objects[id];
+    object.key = key;
+    object.cell = cell_index;
+    object.slot = static_cast<std::uint32_t>(cell.size());
+    cell.push_back(id);
+    ++m_size;
+}
+
+template <typename F>
+void Spatial_hash::for_each_candidate(const Aabb &box, F &&function) const
+{
+    const auto margin = m_max_extent * 0.5f;
+    const auto first_x = cell_coordinate(box.min.x - margin);
+    const auto first_y = cell_coordinate(box.min.y - margin);
+    const auto last_x = cell_coordinate(box.max.x + margin);
+    const auto last_y = cell_coordinate(box.max.y + margin);
+
+    // Beyond the cells in use, visiting all of them is cheaper
+    const auto cell_count = (std::int64_t {last_x} - first_x + 1) *
+                            (std::int64_t {last_y} - first_y + 1);
+    if (cell_count > static_cast<std::int64_t>(m_cells.size()))
+    {
+        for (const auto &cell : m_cells)
+        {
+            for (const auto id : cell)
+            {
+                function(id);
+            }
+        }
+        return;
+    }
+
+    for (auto x = first_x; x <= last_x; ++x)
+    {
+        for (auto y = first_y; y <= last_y; ++y)
+        {
+            const auto cell = find_cell(pack_cell_key(x, y));
+            if (cell == g_no_cell)
+            {
+                continue;
+            }
+            for (const auto id : m_cells[cell])
+            {
+                function(id);
+            }
+        }
+    }
+}
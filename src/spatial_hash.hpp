@@ -0,0 +1,149 @@
+#ifndef SPATIAL_HASH_HPP
+#define SPATIAL_HASH_HPP
+
+#include "job_system.hpp"
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#endif
+#include <glm/vec2.hpp>
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+struct Aabb
+{
+    glm::vec2 min;
+    glm::vec2 max;
+};
+
+struct Circle
+{
+    glm::vec2 center;
+    float radius;
+};
+
+// Loose grid over the plane: each object is stored in the one cell containing
+// the center of its bounds, and queries widen their range by half the largest
+// object. Moving an object within its cell only updates its bounds. Only the
+// cells in use are stored, indexed by an open addressing hash table.
+class Spatial_hash
+{
+public:
+    // Best a few times the size of the objects: fewer objects change cell in
+    // larger cells, and queries test fewer objects in smaller ones. Throws
+    // std::runtime_error if it is not positive.
+    [[nodiscard]] explicit Spatial_hash(float cell_size);
+
+    // Inserts or moves the object. Ids index an array, so they should be
+    // dense, like sprite or entity indices.
+    void set(std::uint32_t id, const Aabb &bounds);
+
+    void remove(std::uint32_t id);
+
+    // Sets the bounds of the objects 0 to bounds.size() - 1 and removes the
+    // others. The cells are found on the threads of the job system, then only
+    // the objects changing cell are moved.
+    void set_all(std::span<const Aabb> bounds, Job_system &job_system);
+
+    [[nodiscard]] bool contains(std::uint32_t id) const noexcept
+    {
+        return id < m_objects.size() && m_objects[id].cell != g_no_cell;
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept
+    {
+        return m_size;
+    }
+
+    // Append the ids of the objects whose bounds contain the point, overlap
+    // the box or the circle, in no particular order
+    void query(glm::vec2 point, std::vector<std::uint32_t> &ids) const;
+    void query(const Aabb &box, std::vector<std::uint32_t> &ids) const;
+    void query(const Circle &circle, std::vector<std::uint32_t> &ids) const;
+
+    // Runs the queries on the threads of the job system, results[i] is
+    // replaced by the ids found by queries[i]. Reusing the results avoids
+    // allocating. The hash must not change until it returns.
+    template <typename Query>
+    void query(std::span<const Query> queries,
+               std::vector<std::vector<std::uint32_t>> &results,
+               Job_system &job_system) const
+    {
+        results.resize(queries.size());
+        job_system.parallel_for(
+            queries.size(),
+            g_queries_per_job,
+            [&](std::size_t first, std::size_t last)
+            {
+                for (auto i = first; i < last; ++i)
+                {
+                    results[i].clear();
+                    query(queries[i], results[i]);
+                }
+            });
+    }
+
+private:
+    static constexpr std::uint32_t g_no_cell {~std::uint32_t {}};
+    static constexpr std::size_t g_queries_per_job {64};
+    static constexpr std::size_t g_objects_per_job {4096};
+
+    // Packed signed cell coordinates
+    using Cell_key = std::uint64_t;
+
+    struct Cell_slot
+    {
+        Cell_key key;
+        // g_no_cell if the slot is empty
+        std::uint32_t cell;
+    };
+
+    struct Object
+    {
+        Aabb bounds;
+        Cell_key key;
+        // Index of the cell and of the object in the cell
+        std::uint32_t cell;
+        std::uint32_t slot;
+    };
+
+    [[nodiscard]] std::int32_t cell_coordinate(float position) const noexcept;
+
+    [[nodiscard]] Cell_key cell_key(glm::vec2 position) const noexcept;
+
+    // g_no_cell if no object was ever in the cell
+    [[nodiscard]] std::uint32_t find_cell(Cell_key key) const noexcept;
+
+    // Adds the cell if it does not exist yet
+    [[nodiscard]] std::uint32_t insert_cell(Cell_key key);
+
+    // Removes the object from its current cell, if any, and appends it to the
+    // cell of the key
+    void move_to_cell(std::uint32_t id, Cell_key key);
+
+    // Calls function(id) for each object whose center may be in the box,
+    // widened by half the largest object
+    template <typename F>
+    void for_each_candidate(const Aabb &box, F &&function) const;
+
+    float m_cell_size;
+    // Linear probing, a power of two at most half full
+    std::vector<Cell_slot> m_cell_slots {};
+    // The ids of the objects in each cell. Emptied cells are kept for reuse.
+    std::vector<std::vector<std::uint32_t>> m_cells {};
+    // Indexed by id
+    std::vector<Object> m_objects {};
+    // Of each object, computed by set_all
+    std::vector<Cell_key> m_new_keys {};
+    std::size_t m_size {};
+    // Of the largest object so far, along either axis
+    float m_max_extent {};
+};
+
+#endif // SPATIAL_HASH_HPP
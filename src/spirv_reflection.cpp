@@ -0,0 +1,553 @@
+#include "spirv_reflection.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+
+constexpr std::uint32_t g_spirv_magic {0x07230203};
+constexpr std::size_t g_spirv_header_size {5};
+
+// See https://registry.khronos.org/SPIR-V/specs/unified1/SPIRV.html
+enum class Op : std::uint32_t
+{
+    entry_point = 15,
+    type_bool = 20,
+    type_int = 21,
+    type_float = 22,
+    type_vector = 23,
+    type_matrix = 24,
+    type_image = 25,
+    type_sampler = 26,
+    type_sampled_image = 27,
+    type_array = 28,
+    type_runtime_array = 29,
+    type_struct = 30,
+    type_pointer = 32,
+    constant = 43,
+    spec_constant = 50,
+    variable = 59,
+    decorate = 71,
+    member_decorate = 72
+};
+
+enum class Decoration : std::uint32_t
+{
+    block = 2,
+    buffer_block = 3,
+    array_stride = 6,
+    matrix_stride = 7,
+    built_in = 11,
+    location = 30,
+    binding = 33,
+    descriptor_set = 34,
+    offset = 35
+};
+
+enum class Storage_class : std::uint32_t
+{
+    uniform_constant = 0,
+    input = 1,
+    uniform = 2,
+    push_constant = 9,
+    storage_buffer = 12
+};
+
+enum class Execution_model : std::uint32_t
+{
+    vertex = 0,
+    fragment = 4,
+    gl_compute = 5
+};
+
+constexpr std::uint32_t g_dim_buffer {5};
+constexpr std::uint32_t g_dim_subpass_data {6};
+
+// What is known about a result id
+struct Id_info
+{
+    Op op {};
+    // For constants and variables
+    std::uint32_t type_id {};
+    // Operands following the result id
+    std::span<const std::uint32_t> operands {};
+    std::optional<std::uint32_t> set {};
+    std::optional<std::uint32_t> binding {};
+    std::optional<std::uint32_t> location {};
+    std::optional<std::uint32_t> array_stride {};
+    bool built_in {};
+    bool block {};
+    bool buffer_block {};
+    // Indexed by member, for structs
+    std::vector<std::uint32_t> member_offsets {};
+    std::vector<std::uint32_t> member_matrix_strides {};
+};
+
+[[noreturn]] void throw_malformed(const char *reason)
+{
+    throw std::runtime_error(std::string("Malformed SPIR-V: ") + reason);
+}
+
+[[nodiscard]] const Id_info &get_id(const std::vector<Id_info> &ids,
+                                    std::uint32_t id)
+{
+    if (id >= ids.size())
+    {
+        throw_malformed("id out of bounds");
+    }
+    return ids[id];
+}
+
+[[nodiscard]] std::uint32_t operand(const Id_info &info, std::size_t index)
+{
+    if (index >= info.operands.size())
+    {
+        throw_malformed("missing operand");
+    }
+    return info.operands[index];
+}
+
+void set_member_decoration(std::vector<std::uint32_t> &decorations,
+                           std::uint32_t member,
+                           std::uint32_t value)
+{
+    if (member >= decorations.size())
+    {
+        decorations.resize(member + 1);
+    }
+    decorations[member] = value;
+}
+
+[[nodiscard]] std::uint32_t array_length(const std::vector<Id_info> &ids,
+                                         const Id_info &array)
+{
+    const auto &length = get_id(ids, operand(array, 1));
+    if (length.op != Op::constant && length.op != Op::spec_constant)
+    {
+        throw_malformed("array length is not a constant");
+    }
+    return operand(length, 0);
+}
+
+[[nodiscard]] std::uint32_t type_size(const std::vector<Id_info> &ids,
+                                      std::uint32_t type_id,
+                                      std::uint32_t matrix_stride = 0)
+{
+    const auto &type = get_id(ids, type_id);
+    switch (type.op)
+    {
+    case Op::type_bool: return 4;
+    case Op::type_int:
+    case Op::type_float: return operand(type, 0) / 8;
+    case Op::type_vector:
+        return operand(type, 1) * type_size(ids, operand(type, 0));
+    case Op::type_matrix:
+    {
+        const auto column_size = type_size(ids, operand(type, 0));
+        return operand(type, 1) *
+               (matrix_stride != 0 ? matrix_stride : column_size);
+    }
+    case Op::type_array:
+    {
+        const auto stride = type.array_stride.has_value()
+                                ? *type.array_stride
+                                : type_size(ids, operand(type, 0));
+        return array_length(ids, type) * stride;
+    }
+    case Op::type_struct:
+    {
+        std::uint32_t size {};
+        for (std::uint32_t i {}; i < type.operands.size(); ++i)
+        {
+            const auto offset =
+                i < type.member_offsets.size() ? type.member_offsets[i] : 0;
+            const auto stride = i < type.member_matrix_strides.size()
+                                    ? type.member_matrix_strides[i]
+                                    : 0;
+            size = std::max(size,
+                            offset + type_size(ids, type.operands[i], stride));
+        }
+        return size;
+    }
+    default: throw std::runtime_error("Unsupported type in SPIR-V block");
+    }
+}
+
+[[nodiscard]] std::optional<Descriptor_type>
+image_descriptor_type(const Id_info &image)
+{
+    const auto dim = operand(image, 1);
+    const auto sampled = operand(image, 5);
+    if (dim == g_dim_subpass_data)
+    {
+        return Descriptor_type::input_attachment;
+    }
+    if (dim == g_dim_buffer)
+    {
+        return sampled == 1 ? Descriptor_type::uniform_texel_buffer
+                            : Descriptor_type::storage_texel_buffer;
+    }
+    return sampled == 1 ? Descriptor_type::sampled_image
+                        : Descriptor_type::storage_image;
+}
+
+[[nodiscard]] std::optional<Descriptor_type>
+descriptor_type(const std::vector<Id_info> &ids,
+                const Id_info &type,
+                Storage_class storage_class)
+{
+    switch (type.op)
+    {
+    case Op::type_sampler: return Descriptor_type::sampler;
+    case Op::type_sampled_image:
+    {
+        const auto &image = get_id(ids, operand(type, 0));
+        if (operand(image, 1) == g_dim_buffer)
+        {
+            return Descriptor_type::uniform_texel_buffer;
+        }
+        return Descriptor_type::combined_image_sampler;
+    }
+    case Op::type_image: return image_descriptor_type(type);
+    case Op::type_struct:
+        if (storage_class == Storage_class::storage_buffer ||
+            type.buffer_block)
+        {
+            return Descriptor_type::storage_buffer;
+        }
+        if (storage_class == Storage_class::uniform && type.block)
+        {
+            return Descriptor_type::uniform_buffer;
+        }
+        return std::nullopt;
+    default: return std::nullopt;
+    }
+}
+
+void reflect_descriptor(const std::vector<Id_info> &ids,
+                        const Id_info &variable,
+                        Storage_class storage_class,
+                        std::uint32_t stage,
+                        Shader_reflection &reflection)
+{
+    const auto &pointer = get_id(ids, variable.type_id);
+    const auto *type = &get_id(ids, operand(pointer, 1));
+
+    std::uint32_t count {1};
+    while (type->op == Op::type_array || type->op == Op::type_runtime_array)
+    {
+        if (type->op == Op::type_runtime_array)
+        {
+            throw std::runtime_error(
+                "Unsupported runtime array descriptor in SPIR-V");
+        }
+        count *= array_length(ids, *type);
+        type = &get_id(ids, operand(*type, 0));
+    }
+
+    const auto type_of_descriptor = descriptor_type(ids, *type, storage_class);
+    if (!type_of_descriptor.has_value())
+    {
+        return;
+    }
+
+    reflection.bindings.push_back({.set = variable.set.value_or(0),
+                                   .binding = variable.binding.value_or(0),
+                                   .type = *type_of_descriptor,
+                                   .count = count,
+                                   .stages = stage});
+}
+
+void reflect_push_constants(const std::vector<Id_info> &ids,
+                            const Id_info &variable,
+                            std::uint32_t stage,
+                            Shader_reflection &reflection)
+{
+    const auto &pointer = get_id(ids, variable.type_id);
+    const auto &block = get_id(ids, operand(pointer, 1));
+    if (block.op != Op::type_struct)
+    {
+        throw_malformed("push constant block is not a struct");
+    }
+
+    const auto offset =
+        block.member_offsets.empty()
+            ? 0
+            : *std::min_element(block.member_offsets.begin(),
+                                block.member_offsets.end());
+    const auto end = type_size(ids, operand(pointer, 1));
+
+    reflection.push_constants = {
+        .offset = offset, .size = end - offset, .stages = stage};
+}
+
+void reflect_vertex_input(const std::vector<Id_info> &ids,
+                          const Id_info &variable,
+                          Shader_reflection &reflection)
+{
+    const auto &pointer = get_id(ids, variable.type_id);
+    const auto &type = get_id(ids, operand(pointer, 1));
+
+    std::uint32_t components {1};
+    const auto *scalar = &type;
+    if (type.op == Op::type_vector)
+    {
+        components = operand(type, 1);
+        scalar = &get_id(ids, operand(type, 0));
+    }
+
+    Scalar_type scalar_type {};
+    if (scalar->op == Op::type_float && operand(*scalar, 0) == 32)
+    {
+        scalar_type = Scalar_type::float32;
+    }
+    else if (scalar->op == Op::type_int && operand(*scalar, 0) == 32)
+    {
+        scalar_type = operand(*scalar, 1) != 0 ? Scalar_type::int32
+                                               : Scalar_type::uint32;
+    }
+    else
+    {
+        throw std::runtime_error("Unsupported vertex input type in SPIR-V");
+    }
+
+    reflection.vertex_inputs.push_back({.location = *variable.location,
+                                        .type = scalar_type,
+                                        .components = components});
+}
+
+} // namespace
+
+Shader_reflection reflect_shader(std::span<const std::uint32_t> code)
+{
+    if (code.size() < g_spirv_header_size || code[0] != g_spirv_magic)
+    {
+        throw_malformed("invalid header");
+    }
+
+    const auto bound = code[3];
+    std::vector<Id_info> ids(bound);
+    std::optional<Execution_model> execution_model;
+
+    const auto info_for = [&](std::uint32_t id) -> Id_info &
+    {
+        if (id >= ids.size())
+        {
+            throw_malformed("id out of bounds");
+        }
+        return ids[id];
+    };
+
+    for (std::size_t i {g_spirv_header_size}; i < code.size();)
+    {
+        const auto word_count = code[i] >> 16;
+        const auto op = static_cast<Op>(code[i] & 0xffff);
+        if (word_count == 0 || i + word_count > code.size())
+        {
+            throw_malformed("invalid instruction size");
+        }
+        const auto words = code.subspan(i, word_count);
+        i += word_count;
+
+        switch (op)
+        {
+        case Op::entry_point:
+            if (!execution_model.has_value() && words.size() > 1)
+            {
+                execution_model = static_cast<Execution_model>(words[1]);
+            }
+            break;
+        case Op::type_bool:
+        case Op::type_int:
+        case Op::type_float:
+        case Op::type_vector:
+        case Op::type_matrix:
+        case Op::type_image:
+        case Op::type_sampler:
+        case Op::type_sampled_image:
+        case Op::type_array:
+        case Op::type_runtime_array:
+        case Op::type_struct:
+        case Op::type_pointer:
+            if (words.size() < 2)
+            {
+                throw_malformed("missing result id");
+            }
+            info_for(words[1]).op = op;
+            info_for(words[1]).operands = words.subspan(2);
+            break;
+        case Op::constant:
+        case Op::spec_constant:
+        case Op::variable:
+            if (words.size() < 3)
+            {
+                throw_malformed("missing result id");
+            }
+            info_for(words[2]).op = op;
+            info_for(words[2]).type_id = words[1];
+            info_for(words[2]).operands = words.subspan(3);
+            break;
+        case Op::decorate:
+        {
+            if (words.size() < 3)
+            {
+                throw_malformed("missing decoration");
+            }
+            auto &info = info_for(words[1]);
+            const auto value = words.size() > 3 ? words[3] : 0;
+            switch (static_cast<Decoration>(words[2]))
+            {
+            case Decoration::block: info.block = true; break;
+            case Decoration::buffer_block: info.buffer_block = true; break;
+            case Decoration::array_stride: info.array_stride = value; break;
+            case Decoration::built_in: info.built_in = true; break;
+            case Decoration::location: info.location = value; break;
+            case Decoration::binding: info.binding = value; break;
+            case Decoration::descriptor_set: info.set = value; break;
+            default: break;
+            }
+            break;
+        }
+        case Op::member_decorate:
+        {
+            if (words.size() < 5)
+            {
+                break;
+            }
+            auto &info = info_for(words[1]);
+            switch (static_cast<Decoration>(words[3]))
+            {
+            case Decoration::offset:
+                set_member_decoration(info.member_offsets, words[2], words[4]);
+                break;
+            case Decoration::matrix_stride:
+                set_member_decoration(
+                    info.member_matrix_strides, words[2], words[4]);
+                break;
+            default: break;
+            }
+            break;
+        }
+        default: break;
+        }
+    }
+
+    if (!execution_model.has_value())
+    {
+        throw_malformed("no entry point");
+    }
+
+    Shader_reflection reflection {};
+    switch (*execution_model)
+    {
+    case Execution_model::vertex:
+        reflection.stages = shader_stage_vertex;
+        break;
+    case Execution_model::fragment:
+        reflection.stages = shader_stage_fragment;
+        break;
+    case Execution_model::gl_compute:
+        reflection.stages = shader_stage_compute;
+        break;
+    default: throw std::runtime_error("Unsupported SPIR-V execution model");
+    }
+
+    for (const auto &info : ids)
+    {
+        if (info.op != Op::variable || info.operands.empty())
+        {
+            continue;
+        }
+
+        const auto storage_class = static_cast<Storage_class>(info.operands[0]);
+        switch (storage_class)
+        {
+        case Storage_class::uniform_constant:
+        case Storage_class::uniform:
+        case Storage_class::storage_buffer:
+            reflect_descriptor(
+                ids, info, storage_class, reflection.stages, reflection);
+            break;
+        case Storage_class::push_constant:
+            reflect_push_constants(ids, info, reflection.stages, reflection);
+            break;
+        case Storage_class::input:
+            if (reflection.stages == shader_stage_vertex && !info.built_in &&
+                info.location.has_value())
+            {
+                reflect_vertex_input(ids, info, reflection);
+            }
+            break;
+        default: break;
+        }
+    }
+
+    std::sort(reflection.bindings.begin(), reflection.bindings.end());
+    std::sort(reflection.vertex_inputs.begin(),
+              reflection.vertex_inputs.end());
+
+    return reflection;
+}
+
+Shader_reflection merge_reflections(const Shader_reflection &a,
+                                    const Shader_reflection &b)
+{
+    Shader_reflection merged {.stages = a.stages | b.stages,
+                              .bindings = a.bindings,
+                              .push_constants = a.push_constants,
+                              .vertex_inputs = a.vertex_inputs};
+
+    for (const auto &binding : b.bindings)
+    {
+        const auto is_same_slot = [&](const Descriptor_binding &other)
+        {
+            return other.set == binding.set && other.binding == binding.binding;
+        };
+        const auto it = std::find_if(
+            merged.bindings.begin(), merged.bindings.end(), is_same_slot);
+        if (it == merged.bindings.end())
+        {
+            merged.bindings.push_back(binding);
+            continue;
+        }
+
+        if (it->type != binding.type || it->count != binding.count)
+        {
+            throw std::runtime_error(
+                "Shader stages declare different descriptors at set " +
+                std::to_string(binding.set) + ", binding " +
+                std::to_string(binding.binding));
+        }
+        it->stages |= binding.stages;
+    }
+    std::sort(merged.bindings.begin(), merged.bindings.end());
+
+    // A single range covering both stages
+    if (b.push_constants.has_value())
+    {
+        if (!merged.push_constants.has_value())
+        {
+            merged.push_constants = b.push_constants;
+        }
+        else
+        {
+            auto &range = *merged.push_constants;
+            const auto begin = std::min(range.offset, b.push_constants->offset);
+            const auto end =
+                std::max(range.offset + range.size,
+                         b.push_constants->offset + b.push_constants->size);
+            range = {.offset = begin,
+                     .size = end - begin,
+                     .stages = range.stages | b.push_constants->stages};
+        }
+    }
+
+    merged.vertex_inputs.insert(merged.vertex_inputs.end(),
+                                b.vertex_inputs.begin(),
+                                b.vertex_inputs.end());
+    std::sort(merged.vertex_inputs.begin(), merged.vertex_inputs.end());
+
+    return merged;
+}
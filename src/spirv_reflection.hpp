@@ -0,0 +1,103 @@
+#ifndef SPIRV_REFLECTION_HPP
+#define SPIRV_REFLECTION_HPP
+
+#include <compare>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+// Same values as VkShaderStageFlagBits, so that they convert with a cast
+enum Shader_stage : std::uint32_t
+{
+    shader_stage_vertex = 0x01,
+    shader_stage_fragment = 0x10,
+    shader_stage_compute = 0x20
+};
+
+// Same values as VkDescriptorType
+enum class Descriptor_type : std::uint32_t
+{
+    sampler = 0,
+    combined_image_sampler = 1,
+    sampled_image = 2,
+    storage_image = 3,
+    uniform_texel_buffer = 4,
+    storage_texel_buffer = 5,
+    uniform_buffer = 6,
+    storage_buffer = 7,
+    input_attachment = 10
+};
+
+struct Descriptor_binding
+{
+    std::uint32_t set;
+    std::uint32_t binding;
+    Descriptor_type type;
+    std::uint32_t count;
+    // Shader_stage bits
+    std::uint32_t stages;
+
+    [[nodiscard]] auto operator<=>(const Descriptor_binding &) const = default;
+};
+
+struct Push_constant_range
+{
+    std::uint32_t offset;
+    std::uint32_t size;
+    // Shader_stage bits
+    std::uint32_t stages;
+
+    [[nodiscard]] auto operator<=>(const Push_constant_range &) const = default;
+};
+
+enum class Scalar_type : std::uint8_t
+{
+    float32,
+    int32,
+    uint32
+};
+
+struct Vertex_input
+{
+    std::uint32_t location;
+    Scalar_type type;
+    std::uint32_t components;
+
+    [[nodiscard]] auto operator<=>(const Vertex_input &) const = default;
+};
+
+// The resources that a shader, or all the stages of a program, declare
+struct Shader_reflection
+{
+    // Shader_stage bits
+    std::uint32_t stages;
+    // Sorted by set, then binding
+    std::vector<Descriptor_binding> bindings;
+    std::optional<Push_constant_range> push_constants;
+    // Sorted by location, only for vertex shaders
+    std::vector<Vertex_input> vertex_inputs;
+
+    [[nodiscard]] bool operator==(const Shader_reflection &) const = default;
+};
+
+// Reads the interface of the first entry point of a SPIR-V module. Throws
+// std::runtime_error if the module is malformed or uses resources that are
+// not supported (runtime arrays, matrix vertex inputs).
+[[nodiscard]] Shader_reflection
+reflect_shader(std::span<const std::uint32_t> code);
+
+// Combines the reflections of the stages of a program. Bindings and push
+// constants declared by several stages are merged. Throws if two stages
+// declare different resources at the same binding.
+[[nodiscard]] Shader_reflection merge_reflections(const Shader_reflection &a,
+                                                  const Shader_reflection &b);
+
+// Size in bytes of a vertex input, e.g. 12 for a vec3
+[[nodiscard]] constexpr std::uint32_t
+vertex_input_size(const Vertex_input &input) noexcept
+{
+    return input.components * 4;
+}
+
+#endif // SPIRV_REFLECTION_HPP
@@ -0,0 +1,26 @@
+#ifndef SPRITE_HPP
+#define SPRITE_HPP
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#endif
+#include <glm/vec2.hpp>
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#include <cstddef>
+
+// A quad textured with the whole texture, in normalized device coordinates
+struct Sprite
+{
+    // Of the corner with the lowest coordinates
+    glm::vec2 position;
+    glm::vec2 size;
+};
+
+// Sprites processed by one job, fewer are not worth its overhead
+inline constexpr std::size_t g_sprites_per_job {4096};
+
+#endif // SPRITE_HPP
@@ -0,0 +1,92 @@
+#include "texture_streamer.hpp"
+
+Texture_streamer::Texture_streamer(std::uint64_t budget) : m_budget {budget}
+{
+}
+
+Texture_id Texture_streamer::add_texture()
+{
+    const auto id = static_cast<Texture_id>(m_textures.size());
+    m_textures.push_back({.size = 0,
+                          .last_used_frame = 0,
+                          .resident = false,
+                          .lru_it = m_lru.end()});
+    return id;
+}
+
+bool Texture_streamer::use(Texture_id id, std::uint64_t frame_number)
+{
+    auto &texture = m_textures[id];
+    texture.last_used_frame = frame_number;
+
+    if (!texture.resident)
+    {
+        return true;
+    }
+
+    m_lru.splice(m_lru.begin(), m_lru, texture.lru_it);
+    return false;
+}
+
+void Texture_streamer::set_resident(Texture_id id, std::uint64_t size)
+{
+    auto &texture = m_textures[id];
+    if (texture.resident)
+    {
+        m_resident_size -= texture.size;
+        m_lru.erase(texture.lru_it);
+    }
+
+    texture.size = size;
+    texture.resident = true;
+    texture.lru_it = m_lru.insert(m_lru.begin(), id);
+    m_resident_size += size;
+}
+
+void Texture_streamer::remove_texture(Texture_id id)
+{
+    auto &texture = m_textures[id];
+    if (texture.resident)
+    {
+        m_resident_size -= texture.size;
+        m_lru.erase(texture.lru_it);
+        texture.lru_it = m_lru.end();
+        texture.resident = false;
+    }
+}
+
+std::vector<Texture_id>
+Texture_streamer::evict_over_budget(std::uint64_t frame_number)
+{
+    std::vector<Texture_id> evicted;
+
+    auto it = m_lru.end();
+    while (m_resident_size > m_budget && it != m_lru.begin())
+    {
+        --it;
+        auto &texture = m_textures[*it];
+        if (texture.last_used_frame == frame_number)
+        {
+            // Everything before this one was used by the current frame too
+            break;
+        }
+
+        evicted.push_back(*it);
+        texture.resident = false;
+        m_resident_size -= texture.size;
+        it = m_lru.erase(it);
+        texture.lru_it = m_lru.end();
+    }
+
+    return evicted;
+}
+
+bool Texture_streamer::is_resident(Texture_id id) const
+{
+    return m_textures[id].resident;
+}
+
+void Texture_streamer::set_budget(std::uint64_t budget)
+{
+    m_budget = budget;
+}
@@ -0,0 +1,70 @@
+#ifndef TEXTURE_STREAMER_HPP
+#define TEXTURE_STREAMER_HPP
+
+#include <cstdint>
+#include <list>
+#include <vector>
+
+using Texture_id = std::uint32_t;
+
+// Keeps track of which full-resolution textures are resident, and decides
+// which ones to evict (least recently used first) when the VRAM budget is
+// exceeded. Low-resolution placeholders are not accounted for, they are
+// always resident.
+class Texture_streamer
+{
+public:
+    explicit Texture_streamer(std::uint64_t budget);
+
+    [[nodiscard]] Texture_id add_texture();
+
+    // Marks the texture as used by the given frame. Returns true if its
+    // full-resolution data is not resident and must be loaded.
+    [[nodiscard]] bool use(Texture_id id, std::uint64_t frame_number);
+
+    void set_resident(Texture_id id, std::uint64_t size);
+
+    // The texture is no longer accounted for. Its id is not reused.
+    void remove_texture(Texture_id id);
+
+    // Returns the textures to evict to get back under budget. Textures used by
+    // the current frame are never evicted.
+    [[nodiscard]] std::vector<Texture_id>
+    evict_over_budget(std::uint64_t frame_number);
+
+    [[nodiscard]] bool is_resident(Texture_id id) const;
+
+    void set_budget(std::uint64_t budget);
+
+    [[nodiscard]] constexpr std::uint64_t budget() const noexcept
+    {
+        return m_budget;
+    }
+
+    [[nodiscard]] constexpr std::uint64_t resident_size() const noexcept
+    {
+        return m_resident_size;
+    }
+
+    [[nodiscard]] std::size_t resident_count() const noexcept
+    {
+        return m_lru.size();
+    }
+
+private:
+    struct Texture
+    {
+        std::uint64_t size;
+        std::uint64_t last_used_frame;
+        bool resident;
+        std::list<Texture_id>::iterator lru_it;
+    };
+
+    std::vector<Texture> m_textures {};
+    // Resident textures, most recently used first
+    std::list<Texture_id> m_lru {};
+    std::uint64_t m_budget {};
+    std::uint64_t m_resident_size {};
+};
+
+#endif // TEXTURE_STREAMER_HPP
@@ -0,0 +1,32 @@
+#include "timing_history.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+void Timing_history::push(float value) noexcept
+{
+    m_values[m_next] = value;
+    m_next = (m_next + 1) % g_capacity;
+    m_size = std::min(m_size + 1, g_capacity);
+}
+
+Timing_stats Timing_history::stats() const
+{
+    if (m_size == 0)
+    {
+        return {.min = 0.0f, .average = 0.0f, .p99 = 0.0f};
+    }
+
+    // Until the buffer is full, the samples are at the start
+    std::array<float, g_capacity> sorted {};
+    const auto last = std::copy_n(m_values.begin(), m_size, sorted.begin());
+
+    const auto sum = std::accumulate(sorted.begin(), last, 0.0);
+    // Nearest rank
+    const auto p99_index = (m_size * 99 + 99) / 100 - 1;
+    std::nth_element(sorted.begin(), sorted.begin() + p99_index, last);
+
+    return {.min = *std::min_element(sorted.begin(), last),
+            .average = static_cast<float>(sum / static_cast<double>(m_size)),
+            .p99 = sorted[p99_index]};
+}
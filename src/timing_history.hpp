@@ -0,0 +1,49 @@
+#ifndef TIMING_HISTORY_HPP
+#define TIMING_HISTORY_HPP
+
+#include <array>
+#include <cstddef>
+
+struct Timing_stats
+{
+    float min;
+    float average;
+    float p99;
+};
+
+// Keeps the last g_capacity samples, e.g. per-frame times in milliseconds, in
+// a ring buffer that can be plotted directly
+class Timing_history
+{
+public:
+    static constexpr std::size_t g_capacity {240};
+
+    void push(float value) noexcept;
+
+    // All zero until the first sample
+    [[nodiscard]] Timing_stats stats() const;
+
+    // The samples, the oldest one at offset() modulo size(), as expected by
+    // ImGui::PlotLines
+    [[nodiscard]] const float *data() const noexcept
+    {
+        return m_values.data();
+    }
+
+    [[nodiscard]] std::size_t offset() const noexcept
+    {
+        return m_next;
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept
+    {
+        return m_size;
+    }
+
+private:
+    std::array<float, g_capacity> m_values {};
+    std::size_t m_next {};
+    std::size_t m_size {};
+};
+
+#endif // TIMING_HISTORY_HPP
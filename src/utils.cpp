@@ -2,18 +2,87 @@
 
 #include <fstream>
 #include <iostream>
+#include <sstream>
+#include <thread>
+#include <utility>
 
-std::vector<std::uint8_t> load_binary_file(const std::filesystem::path &path)
+#if defined(__unix__) || defined(__APPLE__)
+#define HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+File_view::~File_view()
+{
+    reset();
+}
+
+File_view::File_view(File_view &&other) noexcept
+    : m_data {std::exchange(other.m_data, nullptr)},
+      m_size {std::exchange(other.m_size, 0)},
+      m_mapped {std::exchange(other.m_mapped, false)},
+      m_buffer {std::move(other.m_buffer)}
 {
-    if (!std::filesystem::exists(path))
+}
+
+File_view &File_view::operator=(File_view &&other) noexcept
+{
+    if (this != &other)
     {
-        std::cerr << "File " << path << " does not exist\n";
-        return {};
+        reset();
+        m_data = std::exchange(other.m_data, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+        m_mapped = std::exchange(other.m_mapped, false);
+        m_buffer = std::move(other.m_buffer);
+    }
+    return *this;
+}
+
+void File_view::reset() noexcept
+{
+#ifdef HAS_MMAP
+    if (m_mapped)
+    {
+        munmap(const_cast<std::uint8_t *>(m_data), m_size);
+    }
+#endif
+    m_data = nullptr;
+    m_size = 0;
+    m_mapped = false;
+    m_buffer.reset();
+}
+
+namespace
+{
+
+#ifdef HAS_MMAP
+
+// Below this size, mapping and unmapping the file costs more than copying it
+constexpr std::size_t g_mmap_threshold {64 * 1024};
+
+[[nodiscard]] std::unique_ptr<std::uint8_t[]>
+read_file(int fd, std::size_t size)
+{
+    auto buffer = std::make_unique_for_overwrite<std::uint8_t[]>(size);
+    for (std::size_t offset {}; offset < size;)
+    {
+        const auto count = read(fd, buffer.get() + offset, size - offset);
+        if (count <= 0)
+        {
+            return {};
+        }
+        offset += static_cast<std::size_t>(count);
     }
+    return buffer;
+}
 
-    const auto size = std::filesystem::file_size(path);
-    std::vector<std::uint8_t> data(size);
+#endif
 
+[[nodiscard]] std::unique_ptr<std::uint8_t[]>
+read_file(const std::filesystem::path &path, std::size_t size)
+{
     std::ifstream file(path, std::ios::binary);
     if (!file)
     {
@@ -21,8 +90,131 @@ std::vector<std::uint8_t> load_binary_file(const std::filesystem::path &path)
         return {};
     }
 
-    file.read(reinterpret_cast<char *>(data.data()),
-              static_cast<std::streamsize>(size));
+    // Not value-initialized, every byte is overwritten by the read
+    auto buffer = std::make_unique_for_overwrite<std::uint8_t[]>(size);
+    if (!file.read(reinterpret_cast<char *>(buffer.get()),
+                   static_cast<std::streamsize>(size)))
+    {
+        std::cerr << "Failed to read file " << path << '\n';
+        return {};
+    }
+
+    return buffer;
+}
+
+} // namespace
+
+File_view open_file_view(const std::filesystem::path &path,
+                         [[maybe_unused]] File_access access)
+{
+    File_view view;
+
+#ifdef HAS_MMAP
+    const auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        std::cerr << "Failed to open file " << path << '\n';
+        return view;
+    }
+
+    struct stat file_stat
+    {
+    };
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size <= 0)
+    {
+        close(fd);
+        return view;
+    }
+    const auto size = static_cast<std::size_t>(file_stat.st_size);
+
+    if (size < g_mmap_threshold || access == File_access::read)
+    {
+        view.m_buffer = read_file(fd, size);
+        close(fd);
+        if (!view.m_buffer)
+        {
+            std::cerr << "Failed to read file " << path << '\n';
+            return view;
+        }
+        view.m_data = view.m_buffer.get();
+        view.m_size = size;
+        return view;
+    }
+
+    int flags {MAP_PRIVATE};
+#ifdef MAP_POPULATE
+    // Prefault the pages, the whole file is going to be read anyway
+    flags |= MAP_POPULATE;
+#endif
+    auto *const address = mmap(nullptr, size, PROT_READ, flags, fd, 0);
+    close(fd);
+
+    if (address != MAP_FAILED)
+    {
+        madvise(address, size, MADV_SEQUENTIAL);
+        view.m_data = static_cast<const std::uint8_t *>(address);
+        view.m_size = size;
+        view.m_mapped = true;
+        return view;
+    }
+#else
+    std::error_code error;
+    const auto size = std::filesystem::file_size(path, error);
+    if (error || size == 0)
+    {
+        std::cerr << "Failed to open file " << path << '\n';
+        return view;
+    }
+#endif
+
+    // Fallback to a buffered read
+    view.m_buffer = read_file(path, size);
+    if (view.m_buffer)
+    {
+        view.m_data = view.m_buffer.get();
+        view.m_size = size;
+    }
+
+    return view;
+}
+
+bool write_file_atomically(
+    const std::filesystem::path &path,
+    std::initializer_list<std::span<const std::uint8_t>> chunks)
+{
+    // Unique per thread, so that concurrent writers of the same file do not
+    // clobber each other's temporary file
+    std::ostringstream temporary_name;
+    temporary_name << path.filename().string() << '.'
+                   << std::this_thread::get_id() << ".tmp";
+    const auto temporary_path = path.parent_path() / temporary_name.str();
+
+    std::error_code error;
+
+    {
+        std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+        for (const auto chunk : chunks)
+        {
+            file.write(reinterpret_cast<const char *>(chunk.data()),
+                       static_cast<std::streamsize>(chunk.size()));
+        }
+        if (!file)
+        {
+            std::cerr << "Failed to write file " << path << '\n';
+            file.close();
+            std::filesystem::remove(temporary_path, error);
+            return false;
+        }
+    }
+
+    std::filesystem::rename(temporary_path, path, error);
+    if (error)
+    {
+        std::cerr << "Failed to write file " << path << ": " << error.message()
+                  << '\n';
+        std::filesystem::remove(temporary_path, error);
+        return false;
+    }
 
-    return data;
+    return true;
 }
@@ -3,9 +3,71 @@
 
 #include <cstdint>
 #include <filesystem>
-#include <vector>
+#include <initializer_list>
+#include <memory>
+#include <span>
 
-[[nodiscard]] std::vector<std::uint8_t>
-load_binary_file(const std::filesystem::path &path);
+enum class File_access : std::uint8_t
+{
+    // Above a size threshold and when the platform supports it. The file must
+    // only be replaced atomically: accessing a mapping past the end of a file
+    // truncated in the meantime raises SIGBUS.
+    map,
+    // For files that may be rewritten in place while they are read, such as
+    // the watched shaders and assets, which editors and compilers truncate
+    read
+};
+
+// Read-only view of the whole content of a file, memory-mapped or read into a
+// buffer
+class File_view
+{
+public:
+    File_view() = default;
+    ~File_view();
+
+    File_view(const File_view &) = delete;
+    File_view &operator=(const File_view &) = delete;
+
+    File_view(File_view &&other) noexcept;
+    File_view &operator=(File_view &&other) noexcept;
+
+    [[nodiscard]] std::span<const std::uint8_t> data() const noexcept
+    {
+        return {m_data, m_size};
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept
+    {
+        return m_size;
+    }
+
+    [[nodiscard]] bool empty() const noexcept
+    {
+        return m_size == 0;
+    }
+
+private:
+    friend File_view open_file_view(const std::filesystem::path &path,
+                                    File_access access);
+
+    void reset() noexcept;
+
+    const std::uint8_t *m_data {};
+    std::size_t m_size {};
+    bool m_mapped {};
+    std::unique_ptr<std::uint8_t[]> m_buffer {};
+};
+
+// Returns an empty view if the file does not exist or cannot be read, or if it
+// was truncated while being read
+[[nodiscard]] File_view open_file_view(const std::filesystem::path &path,
+                                       File_access access = File_access::map);
+
+// Writes the concatenation of the chunks to a temporary file which is then
+// renamed, so that readers either see the whole file or the previous one
+bool write_file_atomically(
+    const std::filesystem::path &path,
+    std::initializer_list<std::span<const std::uint8_t>> chunks);
 
 #endif // UTILS_HPP
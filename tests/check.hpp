@@ -0,0 +1,39 @@
+#ifndef CHECK_HPP
+#define CHECK_HPP
+
+#include <source_location>
+#include <stdexcept>
+#include <string>
+
+// Throws std::runtime_error with the location of the check if the condition
+// does not hold
+inline void
+check(bool condition,
+      std::source_location location = std::source_location::current())
+{
+    if (!condition)
+    {
+        throw std::runtime_error(std::string(location.file_name()) + ":" +
+                                 std::to_string(location.line()) +
+                                 ": check failed");
+    }
+}
+
+// Checks that the function throws std::runtime_error
+template <typename F>
+void check_throws(
+    F &&function,
+    std::source_location location = std::source_location::current())
+{
+    try
+    {
+        function();
+    }
+    catch (const std::runtime_error &)
+    {
+        return;
+    }
+    check(false, location);
+}
+
+#endif // CHECK_HPP
@@ -0,0 +1,146 @@
+#include "check.hpp"
+#include "ecs.hpp"
+#include "job_system.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <span>
+#include <vector>
+
+namespace
+{
+
+struct Index
+{
+    int value;
+};
+
+struct Weight
+{
+    double value;
+};
+
+struct Tag
+{
+    char letters[3];
+};
+
+constexpr int g_entity_count {5000};
+
+// Entities keep their components while moving between archetypes
+void test_add_remove(World &world, std::vector<Entity> &entities)
+{
+    for (int i {}; i < g_entity_count; ++i)
+    {
+        entities.push_back(i % 2 != 0
+                               ? world.create(Index {i}, Weight {i * 0.5})
+                               : world.create(Index {i}));
+    }
+    check(world.size() == g_entity_count);
+
+    for (int i {}; i < g_entity_count; i += 3)
+    {
+        world.add(entities[static_cast<std::size_t>(i)],
+                  Tag {{'a', 'b', static_cast<char>(i)}});
+    }
+    for (int i {}; i < g_entity_count; i += 5)
+    {
+        world.remove<Index>(entities[static_cast<std::size_t>(i)]);
+    }
+
+    for (int i {}; i < g_entity_count; ++i)
+    {
+        const auto entity = entities[static_cast<std::size_t>(i)];
+        const auto *index = world.get<Index>(entity);
+        const auto *weight = world.get<Weight>(entity);
+        const auto *tag = world.get<Tag>(entity);
+        check((index != nullptr) == (i % 5 != 0));
+        check(index == nullptr || index->value == i);
+        check((weight != nullptr) == (i % 2 != 0));
+        check(weight == nullptr || weight->value == i * 0.5);
+        check((tag != nullptr) == (i % 3 == 0));
+        check(tag == nullptr || tag->letters[2] == static_cast<char>(i));
+    }
+}
+
+// Destroying from the jobs of a parallel iteration through a command buffer
+void test_command_buffer(World &world, const std::vector<Entity> &entities)
+{
+    Job_system job_system {3};
+    Command_buffer commands;
+    std::atomic<int> visited {};
+    world.parallel_for_each_chunk<const Index>(
+        job_system,
+        [&](std::span<const Entity> chunk_entities,
+            std::span<const Index> indices)
+        {
+            for (std::size_t i {}; i < indices.size(); ++i)
+            {
+                visited.fetch_add(1);
+                if (indices[i].value % 7 == 0)
+                {
+                    commands.destroy(chunk_entities[i]);
+                }
+            }
+        });
+    check(visited == g_entity_count - g_entity_count / 5);
+
+    // The second destroy is skipped
+    commands.destroy(entities[1]);
+    commands.destroy(entities[1]);
+    check(!commands.empty());
+    commands.apply(world);
+    check(commands.empty());
+
+    std::size_t alive {};
+    for (int i {}; i < g_entity_count; ++i)
+    {
+        const auto entity = entities[static_cast<std::size_t>(i)];
+        const auto destroyed = (i % 5 != 0 && i % 7 == 0) || i == 1;
+        check(world.is_alive(entity) != destroyed);
+        if (destroyed)
+        {
+            check(world.get<Index>(entity) == nullptr);
+            check_throws([&] { world.destroy(entity); });
+        }
+        else
+        {
+            ++alive;
+        }
+    }
+    check(world.size() == alive);
+
+    std::size_t iterated {};
+    world.for_each_chunk<>([&](std::span<const Entity> chunk_entities)
+                           { iterated += chunk_entities.size(); });
+    check(iterated == world.size());
+
+    // The index of a destroyed entity is reused with the next generation
+    const auto entity = world.create(Weight {1.0});
+    check(entity.index < g_entity_count && entity.generation == 1);
+    check(world.get<Weight>(entity)->value == 1.0);
+}
+
+} // namespace
+
+int main()
+{
+    try
+    {
+        World world;
+        std::vector<Entity> entities;
+        test_add_remove(world, entities);
+        test_command_buffer(world, entities);
+
+        std::cout << "ECS tests passed\n";
+        return EXIT_SUCCESS;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << '\n';
+    }
+
+    return EXIT_FAILURE;
+}
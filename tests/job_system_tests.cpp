@@ -0,0 +1,206 @@
+#include "check.hpp"
+#include "job_system.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+// Every element is visited exactly once, whatever the number of threads
+void test_parallel_for(Job_system &job_system)
+{
+    std::vector<std::uint64_t> values(100'003);
+    for (int i {}; i < 10; ++i)
+    {
+        job_system.parallel_for(values.size(),
+                                1000,
+                                [&](std::size_t first, std::size_t last)
+                                {
+                                    for (auto j = first; j < last; ++j)
+                                    {
+                                        values[j] += j;
+                                    }
+                                });
+    }
+    for (std::size_t i {}; i < values.size(); ++i)
+    {
+        check(values[i] == 10 * i);
+    }
+
+    std::size_t calls {};
+    job_system.parallel_for(0,
+                            1,
+                            [&](std::size_t, std::size_t) { ++calls; });
+    check(calls == 0);
+}
+
+void test_submit_after(Job_system &job_system)
+{
+    std::atomic<int> started {};
+    std::atomic<bool> in_order {true};
+    Job_counter first;
+    Job_counter second;
+    for (int i {}; i < 100; ++i)
+    {
+        job_system.submit([&] { started.fetch_add(1); }, first);
+    }
+    for (int i {}; i < 10; ++i)
+    {
+        job_system.submit_after(first,
+                                [&]
+                                {
+                                    if (started.load() < 100)
+                                    {
+                                        in_order = false;
+                                    }
+                                },
+                                second);
+    }
+    job_system.wait(second);
+    job_system.wait(first);
+    check(in_order);
+    check(first.is_done() && second.is_done());
+}
+
+// More jobs than a deque holds, each waiting for a job of its own
+void test_nested_waits(Job_system &job_system)
+{
+    std::atomic<int> count {};
+    Job_counter counter;
+    for (int i {}; i < 10'000; ++i)
+    {
+        job_system.submit(
+            [&]
+            {
+                Job_counter inner;
+                job_system.submit([&] { count.fetch_add(1); }, inner);
+                job_system.wait(inner);
+            },
+            counter);
+    }
+    job_system.wait(counter);
+    check(count == 10'000);
+}
+
+// Threads that are not part of the job system go through the shared queue
+void test_foreign_thread(Job_system &job_system)
+{
+    std::vector<int> values(100'000);
+    std::thread thread {[&]
+                        {
+                            job_system.parallel_for(
+                                values.size(),
+                                100,
+                                [&](std::size_t first, std::size_t last)
+                                {
+                                    for (auto i = first; i < last; ++i)
+                                    {
+                                        values[i] = 1;
+                                    }
+                                });
+                        }};
+    thread.join();
+    check(std::accumulate(values.begin(), values.end(), 0) == 100'000);
+}
+
+void test_exceptions(Job_system &job_system)
+{
+    check_throws(
+        [&]
+        {
+            job_system.parallel_for(
+                100,
+                1,
+                [](std::size_t first, std::size_t)
+                {
+                    if (first == 50)
+                    {
+                        throw std::runtime_error("Job failed");
+                    }
+                });
+        });
+
+    // The job system is still usable afterwards
+    std::atomic<int> count {};
+    Job_counter counter;
+    job_system.submit([&] { count.fetch_add(1); }, counter);
+    job_system.wait(counter);
+    check(count == 1);
+}
+
+// Long jobs run on their own threads: a frame never waits behind them
+void test_long_jobs(Job_system &job_system)
+{
+    std::atomic<bool> released {};
+    auto blocked = job_system.submit_long(
+        [&]
+        {
+            while (!released)
+            {
+                std::this_thread::yield();
+            }
+            return 42;
+        });
+
+    test_parallel_for(job_system);
+    check(!blocked->counter.is_done());
+    released = true;
+    check(job_system.take_result(*blocked) == 42);
+
+    auto failed = job_system.submit_long(
+        []() -> int { throw std::runtime_error("Job failed"); });
+    check_throws([&] { (void)job_system.take_result(*failed); });
+
+    // Jobs submitted after a long job are short jobs
+    std::atomic<int> count {};
+    Job_counter long_counter;
+    Job_counter counter;
+    job_system.submit_long([&] { count.fetch_add(1); }, long_counter);
+    job_system.submit_after(long_counter,
+                            [&] { count.fetch_add(10); },
+                            counter);
+    job_system.wait(counter);
+    job_system.wait(long_counter);
+    check(count == 11);
+}
+
+void test_worker_counts()
+{
+    for (const std::uint32_t worker_count : {0u, 1u, 3u, 7u})
+    {
+        Job_system job_system {worker_count};
+        check(job_system.thread_count() == worker_count + 1);
+        test_parallel_for(job_system);
+        test_submit_after(job_system);
+        test_nested_waits(job_system);
+        test_foreign_thread(job_system);
+        test_exceptions(job_system);
+        test_long_jobs(job_system);
+    }
+}
+
+} // namespace
+
+int main()
+{
+    try
+    {
+        test_worker_counts();
+
+        std::cout << "Job system tests passed\n";
+        return EXIT_SUCCESS;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << '\n';
+    }
+
+    return EXIT_FAILURE;
+}
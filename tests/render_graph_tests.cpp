@@ -0,0 +1,260 @@
+#include "check.hpp"
+#include "render_graph.hpp"
+
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+
+[[nodiscard]] bool has_barrier(const Compiled_render_pass &pass,
+                               const Render_barrier &expected)
+{
+    for (const auto &barrier : pass.barriers)
+    {
+        if (barrier.resource == expected.resource &&
+            barrier.before == expected.before &&
+            barrier.after == expected.after &&
+            barrier.discard == expected.discard)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+constexpr Transient_image_info g_small_image {
+    .size = 1024, .alignment = 256, .memory_type_bits = 0b0011};
+constexpr Transient_image_info g_large_image {
+    .size = 4096, .alignment = 1024, .memory_type_bits = 0b0110};
+constexpr Transient_image_info g_host_image {
+    .size = 1024, .alignment = 256, .memory_type_bits = 0b1000};
+
+// A chain of passes where the first and third images never live at the same
+// time, and a pass writing an image that nothing reads
+void test_chain()
+{
+    Render_graph graph;
+    const auto a = graph.add_transient_image("a", g_small_image);
+    const auto b = graph.add_transient_image("b", g_small_image);
+    const auto c = graph.add_transient_image("c", g_large_image);
+    const auto unused = graph.add_transient_image("unused", g_small_image);
+    const auto output = graph.import_image(
+        "output", Resource_usage::undefined, Resource_usage::present);
+
+    const auto pass_a = graph.add_pass("a");
+    graph.write(pass_a, a, Resource_usage::color_attachment);
+
+    const auto pass_b = graph.add_pass("b");
+    graph.read(pass_b, a, Resource_usage::sampled);
+    graph.write(pass_b, b, Resource_usage::color_attachment);
+
+    const auto pass_unused = graph.add_pass("unused");
+    graph.read(pass_unused, b, Resource_usage::sampled);
+    graph.write(pass_unused, unused, Resource_usage::color_attachment);
+
+    const auto pass_c = graph.add_pass("c");
+    graph.read(pass_c, b, Resource_usage::sampled);
+    graph.write(pass_c, c, Resource_usage::color_attachment);
+
+    const auto pass_output = graph.add_pass("output");
+    graph.read(pass_output, c, Resource_usage::sampled);
+    graph.write(pass_output, output, Resource_usage::color_attachment);
+
+    const auto compiled = graph.compile();
+
+    check(compiled.culled_pass_count == 1);
+    check(compiled.passes.size() == 4);
+    check(compiled.passes[0].pass == pass_a);
+    check(compiled.passes[1].pass == pass_b);
+    check(compiled.passes[2].pass == pass_c);
+    check(compiled.passes[3].pass == pass_output);
+
+    // a is last read before c is written, so they share memory
+    check(compiled.memory_slots.size() == 2);
+    check(compiled.resource_slots[a].has_value());
+    check(compiled.resource_slots[a] == compiled.resource_slots[c]);
+    check(compiled.resource_slots[b].has_value());
+    check(compiled.resource_slots[b] != compiled.resource_slots[a]);
+    check(!compiled.resource_slots[unused].has_value());
+    check(!compiled.resource_slots[output].has_value());
+
+    const auto &shared_slot =
+        compiled.memory_slots[*compiled.resource_slots[a]];
+    check(shared_slot.size == g_large_image.size);
+    check(shared_slot.alignment == g_large_image.alignment);
+    check(shared_slot.memory_type_bits == 0b0010);
+
+    // The first image of a slot follows the last one of the previous frame
+    check(compiled.passes[0].barriers.size() == 1);
+    check(has_barrier(compiled.passes[0],
+                      {.resource = a,
+                       .before = Resource_usage::sampled,
+                       .after = Resource_usage::color_attachment,
+                       .discard = true}));
+
+    check(compiled.passes[1].barriers.size() == 2);
+    check(has_barrier(compiled.passes[1],
+                      {.resource = a,
+                       .before = Resource_usage::color_attachment,
+                       .after = Resource_usage::sampled,
+                       .discard = false}));
+    check(has_barrier(compiled.passes[1],
+                      {.resource = b,
+                       .before = Resource_usage::sampled,
+                       .after = Resource_usage::color_attachment,
+                       .discard = true}));
+
+    // c aliases a, whose last usage was the read in pass b
+    check(compiled.passes[2].barriers.size() == 2);
+    check(has_barrier(compiled.passes[2],
+                      {.resource = b,
+                       .before = Resource_usage::color_attachment,
+                       .after = Resource_usage::sampled,
+                       .discard = false}));
+    check(has_barrier(compiled.passes[2],
+                      {.resource = c,
+                       .before = Resource_usage::sampled,
+                       .after = Resource_usage::color_attachment,
+                       .discard = true}));
+
+    check(compiled.passes[3].barriers.size() == 2);
+    check(has_barrier(compiled.passes[3],
+                      {.resource = c,
+                       .before = Resource_usage::color_attachment,
+                       .after = Resource_usage::sampled,
+                       .discard = false}));
+    check(has_barrier(compiled.passes[3],
+                      {.resource = output,
+                       .before = Resource_usage::undefined,
+                       .after = Resource_usage::color_attachment,
+                       .discard = true}));
+
+    check(compiled.final_barriers.size() == 1);
+    check(compiled.final_barriers[0].resource == output);
+    check(compiled.final_barriers[0].before ==
+          Resource_usage::color_attachment);
+    check(compiled.final_barriers[0].after == Resource_usage::present);
+}
+
+// Images whose lifetimes do not overlap still need their own memory if no
+// memory type suits both
+void test_incompatible_memory_types()
+{
+    Render_graph graph;
+    const auto a = graph.add_transient_image("a", g_small_image);
+    const auto b = graph.add_transient_image("b", g_host_image);
+    const auto c = graph.add_transient_image("c", g_small_image);
+    const auto output = graph.import_image(
+        "output", Resource_usage::undefined, Resource_usage::transfer_src);
+
+    const auto pass_a = graph.add_pass("a");
+    graph.write(pass_a, a, Resource_usage::color_attachment);
+    const auto pass_b = graph.add_pass("b");
+    graph.read(pass_b, a, Resource_usage::sampled);
+    graph.write(pass_b, b, Resource_usage::color_attachment);
+    const auto pass_c = graph.add_pass("c");
+    graph.read(pass_c, b, Resource_usage::sampled);
+    graph.write(pass_c, c, Resource_usage::color_attachment);
+    const auto pass_output = graph.add_pass("output");
+    graph.read(pass_output, c, Resource_usage::sampled);
+    graph.write(pass_output, output, Resource_usage::transfer_dst);
+
+    const auto compiled = graph.compile();
+
+    check(compiled.culled_pass_count == 0);
+    check(compiled.memory_slots.size() == 2);
+    check(compiled.resource_slots[a] == compiled.resource_slots[c]);
+    check(compiled.resource_slots[b] != compiled.resource_slots[a]);
+
+    // b is alone in its slot, so it follows itself from the previous frame
+    check(has_barrier(compiled.passes[1],
+                      {.resource = b,
+                       .before = Resource_usage::sampled,
+                       .after = Resource_usage::color_attachment,
+                       .discard = true}));
+}
+
+// Without any imported image, nothing is needed and every pass is culled
+void test_everything_culled()
+{
+    Render_graph graph;
+    const auto a = graph.add_transient_image("a", g_small_image);
+    const auto pass = graph.add_pass("a");
+    graph.write(pass, a, Resource_usage::color_attachment);
+
+    const auto compiled = graph.compile();
+
+    check(compiled.culled_pass_count == 1);
+    check(compiled.passes.empty());
+    check(compiled.memory_slots.empty());
+    check(compiled.final_barriers.empty());
+}
+
+// A pass that only reads an output is culled, unless it has side effects,
+// in which case the output is transitioned for it and then to its final usage
+void test_side_effects()
+{
+    Render_graph graph;
+    const auto output = graph.import_image(
+        "output", Resource_usage::undefined, Resource_usage::present);
+    const auto draw_pass = graph.add_pass("draw");
+    graph.write(draw_pass, output, Resource_usage::color_attachment);
+    const auto copy_pass = graph.add_pass("copy");
+    graph.read(copy_pass, output, Resource_usage::transfer_src);
+
+    const auto without_copy = graph.compile();
+    check(without_copy.culled_pass_count == 1);
+    check(without_copy.passes.size() == 1);
+    check(without_copy.final_barriers.size() == 1);
+    check(without_copy.final_barriers[0].before ==
+          Resource_usage::color_attachment);
+
+    graph.set_side_effects(copy_pass, true);
+    const auto with_copy = graph.compile();
+    check(with_copy.culled_pass_count == 0);
+    check(with_copy.passes.size() == 2);
+    check(with_copy.passes[1].pass == copy_pass);
+    check(has_barrier(with_copy.passes[1],
+                      {.resource = output,
+                       .before = Resource_usage::color_attachment,
+                       .after = Resource_usage::transfer_src,
+                       .discard = false}));
+    check(with_copy.final_barriers.size() == 1);
+    check(with_copy.final_barriers[0].before == Resource_usage::transfer_src);
+    check(with_copy.final_barriers[0].after == Resource_usage::present);
+}
+
+void test_conflicting_usages()
+{
+    Render_graph graph;
+    const auto a = graph.add_transient_image("a", g_small_image);
+    const auto pass = graph.add_pass("a");
+    graph.read(pass, a, Resource_usage::sampled);
+
+    check_throws([&]
+                 { graph.write(pass, a, Resource_usage::color_attachment); });
+}
+
+} // namespace
+
+int main()
+{
+    try
+    {
+        test_chain();
+        test_incompatible_memory_types();
+        test_everything_culled();
+        test_side_effects();
+        test_conflicting_usages();
+
+        std::cout << "Render graph tests passed\n";
+        return EXIT_SUCCESS;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << '\n';
+    }
+
+    return EXIT_FAILURE;
+}
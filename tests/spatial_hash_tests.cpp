@@ -0,0 +1,172 @@
+#include "check.hpp"
+#include "job_system.hpp"
+#include "spatial_hash.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <span>
+#include <vector>
+
+namespace
+{
+
+[[nodiscard]] bool overlaps(const Aabb &a, const Aabb &b)
+{
+    return a.min.x <= b.max.x && b.min.x <= a.max.x && a.min.y <= b.max.y &&
+           b.min.y <= a.max.y;
+}
+
+[[nodiscard]] bool overlaps(const Aabb &box, const Circle &circle)
+{
+    const auto dx =
+        circle.center.x - std::clamp(circle.center.x, box.min.x, box.max.x);
+    const auto dy =
+        circle.center.y - std::clamp(circle.center.y, box.min.y, box.max.y);
+    return dx * dx + dy * dy <= circle.radius * circle.radius;
+}
+
+// Compares the batched queries with testing every object
+template <typename Query, typename F>
+void check_queries(const Spatial_hash &hash,
+                   std::span<const Query> queries,
+                   Job_system &job_system,
+                   F &&brute_force)
+{
+    std::vector<std::vector<std::uint32_t>> results;
+    hash.query(queries, results, job_system);
+    check(results.size() == queries.size());
+    for (std::size_t i {}; i < queries.size(); ++i)
+    {
+        auto &ids = results[i];
+        std::sort(ids.begin(), ids.end());
+        check(ids == brute_force(queries[i]));
+    }
+}
+
+void test_spatial_hash()
+{
+    check_throws([] { Spatial_hash hash {0.0f}; });
+
+    constexpr std::uint32_t object_count {20'000};
+    std::mt19937 random {1};
+    std::uniform_real_distribution<float> position {-1.0f, 1.0f};
+    std::uniform_real_distribution<float> extent {0.001f, 0.02f};
+    std::uniform_real_distribution<float> step {-0.01f, 0.01f};
+
+    Job_system job_system {3};
+    Spatial_hash hash {0.04f};
+    std::vector<Aabb> boxes(object_count);
+    for (std::uint32_t i {}; i < object_count; ++i)
+    {
+        const glm::vec2 min {position(random), position(random)};
+        const auto size = extent(random);
+        boxes[i] = {.min = min, .max = min + glm::vec2 {size, size}};
+        hash.set(i, boxes[i]);
+    }
+
+    // Small moves, some of which change cell
+    for (int frame {}; frame < 5; ++frame)
+    {
+        for (auto &box : boxes)
+        {
+            const glm::vec2 offset {step(random), step(random)};
+            box.min += offset;
+            box.max += offset;
+        }
+        hash.set_all(boxes, job_system);
+    }
+    check(hash.size() == object_count);
+
+    for (std::uint32_t i {}; i < object_count; i += 3)
+    {
+        hash.remove(i);
+    }
+    hash.remove(0);
+    check(!hash.contains(0) && hash.contains(1));
+    check(hash.size() == object_count - (object_count + 2) / 3);
+
+    const auto brute_force = [&](const auto &overlap)
+    {
+        std::vector<std::uint32_t> ids;
+        for (std::uint32_t i {}; i < object_count; ++i)
+        {
+            if (i % 3 != 0 && overlap(boxes[i]))
+            {
+                ids.push_back(i);
+            }
+        }
+        return ids;
+    };
+
+    std::vector<glm::vec2> points;
+    std::vector<Aabb> query_boxes;
+    std::vector<Circle> circles;
+    for (int i {}; i < 200; ++i)
+    {
+        const glm::vec2 point {position(random), position(random)};
+        points.push_back(point);
+        query_boxes.push_back(
+            {.min = point, .max = point + glm::vec2 {0.05f, 0.1f}});
+        circles.push_back({.center = point, .radius = 0.03f});
+    }
+
+    check_queries(hash,
+                  std::span<const glm::vec2> {points},
+                  job_system,
+                  [&](glm::vec2 point)
+                  {
+                      const Aabb query {.min = point, .max = point};
+                      return brute_force([&](const Aabb &box)
+                                         { return overlaps(box, query); });
+                  });
+    check_queries(hash,
+                  std::span<const Aabb> {query_boxes},
+                  job_system,
+                  [&](const Aabb &query)
+                  {
+                      return brute_force([&](const Aabb &box)
+                                         { return overlaps(box, query); });
+                  });
+    check_queries(hash,
+                  std::span<const Circle> {circles},
+                  job_system,
+                  [&](const Circle &circle)
+                  {
+                      return brute_force([&](const Aabb &box)
+                                         { return overlaps(box, circle); });
+                  });
+
+    // Wider than the cells in use
+    std::vector<std::uint32_t> everything;
+    hash.query(Aabb {.min = {-1e30f, -1e30f}, .max = {1e30f, 1e30f}},
+               everything);
+    check(everything.size() == hash.size());
+
+    // Shrinking removes the objects beyond the new size
+    boxes.resize(object_count / 2);
+    hash.set_all(boxes, job_system);
+    check(hash.size() == object_count / 2);
+    check(!hash.contains(object_count / 2));
+}
+
+} // namespace
+
+int main()
+{
+    try
+    {
+        test_spatial_hash();
+
+        std::cout << "Spatial hash tests passed\n";
+        return EXIT_SUCCESS;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << '\n';
+    }
+
+    return EXIT_FAILURE;
+}